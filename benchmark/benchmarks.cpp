@@ -0,0 +1,308 @@
+#include <benchmark/benchmark.h>
+
+#include <chrono>
+#include <string>
+
+#include "../src/Interpreter.h"
+#include "../src/Jit.h"
+#include "../src/Native.h"
+#include "../src/Optimizer.h"
+#include "../src/Parser.h"
+#include "../src/Scheduler.h"
+#include "../src/Snapshot.h"
+#include "../src/SourceCode.h"
+#include "../src/StackBounds.h"
+#include "../src/Tiered.h"
+#include "../src/Tokenizer.h"
+
+namespace {
+
+constexpr std::size_t MaxTokens{ 256 };
+constexpr std::size_t MaxStackSize{ 256 };
+
+// main -> f1 -> f2 -> ... -> f<depth>, the innermost one returns a literal
+auto call_chain(int const depth) -> std::string
+{
+  std::string src{ "int f" + std::to_string(depth) + "() { return 1; }\n" };
+  for (int i{ depth - 1 }; i > 0; --i) {
+    src += "int f" + std::to_string(i) + "() { return f" + std::to_string(i + 1) + "(); }\n";
+  }
+  src += "int main() { return f1(); }\n";
+  return src;
+}
+
+// main returns 1+2+...+<terms>
+auto long_expression(int const terms) -> std::string
+{
+  std::string src{ "int main() { return 1" };
+  for (int i{ 2 }; i <= terms; ++i) {
+    src += "+" + std::to_string(i);
+  }
+  src += "; }\n";
+  return src;
+}
+
+// <count> independent functions, main calls the last one
+auto many_functions(int const count) -> std::string
+{
+  std::string src;
+  for (int i{ 1 }; i <= count; ++i) {
+    src += "int f" + std::to_string(i) + "() { return " + std::to_string(i) + "; }\n";
+  }
+  src += "int main() { return f" + std::to_string(count) + "(); }\n";
+  return src;
+}
+
+// main fills an array of <size> ints element by element and sums it up
+auto array_sum(int const size) -> std::string
+{
+  std::string const n{ std::to_string(size) };
+  return "int main() { int a[" + n + "]; for (int i = 0; i < " + n + "; i++) a[i] = i; "
+         + "int s = 0; for (int i = 0; i < " + n + "; i++) s += a[i]; return s; }\n";
+}
+
+// array_sum that waits for a request in next() before returning
+auto warm_start(int const size) -> std::string
+{
+  std::string const n{ std::to_string(size) };
+  return "int main() { int a[" + n + "]; for (int i = 0; i < " + n + "; i++) a[i] = i; "
+         + "int s = 0; for (int i = 0; i < " + n + "; i++) s += a[i]; return s + next(); }\n";
+}
+
+auto next_request(sci::Completion<int> const /*done*/) -> void
+{}
+
+constexpr std::array natives{ sci::async_native<next_request>("next") };
+
+template<typename Generator>
+void BM_GetNextToken(benchmark::State& state, Generator generate)
+{
+  auto const text = generate(static_cast<int>(state.range(0)));
+  sci::SourceCode const src{ text };
+  sci::Tokenizer<MaxTokens> const tok{ src };
+  std::size_t tokens{ 0 };
+  for (auto _ : state) {
+    int i{ 0 };
+    for (auto tr = tok.getNextToken(i); tr.r == sci::Result::OK; tr = tok.getNextToken(i)) {
+      benchmark::DoNotOptimize(tr);
+      ++tokens;
+    }
+  }
+  state.SetItemsProcessed(static_cast<int64_t>(tokens));
+}
+
+template<typename Generator>
+void BM_Tokenize(benchmark::State& state, Generator generate)
+{
+  auto const text = generate(static_cast<int>(state.range(0)));
+  sci::SourceCode const src{ text };
+  sci::Tokenizer<MaxTokens> const tok{ src };
+  for (auto _ : state) {
+    auto tokens = tok.tokenize();
+    benchmark::DoNotOptimize(tokens);
+  }
+  state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * text.size()));
+}
+
+template<typename Generator>
+void BM_Parse(benchmark::State& state, Generator generate)
+{
+  auto const text = generate(static_cast<int>(state.range(0)));
+  sci::SourceCode const src{ text };
+  sci::Tokenizer<MaxTokens> const tok{ src };
+  auto const tokens = tok.tokenize();
+  sci::Parser<MaxTokens, MaxStackSize> const par{ tokens };
+  for (auto _ : state) {
+    auto exe = par.parse();
+    benchmark::DoNotOptimize(exe);
+  }
+}
+
+template<typename Generator>
+void BM_Interpret(benchmark::State& state, Generator generate)
+{
+  auto const text = generate(static_cast<int>(state.range(0)));
+  sci::SourceCode const src{ text };
+  sci::Tokenizer<MaxTokens> const tok{ src };
+  auto const tokens = tok.tokenize();
+  sci::Parser<MaxTokens, MaxStackSize> const par{ tokens };
+  auto const exe = par.parse();
+  sci::Interpreter<16, 64, 32> const interpreter;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(interpreter.interpret(exe));
+  }
+}
+
+// Same as BM_Interpret without runtime stack checks, sizes are proven by stack_bounds
+template<typename Generator>
+void BM_InterpretUnchecked(benchmark::State& state, Generator generate)
+{
+  auto const text = generate(static_cast<int>(state.range(0)));
+  sci::SourceCode const src{ text };
+  sci::Tokenizer<MaxTokens> const tok{ src };
+  auto const tokens = tok.tokenize();
+  sci::Parser<MaxTokens, MaxStackSize> const par{ tokens };
+  auto const exe = par.parse();
+  auto const bounds = sci::stack_bounds(exe);
+  if (bounds.r != sci::Result::OK || bounds.func_stack > 16 || bounds.comp_stack > 32) {
+    state.SkipWithError("stack bounds exceed the interpreter");
+    return;
+  }
+  sci::Interpreter<16, 64, 32, sci::StackChecks::UNCHECKED> const interpreter;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(interpreter.interpret(exe));
+  }
+}
+
+// Same as BM_Interpret with fuel and a time limit that are never reached, the time
+// limit adds one clock read per run
+template<typename Generator>
+void BM_InterpretLimited(benchmark::State& state, Generator generate)
+{
+  auto const text = generate(static_cast<int>(state.range(0)));
+  sci::SourceCode const src{ text };
+  sci::Tokenizer<MaxTokens> const tok{ src };
+  auto const tokens = tok.tokenize();
+  sci::Parser<MaxTokens, MaxStackSize> const par{ tokens };
+  auto const exe = par.parse();
+  sci::Interpreter<16, 64, 32> const interpreter{ sci::Limits{ .fuel = 1'000'000, .time = std::chrono::seconds{ 10 } } };
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(interpreter.interpret(exe));
+  }
+}
+
+// Same as BM_Interpret after optimize, counted array loops run as vector kernels
+template<typename Generator>
+void BM_InterpretOptimized(benchmark::State& state, Generator generate)
+{
+  auto const text = generate(static_cast<int>(state.range(0)));
+  sci::SourceCode const src{ text };
+  sci::Tokenizer<MaxTokens> const tok{ src };
+  auto const tokens = tok.tokenize();
+  sci::Parser<MaxTokens, MaxStackSize> const par{ tokens };
+  auto const exe = sci::optimize(par.parse());
+  sci::Interpreter<16, 64, 32> const interpreter;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(interpreter.interpret(exe));
+  }
+}
+
+// Same as BM_Interpret as a coroutine suspended every 16 instructions
+template<typename Generator>
+void BM_InterpretSliced(benchmark::State& state, Generator generate)
+{
+  auto const text = generate(static_cast<int>(state.range(0)));
+  sci::SourceCode const src{ text };
+  sci::Tokenizer<MaxTokens> const tok{ src };
+  auto const tokens = tok.tokenize();
+  sci::Parser<MaxTokens, MaxStackSize> const par{ tokens };
+  auto const exe = par.parse();
+  for (auto _ : state) {
+    auto task = sci::run_in_slices(sci::Interpreter<16, 64, 32>{}, exe, 16);
+    while (task.step()) {}
+    benchmark::DoNotOptimize(task.result());
+  }
+}
+
+// Serves a request from a snapshot taken where the script waits for it, compare with
+// BM_Interpret/array_sum which runs the initialisation every time
+template<typename Generator>
+void BM_ForkSnapshot(benchmark::State& state, Generator generate)
+{
+  auto const text = generate(static_cast<int>(state.range(0)));
+  sci::SourceCode const src{ text };
+  sci::Tokenizer<MaxTokens> const tok{ src };
+  auto const tokens = tok.tokenize();
+  sci::Parser<MaxTokens, MaxStackSize> const par{ tokens, natives };
+  auto const exe = par.parse();
+  using Interp = sci::Interpreter<16, 64, 32>;
+  Interp const interpreter;
+  Interp::Context context;
+  sci::Unlimited budget;
+  interpreter.start(exe, context);
+  interpreter.resume(context, budget);
+  auto const blob = sci::snapshot(context);
+  sci::Snapshot const image{ exe, blob };
+  for (auto _ : state) {
+    image.fork(interpreter, context);
+    interpreter.complete(context, { 1 });
+    benchmark::DoNotOptimize(interpreter.resume(context, budget));
+  }
+}
+
+template<typename Generator>
+void BM_Jit(benchmark::State& state, Generator generate)
+{
+  auto const text = generate(static_cast<int>(state.range(0)));
+  sci::SourceCode const src{ text };
+  sci::Tokenizer<MaxTokens> const tok{ src };
+  auto const tokens = tok.tokenize();
+  sci::Parser<MaxTokens, MaxStackSize> const par{ tokens };
+  auto const exe = par.parse();
+  sci::JitInterpreter<16, 64, 32> const jit{ exe };
+  if (!jit.compiled()) {
+    state.SkipWithError("not supported by the JIT");
+    return;
+  }
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(jit.interpret());
+  }
+}
+
+// Interpreter with tiering, hot functions converge to native code during the warm-up
+template<typename Generator>
+void BM_Tiered(benchmark::State& state, Generator generate)
+{
+  auto const text = generate(static_cast<int>(state.range(0)));
+  sci::SourceCode const src{ text };
+  sci::Tokenizer<MaxTokens> const tok{ src };
+  auto const tokens = tok.tokenize();
+  sci::Parser<MaxTokens, MaxStackSize> const par{ tokens };
+  auto const exe = par.parse();
+  sci::Interpreter<16, 64, 32> const interpreter;
+  sci::TieredExecution<16, 32> tiers{ exe, 100 };
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(interpreter.interpret(exe, tiers));
+  }
+}
+
+}// namespace
+
+// Program sizes are bounded by CompiledProgram::NUM_OF_FUNC and CompiledFunction::NUM_OF_INS.
+BENCHMARK_CAPTURE(BM_GetNextToken, call_chain, &call_chain)->DenseRange(1, 9, 4);
+BENCHMARK_CAPTURE(BM_GetNextToken, long_expression, &long_expression)->DenseRange(1, 15, 7);
+BENCHMARK_CAPTURE(BM_GetNextToken, many_functions, &many_functions)->DenseRange(1, 9, 4);
+
+BENCHMARK_CAPTURE(BM_Tokenize, call_chain, &call_chain)->DenseRange(1, 9, 4);
+BENCHMARK_CAPTURE(BM_Tokenize, long_expression, &long_expression)->DenseRange(1, 15, 7);
+BENCHMARK_CAPTURE(BM_Tokenize, many_functions, &many_functions)->DenseRange(1, 9, 4);
+
+BENCHMARK_CAPTURE(BM_Parse, call_chain, &call_chain)->DenseRange(1, 9, 4);
+BENCHMARK_CAPTURE(BM_Parse, long_expression, &long_expression)->DenseRange(1, 15, 7);
+BENCHMARK_CAPTURE(BM_Parse, many_functions, &many_functions)->DenseRange(1, 9, 4);
+
+BENCHMARK_CAPTURE(BM_Interpret, call_chain, &call_chain)->DenseRange(1, 9, 4);
+BENCHMARK_CAPTURE(BM_Interpret, long_expression, &long_expression)->DenseRange(1, 15, 7);
+BENCHMARK_CAPTURE(BM_Interpret, many_functions, &many_functions)->DenseRange(1, 9, 4);
+
+BENCHMARK_CAPTURE(BM_InterpretUnchecked, call_chain, &call_chain)->DenseRange(1, 9, 4);
+BENCHMARK_CAPTURE(BM_InterpretUnchecked, long_expression, &long_expression)->DenseRange(1, 15, 7);
+BENCHMARK_CAPTURE(BM_InterpretUnchecked, many_functions, &many_functions)->DenseRange(1, 9, 4);
+
+BENCHMARK_CAPTURE(BM_InterpretLimited, call_chain, &call_chain)->DenseRange(1, 9, 4);
+BENCHMARK_CAPTURE(BM_InterpretLimited, many_functions, &many_functions)->DenseRange(1, 9, 4);
+
+BENCHMARK_CAPTURE(BM_Interpret, array_sum, &array_sum)->DenseRange(8, 56, 24);
+BENCHMARK_CAPTURE(BM_InterpretLimited, array_sum, &array_sum)->DenseRange(8, 56, 24);
+BENCHMARK_CAPTURE(BM_InterpretOptimized, array_sum, &array_sum)->DenseRange(8, 56, 24);
+BENCHMARK_CAPTURE(BM_InterpretSliced, array_sum, &array_sum)->DenseRange(8, 56, 24);
+BENCHMARK_CAPTURE(BM_ForkSnapshot, warm_start, &warm_start)->DenseRange(8, 56, 24);
+
+BENCHMARK_CAPTURE(BM_Jit, call_chain, &call_chain)->DenseRange(1, 9, 4);
+BENCHMARK_CAPTURE(BM_Jit, long_expression, &long_expression)->DenseRange(1, 15, 7);
+BENCHMARK_CAPTURE(BM_Jit, many_functions, &many_functions)->DenseRange(1, 9, 4);
+
+BENCHMARK_CAPTURE(BM_Tiered, call_chain, &call_chain)->DenseRange(1, 9, 4);
+BENCHMARK_CAPTURE(BM_Tiered, many_functions, &many_functions)->DenseRange(1, 9, 4);
+
+BENCHMARK_MAIN();
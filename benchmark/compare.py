@@ -0,0 +1,69 @@
+#!/usr/bin/env python3
+"""Compare a Google Benchmark JSON result against a stored baseline.
+
+Exits with a non-zero status when any benchmark present in both files got
+slower than the baseline by more than the given threshold, or when a benchmark
+is in only one of the files. The baseline has to come from the same host and
+the same version of the suite, regenerate it after changing either.
+"""
+
+import argparse
+import json
+import sys
+
+
+def load(path):
+    try:
+        with open(path) as f:
+            data = json.load(f)
+    except OSError as e:
+        sys.exit(f"{path}: {e.strerror}, record a baseline with the benchmarks_baseline target")
+    return {
+        b["name"]: b
+        for b in data["benchmarks"]
+        if b.get("run_type", "iteration") == "iteration"
+    }
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__)
+    parser.add_argument("baseline")
+    parser.add_argument("current")
+    parser.add_argument("--threshold", type=float, default=0.10,
+                        help="allowed relative slowdown (default: 0.10)")
+    parser.add_argument("--metric", default="cpu_time",
+                        choices=["cpu_time", "real_time"])
+    args = parser.parse_args()
+
+    baseline = load(args.baseline)
+    current = load(args.current)
+
+    regressions = 0
+    unmatched = 0
+    for name, bench in current.items():
+        if name not in baseline:
+            print(f"{name:<50} {'new':>10}")
+            unmatched += 1
+            continue
+        old = baseline[name][args.metric]
+        new = bench[args.metric]
+        change = (new - old) / old if old else 0.0
+        mark = ""
+        if change > args.threshold:
+            mark = "  REGRESSION"
+            regressions += 1
+        print(f"{name:<50} {change:>+10.1%}{mark}")
+
+    for name in sorted(baseline.keys() - current.keys()):
+        print(f"{name:<50} {'missing':>10}")
+        unmatched += 1
+
+    if regressions:
+        print(f"{regressions} benchmark(s) slower than baseline by more than {args.threshold:.0%}")
+    if unmatched:
+        print(f"{unmatched} benchmark(s) not in both files, regenerate the baseline")
+    return 1 if regressions or unmatched else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,128 @@
+#!/usr/bin/env python3
+"""Measure the compile-time cost of constexpr compilation of scripts.
+
+For every requested size a translation unit is generated that tokenizes,
+parses and interprets a script of roughly that many tokens in constant
+evaluation. The compiler wall time and, where the platform reports it, the
+peak resident set size of the compiler are recorded.
+"""
+
+import argparse
+import json
+import os
+import subprocess
+import sys
+import tempfile
+import time
+
+try:
+    import resource
+except ImportError:  # Windows
+    resource = None
+
+FUNCTIONS = 9  # CompiledProgram::NUM_OF_FUNC - 1 (main)
+
+TU_TEMPLATE = """\
+#include "Interpreter.h"
+#include "Parser.h"
+#include "SourceCode.h"
+#include "Tokenizer.h"
+
+static constexpr sci::SourceCode src{{ R"SCI(
+{script}
+)SCI" }};
+static constexpr sci::Tokenizer<{max_tokens}> tok{{ src }};
+static constexpr auto tokens = tok.tokenize();
+static constexpr sci::Parser<{max_tokens}, {max_stack}> par{{ tokens }};
+static constexpr auto exe = par.parse();
+static_assert(sci::Interpreter<{functions}, 64, 10>{{}}.interpret(exe) == {expected});
+
+auto main() -> int {{ return 0; }}
+"""
+
+
+def generate_script(tokens):
+    """Return (script, token_count, result) for a script of about `tokens` tokens.
+
+    The bytecode capacity of CompiledProgram is fixed, so the script is a
+    call chain over all functions padded with empty statements, which cost
+    tokens and parser work but no instructions.
+    """
+    lines = [f"int f{FUNCTIONS}() {{ return {FUNCTIONS}; }}"]
+    for i in range(FUNCTIONS - 1, 0, -1):
+        lines.append(f"int f{i}() {{ return f{i + 1}(); }}")
+    # 9 for the innermost function, 11 per calling function, 12 for main
+    # and the END_OF_SOURCECODE token
+    count = 9 + 11 * (FUNCTIONS - 1) + 12 + 1
+    filler = ""
+    if tokens > count:
+        filler = "\n".join(";" * min(64, tokens - n) for n in range(count, tokens, 64))
+        count = max(count, tokens)
+    lines.append(f"int main() {{\n{filler}\nreturn f1();\n}}")
+    return "\n".join(lines), count, FUNCTIONS
+
+
+def compiler_flags(compiler):
+    name = os.path.basename(compiler).lower()
+    if "clang" in name:
+        return ["-std=c++20", "-fsyntax-only", "-fconstexpr-steps=1000000000"]
+    if "cl" == name or name.startswith("cl."):
+        return ["/std:c++latest", "/Zs", "/constexpr:steps1000000000"]
+    return ["-std=c++20", "-fsyntax-only", "-fconstexpr-ops-limit=4294967296",
+            "-fconstexpr-loop-limit=100000000"]
+
+
+def measure(compiler, include_dir, size, workdir):
+    script, count, expected = generate_script(size)
+    source = os.path.join(workdir, f"constexpr_compile_{size}.cpp")
+    with open(source, "w") as f:
+        f.write(TU_TEMPLATE.format(script=script, max_tokens=count,
+                                   max_stack=64, functions=FUNCTIONS + 1,
+                                   expected=expected))
+    include = "/I" if os.path.basename(compiler).lower().startswith("cl") else "-I"
+    cmd = [compiler, *compiler_flags(compiler), include + include_dir, source]
+
+    before = resource.getrusage(resource.RUSAGE_CHILDREN).ru_maxrss if resource else 0
+    start = time.perf_counter()
+    proc = subprocess.run(cmd, capture_output=True, text=True)
+    wall = time.perf_counter() - start
+    peak = resource.getrusage(resource.RUSAGE_CHILDREN).ru_maxrss if resource else 0
+
+    if proc.returncode != 0:
+        sys.stderr.write(proc.stdout + proc.stderr)
+    return {
+        "tokens": count,
+        "ok": proc.returncode == 0,
+        "wall_seconds": round(wall, 3),
+        # ru_maxrss is the maximum over all children so far, only growth is attributable
+        "peak_rss_kib": peak if peak > before else None,
+    }
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__)
+    parser.add_argument("--compiler", required=True)
+    parser.add_argument("--include", required=True, help="directory with the sci headers")
+    parser.add_argument("--sizes", default="100,1000,3000,10000")
+    parser.add_argument("--out", help="write the results as JSON")
+    args = parser.parse_args()
+
+    sizes = sorted(int(s) for s in args.sizes.split(","))
+    results = []
+    with tempfile.TemporaryDirectory() as workdir:
+        print(f"{'tokens':>8} {'wall [s]':>10} {'peak RSS [MiB]':>15}")
+        for size in sizes:
+            r = measure(args.compiler, args.include, size, workdir)
+            results.append(r)
+            rss = f"{r['peak_rss_kib'] / 1024:.1f}" if r["peak_rss_kib"] else "-"
+            status = "" if r["ok"] else "  FAILED"
+            print(f"{r['tokens']:>8} {r['wall_seconds']:>10.3f} {rss:>15}{status}")
+
+    if args.out:
+        with open(args.out, "w") as f:
+            json.dump({"compiler": args.compiler, "results": results}, f, indent=2)
+    return 0 if all(r["ok"] for r in results) else 1
+
+
+if __name__ == "__main__":
+    sys.exit(main())
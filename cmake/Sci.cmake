@@ -0,0 +1,27 @@
+# sci_add_script(<target> <script>)
+#
+# Translates <script> ahead of time into C++ with sci-aot and compiles it into <target>.
+# The script's main becomes `auto sci_script_<name>() -> int`, where <name> is the script
+# file name without extension, declared in the generated header "sci_script_<name>.h".
+# The generated code includes the interpreter's Kernels.h.
+set(SCI_SOURCE_DIR ${CMAKE_CURRENT_LIST_DIR}/../src)
+
+function(sci_add_script target script)
+  get_filename_component(script_path ${script} ABSOLUTE)
+  get_filename_component(name ${script} NAME_WE)
+  string(MAKE_C_IDENTIFIER ${name} name)
+  set(symbol sci_script_${name})
+  set(output_dir ${CMAKE_CURRENT_BINARY_DIR}/sci_scripts)
+  set(output ${output_dir}/${symbol})
+
+  add_custom_command(
+    OUTPUT ${output}.cpp ${output}.h
+    COMMAND ${CMAKE_COMMAND} -E make_directory ${output_dir}
+    COMMAND sci-aot ${script_path} ${output} ${symbol}
+    DEPENDS sci-aot ${script_path}
+    COMMENT "Translating script ${script} to C++"
+    VERBATIM)
+
+  target_sources(${target} PRIVATE ${output}.cpp ${output}.h)
+  target_include_directories(${target} PRIVATE ${output_dir} ${SCI_SOURCE_DIR})
+endfunction()
@@ -0,0 +1,67 @@
+#pragma once
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+
+namespace sci {
+
+// Budgets for Interpreter::resume. spend() is asked before every instruction, once it
+// returns false the run is suspended in front of that instruction.
+
+// Runs to the end, what Interpreter::execute uses
+struct Unlimited
+{
+  static constexpr auto spend() noexcept -> bool { return true; }
+};
+
+// At most `instructions` more instructions
+struct InstructionBudget
+{
+  std::uint64_t instructions{ 0 };
+
+  constexpr auto spend() noexcept -> bool
+  {
+    if (instructions == 0) {
+      return false;
+    }
+    --instructions;
+    return true;
+  }
+};
+
+// Until the steady clock passes `deadline`. The clock is read every CHECK_INTERVAL
+// instructions only, so a run overshoots the deadline by at most that many.
+struct DeadlineBudget
+{
+  constexpr static std::uint32_t CHECK_INTERVAL{ 1024 };
+  std::chrono::steady_clock::time_point deadline;
+  std::uint32_t until_check{ 0 };
+
+  auto spend() noexcept -> bool
+  {
+    if (until_check != 0) {
+      --until_check;
+      return true;
+    }
+    if (std::chrono::steady_clock::now() >= deadline) {
+      return false;
+    }
+    until_check = CHECK_INTERVAL - 1;
+    return true;
+  }
+};
+
+// Hard limits of a run, once one is exceeded the run ends with Result::LIMIT. Unlike a
+// budget they are charged at calls and loop back edges only, the code between two of
+// those is straight and as long as a few function bodies at most. A time limit is
+// ignored during constant evaluation.
+struct Limits
+{
+  constexpr static std::uint32_t CLOCK_INTERVAL{ 256 };// charges between two reads of the clock
+  std::uint64_t fuel{ std::numeric_limits<std::uint64_t>::max() };// calls and loop back edges
+  std::chrono::nanoseconds time{ 0 };// wall clock from Interpreter::start, 0 for none
+  std::size_t memory{ std::numeric_limits<std::size_t>::max() };// bytes of VM memory the frames may take, Result::OUT_OF_MEMORY past it
+};
+
+}// namespace sci
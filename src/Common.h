@@ -1,5 +1,6 @@
 #pragma once
 #include <array>
+#include <string_view>
 #include <variant>
 
 namespace sci {
@@ -7,7 +8,11 @@ namespace sci {
 enum class Result {
   OK,
   ERR,
-  END
+  END,
+  SUSPENDED,// Interpreter::resume ran out of budget
+  WAITING,// Interpreter::resume stopped at an async host call, see Interpreter::complete
+  LIMIT,// the run exceeded the Limits of its Interpreter
+  OUT_OF_MEMORY,// the run's frames exceeded Limits::memory
 };
 
 struct Literal
@@ -18,8 +23,13 @@ struct Literal
      CHAR_,
      STRING_,
      DOUBLE_,
+     // addresses in the VM memory, compiled code only
+     INT_PTR_,
+     CHAR_PTR_,
+     DOUBLE_PTR_,
   };
   Type type{ Type::NONE_ };
+  // STRING_ holds the raw text in tokens and the StringPool index in instructions
   std::variant<int, double, char, std::string_view> val;
 };
 
@@ -49,6 +59,15 @@ public:
     return data_[MaxSize - 1];
   }
 
+  constexpr auto top() const noexcept -> Type const&
+  {
+    if (!empty()) {
+      return data_[size_ - 1];
+    }
+
+    return data_[MaxSize - 1];
+  }
+
   constexpr auto push(Type const& val) noexcept -> void
   {
     if (!full()) {
@@ -57,6 +76,57 @@ public:
     }
   }
 
+  // Reports a full stack instead of dropping the value
+  [[nodiscard]] constexpr auto try_push(Type const& val) noexcept -> bool
+  {
+    if (full()) {
+      return false;
+    }
+    data_[size_] = val;
+    ++size_;
+    return true;
+  }
+
+  // Fast variants for callers that proved the stack bounds, see Interpreter
+  constexpr auto push_unchecked(Type const& val) noexcept -> void
+  {
+    data_[size_] = val;
+    ++size_;
+  }
+
+  constexpr auto pop_unchecked() noexcept -> void
+  {
+    --size_;
+  }
+
+  constexpr auto top_unchecked() noexcept -> Type&
+  {
+    return data_[size_ - 1];
+  }
+
+  // the top `count` values, the deepest first
+  constexpr auto top_n_unchecked(std::size_t const count) noexcept -> Type*
+  {
+    return data_.data() + (size_ - count);
+  }
+
+  constexpr auto pop_unchecked(std::size_t const count) noexcept -> void
+  {
+    size_ -= count;
+  }
+
+  // Empties the stack without touching the values
+  constexpr auto clear() noexcept -> void
+  {
+    size_ = 0;
+  }
+
+  // depth 0 is the top
+  constexpr auto from_top_unchecked(std::size_t const depth) noexcept -> Type&
+  {
+    return data_[size_ - 1 - depth];
+  }
+
   constexpr auto size() const noexcept -> std::size_t
   {
     return size_;
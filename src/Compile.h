@@ -0,0 +1,82 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <string_view>
+
+#include "CompiledProgram.h"
+#include "Interpreter.h"
+#include "Native.h"
+#include "Optimizer.h"
+#include "Parser.h"
+#include "SourceCode.h"
+#include "Tokenizer.h"
+
+namespace sci {
+
+// String literal usable as a template argument, Compiled<"int main() { return 1; }">
+template<std::size_t N>
+struct FixedSource
+{
+  std::array<char, N> chars{};
+
+  constexpr FixedSource(char const (&text)[N]) noexcept
+  {
+    std::copy_n(text, N, chars.begin());
+  }
+
+  [[nodiscard]] constexpr auto view() const noexcept -> std::string_view
+  {
+    return { chars.data(), N - 1 };
+  }
+};
+
+// Compiles a script during constant evaluation with the smallest tokenizer, parser and
+// interpreter it fits in, instead of sizes guessed by hand:
+//   static_assert(sci::Compiled<"int main() { return 42; }">::run() == 42);
+// Tokens are counted before tokenizing, the parser stack grows by doubling until the
+// parse does not overflow and the interpreter is sized by stack_bounds. Recursive
+// programs have no static bound and are rejected, use Interpreter with explicit sizes.
+// Natives names a constexpr array of host functions, see Native.h.
+template<FixedSource Source, auto const& Natives = no_natives>
+class Compiled
+{
+  static constexpr SourceCode src_{ Source.view() };
+  constexpr static std::size_t MAX_PARSER_STACK{ 4096 };
+
+public:
+  static constexpr std::size_t num_of_tokens{ Tokenizer<1>{ src_ }.count() };
+  static constexpr auto tokens{ Tokenizer<num_of_tokens>{ src_ }.tokenize() };
+
+private:
+  template<std::size_t StackSize>
+  static constexpr auto parse() noexcept -> CompiledProgram
+  {
+    auto const result = Parser<num_of_tokens, StackSize>{ tokens, Natives }.parse();
+    if constexpr (StackSize < MAX_PARSER_STACK) {
+      if (result.info.parser_stack > StackSize) {
+        return parse<StackSize * 2>();
+      }
+    }
+    return result;
+  }
+
+public:
+  static constexpr CompiledProgram program{ parse<16>() };
+  static_assert(program.info.r == Result::OK, "the script does not compile");
+  static_assert(program.info.func_stack > 0, "recursive scripts need an explicitly sized Interpreter");
+
+  static constexpr std::size_t parser_stack_size{ program.info.parser_stack };
+  static constexpr std::size_t func_stack_size{ program.info.func_stack };
+  // optimize may trade loops for kernels that take more of the comp_stack
+  static constexpr std::size_t comp_stack_size{ std::max<std::size_t>({ program.info.comp_stack, optimize(program).info.comp_stack, 1 }) };
+  static constexpr std::size_t memory_size{ program.info.memory };
+
+  using Interpreter = sci::Interpreter<func_stack_size, memory_size, comp_stack_size, StackChecks::UNCHECKED>;
+
+  static constexpr auto run() noexcept -> int
+  {
+    return Interpreter{}.interpret(program);
+  }
+};
+
+}// namespace sci
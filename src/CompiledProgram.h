@@ -4,8 +4,17 @@
 #include <variant>
 
 #include "Common.h"
+#include "StringPool.h"
 
 namespace sci {
+// Untagged VM value. Every expression is typed at compile time, so the instruction
+// reading a value always knows which member is active and never dispatches on it.
+union Value
+{
+  int i{ 0 };// int, char and StringPool index
+  double d;
+};
+
 struct Instruction
 {
   enum class Type {
@@ -14,20 +23,324 @@ struct Instruction
      ADD,
      CALL,
      RET,
+     SUB,
+     MUL,
+     DIV,
+     MOD,
+     NEG,
+     // double arithmetic, comparisons push an int
+     DADD,
+     DSUB,
+     DMUL,
+     DDIV,
+     DNEG,
+     DLT,
+     DLE,
+     DGT,
+     DGE,
+     DEQ,
+     DNE,
+     I2D,// converts the top
+     I2D_UNDER,// converts the value below the top
+     D2I,
+     I2C,
+     LT,
+     LE,
+     GT,
+     GE,
+     EQ,
+     NE,
+     LOAD,// par: offset in the frame
+     STORE,// par: offset in the frame, pops the value
+     POP,
+     ADDR,// par: offset in the frame, pushes its address in the VM memory
+     LOAD_IND,// pops an address
+     STORE_IND,// pops the value, then the address
+     DUP,
+     CALL_NATIVE,// par: index into CompiledProgram::natives, pops the arguments
+     // loops over VM memory, see Kernels.h, the element count is on top
+     SUM,// pops the count and an address, pushes the int sum
+     DSUM,
+     DOT,// pops the count and two addresses
+     DDOT,
+     FILL,// pops the count, the value and the address
+     COPY,// pops the count, the source and the destination
+     // par of jumps: offset relative to the next instruction
+     JMP,
+     JZ,// pops the condition
+     JNZ,
+     // fused compare and branch: pop b, pop a, jump if `a op b`
+     JLT,
+     JLE,
+     JGT,
+     JGE,
+     JEQ,
+     JNE,
+
+     TYPES_END,
   };
 
   Type type{ Type::NONE };
-  Literal par;
+  Value par{};
+  Literal::Type par_type{ Literal::Type::INT_ };// of the VAL operand
+};
+
+constexpr auto to_string(Instruction::Type const type) noexcept -> std::string_view
+{
+  switch (type) {
+  case Instruction::Type::NONE:
+    return "NONE";
+  case Instruction::Type::VAL:
+    return "VAL";
+  case Instruction::Type::ADD:
+    return "ADD";
+  case Instruction::Type::CALL:
+    return "CALL";
+  case Instruction::Type::RET:
+    return "RET";
+  case Instruction::Type::SUB:
+    return "SUB";
+  case Instruction::Type::MUL:
+    return "MUL";
+  case Instruction::Type::DIV:
+    return "DIV";
+  case Instruction::Type::MOD:
+    return "MOD";
+  case Instruction::Type::NEG:
+    return "NEG";
+  case Instruction::Type::DADD:
+    return "DADD";
+  case Instruction::Type::DSUB:
+    return "DSUB";
+  case Instruction::Type::DMUL:
+    return "DMUL";
+  case Instruction::Type::DDIV:
+    return "DDIV";
+  case Instruction::Type::DNEG:
+    return "DNEG";
+  case Instruction::Type::DLT:
+    return "DLT";
+  case Instruction::Type::DLE:
+    return "DLE";
+  case Instruction::Type::DGT:
+    return "DGT";
+  case Instruction::Type::DGE:
+    return "DGE";
+  case Instruction::Type::DEQ:
+    return "DEQ";
+  case Instruction::Type::DNE:
+    return "DNE";
+  case Instruction::Type::I2D:
+    return "I2D";
+  case Instruction::Type::I2D_UNDER:
+    return "I2D_UNDER";
+  case Instruction::Type::D2I:
+    return "D2I";
+  case Instruction::Type::I2C:
+    return "I2C";
+  case Instruction::Type::LT:
+    return "LT";
+  case Instruction::Type::LE:
+    return "LE";
+  case Instruction::Type::GT:
+    return "GT";
+  case Instruction::Type::GE:
+    return "GE";
+  case Instruction::Type::EQ:
+    return "EQ";
+  case Instruction::Type::NE:
+    return "NE";
+  case Instruction::Type::LOAD:
+    return "LOAD";
+  case Instruction::Type::STORE:
+    return "STORE";
+  case Instruction::Type::POP:
+    return "POP";
+  case Instruction::Type::ADDR:
+    return "ADDR";
+  case Instruction::Type::LOAD_IND:
+    return "LOAD_IND";
+  case Instruction::Type::STORE_IND:
+    return "STORE_IND";
+  case Instruction::Type::DUP:
+    return "DUP";
+  case Instruction::Type::CALL_NATIVE:
+    return "CALL_NATIVE";
+  case Instruction::Type::SUM:
+    return "SUM";
+  case Instruction::Type::DSUM:
+    return "DSUM";
+  case Instruction::Type::DOT:
+    return "DOT";
+  case Instruction::Type::DDOT:
+    return "DDOT";
+  case Instruction::Type::FILL:
+    return "FILL";
+  case Instruction::Type::COPY:
+    return "COPY";
+  case Instruction::Type::JMP:
+    return "JMP";
+  case Instruction::Type::JZ:
+    return "JZ";
+  case Instruction::Type::JNZ:
+    return "JNZ";
+  case Instruction::Type::JLT:
+    return "JLT";
+  case Instruction::Type::JLE:
+    return "JLE";
+  case Instruction::Type::JGT:
+    return "JGT";
+  case Instruction::Type::JGE:
+    return "JGE";
+  case Instruction::Type::JEQ:
+    return "JEQ";
+  case Instruction::Type::JNE:
+    return "JNE";
+  default:
+    return "?";
+  }
+}
+
+constexpr auto is_jump(Instruction::Type const type) noexcept -> bool
+{
+  return type >= Instruction::Type::JMP && type < Instruction::Type::TYPES_END;
+}
+
+struct StackEffect
+{
+  int pops;
+  int pushes;
 };
 
+// comp_stack use of an instruction, the values a CALL leaves depend on the callee and
+// those of a CALL_NATIVE on its signature, see the overload taking the program
+constexpr auto stack_effect(Instruction::Type const type) noexcept -> StackEffect
+{
+  switch (type) {
+  case Instruction::Type::VAL:
+  case Instruction::Type::LOAD:
+  case Instruction::Type::ADDR:
+    return { 0, 1 };
+  case Instruction::Type::ADD:
+  case Instruction::Type::SUB:
+  case Instruction::Type::MUL:
+  case Instruction::Type::DIV:
+  case Instruction::Type::MOD:
+  case Instruction::Type::LT:
+  case Instruction::Type::LE:
+  case Instruction::Type::GT:
+  case Instruction::Type::GE:
+  case Instruction::Type::EQ:
+  case Instruction::Type::NE:
+  case Instruction::Type::SUM:
+  case Instruction::Type::DSUM:
+  case Instruction::Type::DADD:
+  case Instruction::Type::DSUB:
+  case Instruction::Type::DMUL:
+  case Instruction::Type::DDIV:
+  case Instruction::Type::DLT:
+  case Instruction::Type::DLE:
+  case Instruction::Type::DGT:
+  case Instruction::Type::DGE:
+  case Instruction::Type::DEQ:
+  case Instruction::Type::DNE:
+    return { 2, 1 };
+  case Instruction::Type::NEG:
+  case Instruction::Type::DNEG:
+  case Instruction::Type::I2D:
+  case Instruction::Type::D2I:
+  case Instruction::Type::I2C:
+  case Instruction::Type::LOAD_IND:
+    return { 1, 1 };
+  case Instruction::Type::DUP:
+    return { 1, 2 };
+  case Instruction::Type::I2D_UNDER:
+    return { 2, 2 };
+  case Instruction::Type::STORE:
+  case Instruction::Type::POP:
+  case Instruction::Type::JZ:
+  case Instruction::Type::JNZ:
+    return { 1, 0 };
+  case Instruction::Type::STORE_IND:
+    return { 2, 0 };
+  case Instruction::Type::DOT:
+  case Instruction::Type::DDOT:
+    return { 3, 1 };
+  case Instruction::Type::FILL:
+  case Instruction::Type::COPY:
+    return { 3, 0 };
+  case Instruction::Type::JLT:
+  case Instruction::Type::JLE:
+  case Instruction::Type::JGT:
+  case Instruction::Type::JGE:
+  case Instruction::Type::JEQ:
+  case Instruction::Type::JNE:
+    return { 2, 0 };
+  default:
+    return { 0, 0 };
+  }
+}
+
 struct CompiledFunction
 {
-  std::array<Instruction, 30> instructions;
+  constexpr static auto NUM_OF_INS{ 64 };
+  constexpr static auto NUM_OF_LOCALS{ 8 };
+  std::string_view name;
+  std::array<Instruction, NUM_OF_INS> instructions;
+  Literal::Type return_type{ Literal::Type::INT_ };// NONE_ for void
+  int frame_size{ 0 };// VM memory its locals and arrays take, one Value per element
+  int max_comp_depth{ -1 };// comp_stack slots it needs, callees included, -1 when unbounded or unreachable
+};
+
+// Where an async host function delivers its result, Completion in Native.h wraps it
+struct AsyncCall
+{
+  auto (*deliver)(void* target, std::size_t id, Value value) -> void { nullptr };
+  void* target{ nullptr };
+  std::size_t id{ 0 };
+};
+
+// Host function registered with native<Fn>(name) or async_native<Fn>(name), see
+// Native.h. Its arguments are the top `arity` Values of the comp_stack with the first
+// one deepest, they are replaced by the result unless return_type is NONE_ (void).
+struct NativeFunction
+{
+  constexpr static auto MAX_PARAMS{ 4 };
+  std::string_view name;
+  Literal::Type return_type{ Literal::Type::NONE_ };
+  std::array<Literal::Type, MAX_PARAMS> params{};
+  int arity{ 0 };
+  auto (*call)(Value const* args) -> Value { nullptr };
+  auto (*start)(Value const* args, AsyncCall call) -> void { nullptr };// async host functions only, instead of call
+};
+
+// Sizes the parse took and the run will take, filled in by Parser::parse
+struct ProgramInfo
+{
+  Result r{ Result::ERR };
+  std::size_t tokens{ 0 };// END_OF_SOURCECODE included
+  std::size_t parser_stack{ 0 };// symbol stack high-water mark, MaxStackSize + 1 if it overflowed
+  std::size_t func_stack{ 0 };// frames, 0 for recursive programs
+  std::size_t comp_stack{ 0 };
+  std::size_t memory{ 0 };// Values of VM memory the frames take, 0 for recursive programs
 };
 
 struct CompiledProgram
 {
   constexpr static auto NUM_OF_FUNC{ 10 };
+  constexpr static auto NUM_OF_NATIVES{ 8 };
   std::array<CompiledFunction, NUM_OF_FUNC> functions;
+  std::array<NativeFunction, NUM_OF_NATIVES> natives{};// the host functions it calls
+  StringPool strings;// VAL of a STRING_ literal holds its index
+  ProgramInfo info;
 };
+
+constexpr auto stack_effect(Instruction const& ins, CompiledProgram const& program) noexcept -> StackEffect
+{
+  if (ins.type == Instruction::Type::CALL_NATIVE) {
+    auto const& native = program.natives[static_cast<std::size_t>(ins.par.i)];
+    return { native.arity, native.return_type == Literal::Type::NONE_ ? 0 : 1 };
+  }
+  return stack_effect(ins.type);
+}
 }// namespace sci
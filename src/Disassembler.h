@@ -0,0 +1,171 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <iomanip>
+#include <ostream>
+#include <string_view>
+
+#include "CompiledProgram.h"
+#include "Common.h"
+
+namespace sci {
+
+// comp_stack depth before every instruction of `func`, -1 where no path from the start
+// reaches it. A CALL adds the value its callee returns, a CALL_NATIVE follows its
+// signature. Paths that disagree keep the depth of the first one, stack_bounds rejects
+// such programs anyway.
+constexpr auto stack_depths(CompiledProgram const& program, int const func) noexcept -> std::array<int, CompiledFunction::NUM_OF_INS>
+{
+  constexpr auto N{ CompiledFunction::NUM_OF_INS };
+  auto const& ins = program.functions[static_cast<std::size_t>(func)].instructions;
+  std::array<int, N> depth{};
+  depth.fill(-1);
+  ConstexprStack<int, N> pending;
+  auto const reach = [&depth, &pending](int const index, int const d) {
+    if (index >= 0 && index < N && depth[static_cast<std::size_t>(index)] == -1) {
+      depth[static_cast<std::size_t>(index)] = d;
+      pending.push(index);
+    }
+  };
+
+  reach(0, 0);
+  while (!pending.empty()) {
+    int const i{ pending.top() };
+    pending.pop();
+    auto const& instruction = ins[static_cast<std::size_t>(i)];
+    auto const type = instruction.type;
+    if (type == Instruction::Type::RET || type == Instruction::Type::NONE) {
+      continue;
+    }
+    auto const effect = stack_effect(instruction, program);
+    int d{ std::max(depth[static_cast<std::size_t>(i)] - effect.pops, 0) + effect.pushes };
+    int const callee{ instruction.par.i };
+    if (type == Instruction::Type::CALL && callee >= 0 && callee < CompiledProgram::NUM_OF_FUNC) {
+      d += program.functions[static_cast<std::size_t>(callee)].return_type == Literal::Type::NONE_ ? 0 : 1;
+    }
+    if (is_jump(type)) {
+      reach(i + 1 + instruction.par.i, d);
+    }
+    if (type != Instruction::Type::JMP) {
+      reach(i + 1, d);
+    }
+  }
+  return depth;
+}
+
+// Instructions of `func` up to the first NONE
+constexpr auto instruction_count(CompiledFunction const& func) noexcept -> int
+{
+  std::size_t count{ 0 };
+  while (count < func.instructions.size() && func.instructions[count].type != Instruction::Type::NONE) {
+    ++count;
+  }
+  return static_cast<int>(count);
+}
+
+constexpr auto to_string(Literal::Type const type) noexcept -> std::string_view
+{
+  switch (type) {
+  case Literal::Type::NONE_:
+    return "void";
+  case Literal::Type::INT_:
+    return "int";
+  case Literal::Type::CHAR_:
+    return "char";
+  case Literal::Type::STRING_:
+    return "string";
+  case Literal::Type::DOUBLE_:
+    return "double";
+  case Literal::Type::INT_PTR_:
+    return "int*";
+  case Literal::Type::CHAR_PTR_:
+    return "char*";
+  case Literal::Type::DOUBLE_PTR_:
+    return "double*";
+  }
+  return "?";
+}
+
+// One function as text, an instruction per line:
+//   offset  depth  opcode  operand
+// Depth is the comp_stack depth before the instruction, `-` if it is unreachable.
+// Jumps show their target, calls the callee and VAL of a string literal its pool entry.
+inline auto disassemble(CompiledProgram const& program, int const func, std::ostream& out) -> void
+{
+  auto const& f = program.functions[static_cast<std::size_t>(func)];
+  auto const depths = stack_depths(program, func);
+  out << f.name << ": returns " << to_string(f.return_type) << ", frame " << f.frame_size << ", max depth "
+      << f.max_comp_depth << ", " << instruction_count(f) << " instructions\n";
+
+  for (int i{ 0 }; i < instruction_count(f); ++i) {
+    auto const& ins = f.instructions[static_cast<std::size_t>(i)];
+    auto const depth = depths[static_cast<std::size_t>(i)];
+    out << std::right << std::setw(8) << i << std::setw(7);
+    if (depth == -1) {
+      out << '-';
+    } else {
+      out << depth;
+    }
+    out << "  " << to_string(ins.type);
+    if (ins.type == Instruction::Type::VAL || ins.type == Instruction::Type::LOAD || ins.type == Instruction::Type::STORE
+        || ins.type == Instruction::Type::ADDR || ins.type == Instruction::Type::CALL || ins.type == Instruction::Type::CALL_NATIVE
+        || is_jump(ins.type)) {
+      out << std::setw(static_cast<int>(13 - to_string(ins.type).size())) << ' ';
+    }
+    switch (ins.type) {
+    case Instruction::Type::VAL:
+      switch (ins.par_type) {
+      case Literal::Type::DOUBLE_:
+        out << ins.par.d;
+        break;
+      case Literal::Type::CHAR_:
+        out << ins.par.i << " '" << static_cast<char>(ins.par.i) << '\'';
+        break;
+      case Literal::Type::STRING_:
+        out << '#' << ins.par.i << " \"" << program.strings.get(ins.par.i) << '"';
+        break;
+      default:
+        out << ins.par.i;
+        break;
+      }
+      break;
+    case Instruction::Type::LOAD:
+    case Instruction::Type::STORE:
+    case Instruction::Type::ADDR:
+      out << '[' << ins.par.i << ']';
+      break;
+    case Instruction::Type::CALL:
+      out << ins.par.i << ' ' << program.functions[static_cast<std::size_t>(ins.par.i)].name;
+      break;
+    case Instruction::Type::CALL_NATIVE:
+      out << ins.par.i << ' ' << program.natives[static_cast<std::size_t>(ins.par.i)].name;
+      break;
+    default:
+      if (is_jump(ins.type)) {
+        out << (ins.par.i < 0 ? "" : "+") << ins.par.i << " -> " << i + 1 + ins.par.i;
+      }
+      break;
+    }
+    out << '\n';
+  }
+}
+
+// Every function of `program`, preceded by its string pool and host functions
+inline auto disassemble(CompiledProgram const& program, std::ostream& out) -> void
+{
+  for (int i{ 0 }; i < program.strings.size(); ++i) {
+    out << "string #" << i << " \"" << program.strings.get(i) << "\"\n";
+  }
+  for (auto const& native : program.natives) {
+    if (!native.name.empty()) {
+      out << "native " << native.name << ": " << native.arity << " arguments, returns " << to_string(native.return_type) << '\n';
+    }
+  }
+  for (std::size_t i{ 0 }; i < program.functions.size(); ++i) {
+    if (!program.functions[i].name.empty()) {
+      disassemble(program, static_cast<int>(i), out);
+    }
+  }
+}
+
+}// namespace sci
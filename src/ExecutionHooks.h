@@ -0,0 +1,27 @@
+#pragma once
+#include <cstdint>
+
+namespace sci {
+
+// Default hooks for Interpreter::interpret. Every member is an empty inline function,
+// so an interpreter instantiated with ExecutionHooks compiles to the plain dispatch loop.
+// Instrumentation derives from this struct and shadows only what it needs.
+struct ExecutionHooks
+{
+  // Called before every instruction fetch, top of func_stack points at the next instruction.
+  template<typename FuncStack, typename CompStack>
+  constexpr auto on_instruction(FuncStack const& /*func_stack*/, CompStack const& /*comp_stack*/) noexcept -> void
+  {}
+
+  // Called for every CALL whose frame fits, before it is pushed. Returning true means the
+  // hook executed the call itself and left its results on comp_stack. `fuel` is what is
+  // left of Limits::fuel after this call, a hook takes one for every call it makes itself.
+  template<typename FuncStack, typename CompStack>
+  constexpr auto on_call(int /*func_index*/, FuncStack const& /*func_stack*/, CompStack& /*comp_stack*/, std::uint64_t& /*fuel*/) noexcept
+    -> bool
+  {
+    return false;
+  }
+};
+
+}// namespace sci
@@ -0,0 +1,252 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <limits>
+#include <string_view>
+
+#include "my_ctype.h"
+
+namespace sci {
+
+namespace detail {
+  // Unsigned integer of fixed width for the exact path of parse_double
+  class BigUint
+  {
+    constexpr static std::size_t LIMBS{ 64 };// 2048 bits, enough for 10^430 shifted by 2^64
+    std::array<std::uint32_t, LIMBS> limbs_{};
+
+  public:
+    constexpr auto mul_add(std::uint32_t const factor, std::uint32_t const addend) noexcept -> void
+    {
+      std::uint64_t carry{ addend };
+      for (auto& limb : limbs_) {
+        std::uint64_t const value{ std::uint64_t{ limb } * factor + carry };
+        limb = static_cast<std::uint32_t>(value);
+        carry = value >> 32U;
+      }
+    }
+
+    constexpr auto mul_pow10(int exponent) noexcept -> void
+    {
+      for (; exponent >= 9; exponent -= 9) {
+        mul_add(1'000'000'000U, 0);
+      }
+      for (; exponent > 0; --exponent) {
+        mul_add(10, 0);
+      }
+    }
+
+    constexpr auto shift_left(int const bits) noexcept -> void
+    {
+      auto const words = static_cast<std::size_t>(bits / 32);
+      auto const rest = static_cast<unsigned>(bits % 32);
+      for (std::size_t i{ LIMBS }; i-- > 0;) {
+        std::uint64_t value{ i >= words ? limbs_[i - words] : 0U };
+        value <<= rest;
+        if (rest != 0 && i >= words + 1) {
+          value |= limbs_[i - words - 1] >> (32U - rest);
+        }
+        limbs_[i] = static_cast<std::uint32_t>(value);
+      }
+    }
+
+    [[nodiscard]] constexpr auto bit_length() const noexcept -> int
+    {
+      for (std::size_t i{ LIMBS }; i-- > 0;) {
+        if (limbs_[i] != 0) {
+          int bits{ 0 };
+          for (auto limb = limbs_[i]; limb != 0; limb >>= 1U) {
+            ++bits;
+          }
+          return static_cast<int>(i) * 32 + bits;
+        }
+      }
+      return 0;
+    }
+
+    [[nodiscard]] constexpr auto is_zero() const noexcept -> bool { return bit_length() == 0; }
+
+    [[nodiscard]] constexpr auto compare(BigUint const& other) const noexcept -> int
+    {
+      for (std::size_t i{ LIMBS }; i-- > 0;) {
+        if (limbs_[i] != other.limbs_[i]) {
+          return limbs_[i] < other.limbs_[i] ? -1 : 1;
+        }
+      }
+      return 0;
+    }
+
+    constexpr auto subtract(BigUint const& other) noexcept -> void
+    {
+      std::int64_t borrow{ 0 };
+      for (std::size_t i{ 0 }; i < LIMBS; ++i) {
+        std::int64_t value{ std::int64_t{ limbs_[i] } - other.limbs_[i] - borrow };
+        borrow = value < 0 ? 1 : 0;
+        limbs_[i] = static_cast<std::uint32_t>(value + (borrow << 32));
+      }
+    }
+
+    // Quotient of *this / divisor when it is below 2^63, *this becomes the remainder
+    constexpr auto divide(BigUint const& divisor) noexcept -> std::uint64_t
+    {
+      std::uint64_t quotient{ 0 };
+      for (int bit{ 62 }; bit >= 0; --bit) {
+        BigUint shifted{ divisor };
+        shifted.shift_left(bit);
+        if (compare(shifted) >= 0) {
+          subtract(shifted);
+          quotient |= std::uint64_t{ 1 } << static_cast<unsigned>(bit);
+        }
+      }
+      return quotient;
+    }
+  };
+
+  constexpr auto pow2(double value, int exponent) noexcept -> double
+  {
+    for (; exponent > 0; --exponent) {
+      value *= 2.0;
+    }
+    for (; exponent < 0; ++exponent) {
+      value *= 0.5;
+    }
+    return value;
+  }
+
+  // Correctly rounded digits * 10^exponent through exact integer arithmetic
+  constexpr auto parse_double_exact(std::string_view const digits, int const exponent) noexcept -> double
+  {
+    BigUint numerator;
+    for (char const c : digits) {
+      numerator.mul_add(10, static_cast<std::uint32_t>(c - '0'));
+    }
+    BigUint denominator;
+    denominator.mul_add(1, 1);
+    if (exponent >= 0) {
+      numerator.mul_pow10(exponent);
+    } else {
+      denominator.mul_pow10(-exponent);
+    }
+
+    // scale so that the quotient has 55 or 56 bits, then round it to 53
+    int const scale{ 55 - (numerator.bit_length() - denominator.bit_length()) };
+    if (scale > 0) {
+      numerator.shift_left(scale);
+    } else {
+      denominator.shift_left(-scale);
+    }
+    std::uint64_t mantissa{ numerator.divide(denominator) };
+    bool const sticky{ !numerator.is_zero() };
+
+    int bits{ 0 };
+    for (auto m = mantissa; m != 0; m >>= 1U) {
+      ++bits;
+    }
+    int const binary_exponent{ bits - 1 - scale };
+    int precision{ 53 };
+    if (binary_exponent < -1022) {// subnormal
+      precision -= -1022 - binary_exponent;
+      if (precision < 0) {
+        return 0.0;
+      }
+    }
+    int const dropped{ bits - precision };
+    auto const half = std::uint64_t{ 1 } << static_cast<unsigned>(dropped - 1);
+    auto const rest = mantissa & ((half << 1U) - 1);
+    mantissa >>= static_cast<unsigned>(dropped);
+    if (rest > half || (rest == half && (sticky || (mantissa & 1U) != 0))) {
+      ++mantissa;
+    }
+    if (binary_exponent > 1023) {
+      return std::numeric_limits<double>::infinity();
+    }
+    return pow2(static_cast<double>(mantissa), dropped - scale);
+  }
+}// namespace detail
+
+// Decimal floating-point literal `digits[.digits][(e|E)[+-]digits]` to the nearest double.
+// Like the Eisel-Lemire family of parsers it tries a cheap exact path first: up to 19
+// significant digits with a decimal exponent of at most 22 need a single correctly
+// rounded multiplication or division (Clinger's fast path). Everything else goes
+// through exact big integer arithmetic.
+constexpr auto parse_double(std::string_view const text) noexcept -> double
+{
+  constexpr std::size_t MAX_DIGITS{ 100 };// further digits are dropped
+  std::array<char, MAX_DIGITS + 1> digits{};
+  bool dropped_nonzero{ false };
+  std::size_t num_of_digits{ 0 };
+  int exponent{ 0 };
+  std::uint64_t mantissa{ 0 };
+
+  std::size_t i{ 0 };
+  bool fraction{ false };
+  for (; i < text.size() && (sci::isdigit(text[i]) || (text[i] == '.' && !fraction)); ++i) {
+    if (text[i] == '.') {
+      fraction = true;
+      continue;
+    }
+    if (num_of_digits == 0 && text[i] == '0') {
+      if (fraction) {
+        --exponent;
+      }
+      continue;// leading zeros
+    }
+    if (num_of_digits < MAX_DIGITS) {
+      digits[num_of_digits++] = text[i];
+      if (fraction) {
+        --exponent;
+      }
+    } else {
+      dropped_nonzero = dropped_nonzero || text[i] != '0';
+      if (!fraction) {
+        ++exponent;
+      }
+    }
+  }
+  if (dropped_nonzero) {
+    // a trailing 1 keeps the value above the kept digits when it rounds a tie
+    digits[num_of_digits++] = '1';
+    --exponent;
+  }
+  if (i < text.size() && (text[i] == 'e' || text[i] == 'E')) {
+    ++i;
+    bool const negative{ i < text.size() && text[i] == '-' };
+    if (i < text.size() && (text[i] == '-' || text[i] == '+')) {
+      ++i;
+    }
+    int value{ 0 };
+    for (; i < text.size() && sci::isdigit(text[i]); ++i) {
+      value = value < 10000 ? value * 10 + (text[i] - '0') : value;
+    }
+    exponent += negative ? -value : value;
+  }
+
+  if (num_of_digits == 0) {
+    return 0.0;
+  }
+  int const magnitude{ exponent + static_cast<int>(num_of_digits) };// value < 10^magnitude
+  if (magnitude > 310) {
+    return std::numeric_limits<double>::infinity();
+  }
+  if (magnitude < -330) {
+    return 0.0;
+  }
+
+  constexpr std::array<double, 23> powers_of_ten{
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+  };
+  if (num_of_digits <= 19) {
+    for (std::size_t d{ 0 }; d < num_of_digits; ++d) {
+      mantissa = mantissa * 10 + static_cast<std::uint64_t>(digits[d] - '0');
+    }
+    if (mantissa <= (std::uint64_t{ 1 } << 53U) && exponent >= -22 && exponent <= 22) {
+      auto const value = static_cast<double>(mantissa);
+      return exponent < 0 ? value / powers_of_ten[static_cast<std::size_t>(-exponent)]
+                          : value * powers_of_ten[static_cast<std::size_t>(exponent)];
+    }
+  }
+  return detail::parse_double_exact({ digits.data(), num_of_digits }, exponent);
+}
+
+}// namespace sci
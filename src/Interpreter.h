@@ -1,63 +1,662 @@
 #pragma once
+#include <algorithm>
 #include <array>
+#include <bit>
+#include <chrono>
+#include <cstdint>
+#include <limits>
+#include <type_traits>
 
+#include "Budget.h"
 #include "CompiledProgram.h"
 #include "Common.h"
+#include "ExecutionHooks.h"
+#include "Kernels.h"
 
 namespace sci {
 
-template<std::size_t Size>
-struct ScopeFrame
+// A function's locals and arrays are the Values [base, end) of the VM memory
+struct StackFrame
 {
-  std::array<int, Size> vars;
+  Instruction const* next_ins_ptr;
+  int func_index;
+  int base;
+  int end;
 };
 
-using FuncScopeFrame = ScopeFrame<8>;
-using GlobalScopeFrame = ScopeFrame<20>;
+enum class StackChecks {
+  CHECKED,// overflow and underflow end the run with Result::ERR
+  UNCHECKED,// stack and memory sizes must cover stack_bounds() of the program, see StackBounds.h
+};
 
-template<std::size_t ScopeStackSize>
-struct StackFrame
+// Memory a run took. Everything the run path uses has a size fixed by the template
+// arguments, so the only allocations to account are the frames in VM memory.
+struct MemoryStats
 {
-  Instruction const* next_ins_ptr;
-  ConstexprStack<FuncScopeFrame, ScopeStackSize> scope_stack;
+  std::size_t reserved_bytes{ 0 };// the ExecutionContext: stacks and the VM memory segment
+  std::size_t peak_bytes{ 0 };// high-water mark of the frames
+  std::size_t total_bytes{ 0 };// frame bytes of every call, main included
+};
+
+struct ExecResult
+{
+  Result r{ Result::OK };
+  Literal value{ Literal::Type::INT_, 0 };// returned by main, typed by its declaration, 0 unless r is OK
+  int func_index{ 0 };// function running when r is not OK
+  MemoryStats memory{};// filled in by execute, resume keeps them in ExecutionContext::stats
+};
+
+// Everything a suspended run needs to continue, the instruction pointers are in the frames
+template<std::size_t FuncStackSize, std::size_t MemorySize, std::size_t CompStackSize>
+struct ExecutionContext
+{
+  CompiledProgram const* program{ nullptr };
+  ConstexprStack<StackFrame, FuncStackSize> func_stack;
+  ConstexprStack<Value, CompStackSize> comp_stack;
+  std::array<Value, MemorySize> memory{};
+  int waiting_native{ -1 };// async host function the run waits for, -1 when running
+  std::array<Value, NativeFunction::MAX_PARAMS> native_args{};// the arguments it was called with
+  std::uint64_t fuel{ 0 };// calls and loop back edges left, see Limits
+  std::chrono::steady_clock::time_point deadline{};
+  std::uint32_t until_clock{ 0 };// charges until the deadline is checked, 0 without one
+  int memory_quota{ 0 };// Values the frames may take, see Limits
+  MemoryStats stats;
 };
 
-template<std::size_t FuncStackSize, std::size_t ScopeStackSize, std::size_t CompStackSize>
+// Frames live in one flat memory segment of MemorySize Values, a call takes the
+// callee's frame_size right behind its caller's frame. Addresses are indices into the
+// segment; loads and stores through them are bounds checked in both modes. An
+// interpreter constructed with Limits stops runs that exceed them.
+template<std::size_t FuncStackSize, std::size_t MemorySize, std::size_t CompStackSize, StackChecks Checks = StackChecks::CHECKED>
 class Interpreter
 {
+  static_assert(FuncStackSize > 0, "main needs a frame");
+
 public:
+  using Context = ExecutionContext<FuncStackSize, MemorySize, CompStackSize>;
+
+  constexpr Interpreter() noexcept = default;
+  constexpr explicit Interpreter(Limits const limits) noexcept
+    : limits_{ limits }, limited_{ limits.fuel != Limits{}.fuel || limits.time.count() > 0 || limits.memory != Limits{}.memory }
+  {}
+
   constexpr auto interpret(CompiledProgram const& program) const noexcept -> int
   {
-    ConstexprStack<StackFrame<ScopeStackSize>, FuncStackSize> func_stack;
-    ConstexprStack<Literal, CompStackSize> comp_stack;
-//    GlobalScopeFrame global_scope;
-    func_stack.push({ &program.functions[0].instructions[0] });
+    ExecutionHooks hooks;
+    return interpret(program, hooks);
+  }
+
+  template<typename Hooks>
+  constexpr auto interpret(CompiledProgram const& program, Hooks& hooks) const noexcept -> int
+  {
+    return as_int(execute(program, hooks).value);
+  }
+
+  constexpr auto execute(CompiledProgram const& program) const noexcept -> ExecResult
+  {
+    ExecutionHooks hooks;
+    return execute(program, hooks);
+  }
+
+  template<typename Hooks>
+  constexpr auto execute(CompiledProgram const& program, Hooks& hooks) const noexcept -> ExecResult
+  {
+    Context context;
+    if (auto const r = start(program, context); r != Result::OK) {
+      return { r, {}, 0, context.stats };
+    }
+    Unlimited budget;
+    auto result = resume(context, budget, hooks);
+    result.memory = context.stats;
+    return result;
+  }
+
+  // Prepares `context` to run `program` from main. ERR or OUT_OF_MEMORY if main's frame
+  // does not fit, the program has to outlive the context. Memory outside main's frame is
+  // left as it is, every call clears the frame it takes.
+  constexpr auto start(CompiledProgram const& program, Context& context) const noexcept -> Result
+  {
+    context.program = &program;
+    context.func_stack.clear();
+    context.comp_stack.clear();
+    context.waiting_native = -1;
+    context.fuel = limits_.fuel;
+    context.until_clock = 0;
+    if (limits_.time.count() > 0 && !std::is_constant_evaluated()) {
+      context.deadline = std::chrono::steady_clock::now() + limits_.time;
+      context.until_clock = Limits::CLOCK_INTERVAL;
+    }
+    context.memory_quota = static_cast<int>(std::min<std::size_t>(limits_.memory / sizeof(Value), std::numeric_limits<int>::max()));
+    context.stats = { sizeof(Context), 0, 0 };
+    int const frame_size{ program.functions[0].frame_size };
+    if constexpr (Checks == StackChecks::CHECKED) {
+      if (frame_size > static_cast<int>(MemorySize)) {
+        return Result::ERR;
+      }
+    }
+    if (frame_size > context.memory_quota) {
+      return Result::OUT_OF_MEMORY;
+    }
+    account(context.stats, frame_size, frame_size);
+    std::fill(context.memory.begin(), context.memory.begin() + frame_size, Value{});
+    context.func_stack.push_unchecked({ &program.functions[0].instructions[0], 0, 0, frame_size });
+    return Result::OK;
+  }
+
+  template<typename Budget>
+  constexpr auto resume(Context& context, Budget& budget) const noexcept -> ExecResult
+  {
+    ExecutionHooks hooks;
+    return resume(context, budget, hooks);
+  }
+
+  // Hands the result of the async host call a run is WAITING for to `context`, the next
+  // resume continues behind the call. The value is dropped for void host functions.
+  constexpr auto complete(Context& context, Value const value) const noexcept -> void
+  {
+    if (context.waiting_native < 0) {
+      return;
+    }
+    if (context.program->natives[static_cast<std::size_t>(context.waiting_native)].return_type != Literal::Type::NONE_) {
+      context.comp_stack.push_unchecked(value);
+    }
+    context.waiting_native = -1;
+  }
+
+  // Runs a started context until main returns, an error or until `budget` is spent. A
+  // spent budget gives Result::SUSPENDED and the next resume continues with the
+  // instruction it stopped at, so one thread can interleave many scripts. A call to an
+  // async host function gives Result::WAITING with its arguments in
+  // context.native_args, the run continues once complete() delivered the result. Once a
+  // run ended with OK, ERR or LIMIT the context has to be started again.
+  template<typename Budget, typename Hooks>
+  constexpr auto resume(Context& context, Budget& budget, Hooks& hooks) const noexcept -> ExecResult
+  {
+    // without Limits the loop is instantiated with no limit checks at all
+    if (limited_) {
+      return run<true>(context, budget, hooks);
+    }
+    return run<false>(context, budget, hooks);
+  }
+
+private:
+  // resume's dispatch loop, only a Limited one charges fuel and the clock and checks the quota
+  template<bool Limited, typename Budget, typename Hooks>
+  constexpr auto run(Context& context, Budget& budget, Hooks& hooks) const noexcept -> ExecResult
+  {
+    CompiledProgram const& program{ *context.program };
+    auto& func_stack = context.func_stack;
+    auto& comp_stack = context.comp_stack;
+    auto& memory = context.memory;
+    if (context.waiting_native >= 0) {
+      return { Result::WAITING, {}, func_stack.top_unchecked().func_index };
+    }
 
     while (!func_stack.empty()) {
-      Instruction const& current_instruction{ *(func_stack.top().next_ins_ptr++) };
+      if (!budget.spend()) {
+        return { Result::SUSPENDED, {}, func_stack.top_unchecked().func_index };
+      }
+      hooks.on_instruction(func_stack, comp_stack);
+      auto& frame = func_stack.top_unchecked();
+      Instruction const& current_instruction{ *(frame.next_ins_ptr++) };
+      if constexpr (Checks == StackChecks::CHECKED) {
+        auto const effect = stack_effect(current_instruction, program);
+        auto const size = static_cast<int>(comp_stack.size());
+        if (size < effect.pops
+            || size - effect.pops + effect.pushes > static_cast<int>(CompStackSize)
+            || (current_instruction.type == Instruction::Type::CALL && func_stack.full())) {
+          return { Result::ERR, {}, frame.func_index };
+        }
+      }
+
       switch (current_instruction.type) {
+      case Instruction::Type::NONE:// falling off the end of a function returns
       case Instruction::Type::RET:
-        func_stack.pop();
+        func_stack.pop_unchecked();
         break;
 
       case Instruction::Type::VAL:
-        comp_stack.push(current_instruction.par);
+        comp_stack.push_unchecked(current_instruction.par);
         break;
 
-      case Instruction::Type::CALL:
-        func_stack.push({ program.functions[std::get<int>(current_instruction.par.val)].instructions.data() });
+      case Instruction::Type::ADD:
+      case Instruction::Type::SUB:
+      case Instruction::Type::MUL:
+      case Instruction::Type::DIV:
+      case Instruction::Type::MOD:
+      case Instruction::Type::LT:
+      case Instruction::Type::LE:
+      case Instruction::Type::GT:
+      case Instruction::Type::GE:
+      case Instruction::Type::EQ:
+      case Instruction::Type::NE: {
+        int const rhs{ pop(comp_stack).i };
+        int const lhs{ pop(comp_stack).i };
+        comp_stack.push_unchecked({ binary(current_instruction.type, lhs, rhs) });
         break;
+      }
+
+      case Instruction::Type::NEG:
+        comp_stack.push_unchecked({ binary(Instruction::Type::SUB, 0, pop(comp_stack).i) });
+        break;
+
+      case Instruction::Type::DADD:
+      case Instruction::Type::DSUB:
+      case Instruction::Type::DMUL:
+      case Instruction::Type::DDIV: {
+        double const rhs{ pop(comp_stack).d };
+        double const lhs{ pop(comp_stack).d };
+        comp_stack.push_unchecked({ .d = binary_double(current_instruction.type, lhs, rhs) });
+        break;
+      }
+
+      case Instruction::Type::DLT:
+      case Instruction::Type::DLE:
+      case Instruction::Type::DGT:
+      case Instruction::Type::DGE:
+      case Instruction::Type::DEQ:
+      case Instruction::Type::DNE: {
+        double const rhs{ pop(comp_stack).d };
+        double const lhs{ pop(comp_stack).d };
+        comp_stack.push_unchecked({ compare_double(current_instruction.type, lhs, rhs) });
+        break;
+      }
+
+      case Instruction::Type::DNEG:
+        comp_stack.top_unchecked().d = -comp_stack.top_unchecked().d;
+        break;
+
+      case Instruction::Type::I2D:
+        comp_stack.top_unchecked().d = comp_stack.top_unchecked().i;
+        break;
+
+      case Instruction::Type::I2D_UNDER:
+        comp_stack.from_top_unchecked(1).d = comp_stack.from_top_unchecked(1).i;
+        break;
+
+      case Instruction::Type::D2I:
+        comp_stack.top_unchecked().i = to_int(comp_stack.top_unchecked().d);
+        break;
+
+      case Instruction::Type::I2C:
+        comp_stack.top_unchecked().i = static_cast<char>(comp_stack.top_unchecked().i);
+        break;
+
+      case Instruction::Type::LOAD:
+        comp_stack.push_unchecked(memory[static_cast<std::size_t>(frame.base + current_instruction.par.i)]);
+        break;
+
+      case Instruction::Type::STORE:
+        memory[static_cast<std::size_t>(frame.base + current_instruction.par.i)] = pop(comp_stack);
+        break;
+
+      case Instruction::Type::POP:
+        comp_stack.pop_unchecked();
+        break;
+
+      case Instruction::Type::ADDR:
+        comp_stack.push_unchecked({ frame.base + current_instruction.par.i });
+        break;
+
+      // live frames only, so a pointer into a returned call is caught as well
+      case Instruction::Type::LOAD_IND: {
+        int const address{ pop(comp_stack).i };
+        if (address < 0 || address >= frame.end) {
+          return { Result::ERR, {}, frame.func_index };
+        }
+        comp_stack.push_unchecked(memory[static_cast<std::size_t>(address)]);
+        break;
+      }
+
+      case Instruction::Type::STORE_IND: {
+        Value const value{ pop(comp_stack) };
+        int const address{ pop(comp_stack).i };
+        if (address < 0 || address >= frame.end) {
+          return { Result::ERR, {}, frame.func_index };
+        }
+        memory[static_cast<std::size_t>(address)] = value;
+        break;
+      }
+
+      case Instruction::Type::DUP:
+        comp_stack.push_unchecked(comp_stack.top_unchecked());
+        break;
+
+      case Instruction::Type::JMP:
+        if (!jump<Limited>(context, frame, current_instruction)) {
+          return { Result::LIMIT, {}, frame.func_index };
+        }
+        break;
+
+      case Instruction::Type::JZ:
+        if (pop(comp_stack).i == 0 && !jump<Limited>(context, frame, current_instruction)) {
+          return { Result::LIMIT, {}, frame.func_index };
+        }
+        break;
+
+      case Instruction::Type::JNZ:
+        if (pop(comp_stack).i != 0 && !jump<Limited>(context, frame, current_instruction)) {
+          return { Result::LIMIT, {}, frame.func_index };
+        }
+        break;
+
+      case Instruction::Type::JLT:
+      case Instruction::Type::JLE:
+      case Instruction::Type::JGT:
+      case Instruction::Type::JGE:
+      case Instruction::Type::JEQ:
+      case Instruction::Type::JNE: {
+        int const rhs{ pop(comp_stack).i };
+        int const lhs{ pop(comp_stack).i };
+        if (binary(fused_compare(current_instruction.type), lhs, rhs) != 0 && !jump<Limited>(context, frame, current_instruction)) {
+          return { Result::LIMIT, {}, frame.func_index };
+        }
+        break;
+      }
+
+      case Instruction::Type::CALL: {
+        if constexpr (Limited) {
+          if (!charge(context)) {
+            return { Result::LIMIT, {}, frame.func_index };
+          }
+        }
+        int const func_index{ current_instruction.par.i };
+        int const base{ frame.end };
+        auto const& callee = program.functions[static_cast<std::size_t>(func_index)];
+        int const end{ base + callee.frame_size };
+        if constexpr (Checks == StackChecks::CHECKED) {
+          if (end > static_cast<int>(MemorySize)) {
+            return { Result::ERR, {}, frame.func_index };
+          }
+        }
+        if constexpr (Limited) {
+          if (end > context.memory_quota) {
+            return { Result::OUT_OF_MEMORY, {}, frame.func_index };
+          }
+        }
+        // the frame is checked first, so a hook running the call cannot skip the limits
+        if (hooks.on_call(func_index, func_stack, comp_stack, context.fuel)) {
+          break;
+        }
+        account(context.stats, end, end - base);
+        std::fill(memory.begin() + base, memory.begin() + end, Value{});
+        func_stack.push_unchecked({ callee.instructions.data(), func_index, base, end });
+        break;
+      }
+
+      // host functions read their arguments in place, no frame is pushed
+      case Instruction::Type::CALL_NATIVE: {
+        auto const& native = program.natives[static_cast<std::size_t>(current_instruction.par.i)];
+        auto const arity = static_cast<std::size_t>(native.arity);
+        if (native.start != nullptr) {
+          std::copy_n(comp_stack.top_n_unchecked(arity), arity, context.native_args.begin());
+          comp_stack.pop_unchecked(arity);
+          context.waiting_native = current_instruction.par.i;
+          return { Result::WAITING, {}, frame.func_index };
+        }
+        Value const value{ native.call(comp_stack.top_n_unchecked(arity)) };
+        comp_stack.pop_unchecked(arity);
+        if (native.return_type != Literal::Type::NONE_) {
+          comp_stack.push_unchecked(value);
+        }
+        break;
+      }
+
+      case Instruction::Type::SUM:
+      case Instruction::Type::DSUM: {
+        int const count{ pop(comp_stack).i };
+        int const address{ pop(comp_stack).i };
+        if (!in_frames(address, count, frame)) {
+          return { Result::ERR, {}, frame.func_index };
+        }
+        Value const* values{ memory.data() + (count > 0 ? address : 0) };
+        comp_stack.push_unchecked(current_instruction.type == Instruction::Type::SUM
+                                    ? Value{ kernels::sum(values, count) }
+                                    : Value{ .d = kernels::sum_double(values, count) });
+        break;
+      }
+
+      case Instruction::Type::DOT:
+      case Instruction::Type::DDOT: {
+        int const count{ pop(comp_stack).i };
+        int const rhs{ pop(comp_stack).i };
+        int const lhs{ pop(comp_stack).i };
+        if (!in_frames(lhs, count, frame) || !in_frames(rhs, count, frame)) {
+          return { Result::ERR, {}, frame.func_index };
+        }
+        Value const* l{ memory.data() + (count > 0 ? lhs : 0) };
+        Value const* r{ memory.data() + (count > 0 ? rhs : 0) };
+        comp_stack.push_unchecked(current_instruction.type == Instruction::Type::DOT
+                                    ? Value{ kernels::dot(l, r, count) }
+                                    : Value{ .d = kernels::dot_double(l, r, count) });
+        break;
+      }
+
+      case Instruction::Type::FILL: {
+        int const count{ pop(comp_stack).i };
+        Value const value{ pop(comp_stack) };
+        int const address{ pop(comp_stack).i };
+        if (!in_frames(address, count, frame)) {
+          return { Result::ERR, {}, frame.func_index };
+        }
+        kernels::fill(memory.data() + (count > 0 ? address : 0), value, count);
+        break;
+      }
+
+      case Instruction::Type::COPY: {
+        int const count{ pop(comp_stack).i };
+        int const src{ pop(comp_stack).i };
+        int const dst{ pop(comp_stack).i };
+        if (!in_frames(src, count, frame) || !in_frames(dst, count, frame)) {
+          return { Result::ERR, {}, frame.func_index };
+        }
+        kernels::copy(memory.data() + (count > 0 ? dst : 0), memory.data() + (count > 0 ? src : 0), count);
+        break;
+      }
 
       default:
         break;
       }
     }
 
-    if (comp_stack.top().type == Literal::Type::INT_) {
-      return std::get<int>(comp_stack.top().val);
+    return { Result::OK, result(program.functions[0].return_type, comp_stack), 0 };
+  }
+
+  template<typename CompStack>
+  static constexpr auto pop(CompStack& comp_stack) noexcept -> Value
+  {
+    Value const value{ comp_stack.top_unchecked() };
+    comp_stack.pop_unchecked();
+    return value;
+  }
+
+  // main's return value, zero when it left nothing
+  template<typename CompStack>
+  static constexpr auto result(Literal::Type const type, CompStack& comp_stack) noexcept -> Literal
+  {
+    bool const empty{ comp_stack.empty() };
+    switch (type) {
+    case Literal::Type::NONE_:
+      return {};
+    case Literal::Type::DOUBLE_:
+      return { type, empty ? 0.0 : comp_stack.top_unchecked().d };
+    case Literal::Type::CHAR_:
+      return { type, static_cast<char>(empty ? 0 : comp_stack.top_unchecked().i) };
+    default:// INT_, the pool index for STRING_
+      return { type, empty ? 0 : comp_stack.top_unchecked().i };
     }
-    return 0;
   }
+
+  // [address, address + count) lies in the live frames, a count below 1 touches nothing
+  static constexpr auto in_frames(int const address, int const count, StackFrame const& frame) noexcept -> bool
+  {
+    return count <= 0 || (address >= 0 && address <= frame.end - count);
+  }
+
+  // a frame of `size` Values ending at `end`
+  static constexpr auto account(MemoryStats& stats, int const end, int const size) noexcept -> void
+  {
+    stats.total_bytes += static_cast<std::size_t>(size) * sizeof(Value);
+    stats.peak_bytes = std::max(stats.peak_bytes, static_cast<std::size_t>(end) * sizeof(Value));
+  }
+
+  // false once a limit is exceeded
+  static constexpr auto charge(Context& context) noexcept -> bool
+  {
+    if (context.fuel == 0) {
+      return false;
+    }
+    --context.fuel;
+    if (context.until_clock != 0 && --context.until_clock == 0) {
+      if (std::chrono::steady_clock::now() >= context.deadline) {
+        return false;
+      }
+      context.until_clock = Limits::CLOCK_INTERVAL;
+    }
+    return true;
+  }
+
+  // false when a backward jump exceeds a limit
+  template<bool Limited, typename Frame>
+  static constexpr auto jump(Context& context, Frame& frame, Instruction const& ins) noexcept -> bool
+  {
+    int const offset{ ins.par.i };
+    frame.next_ins_ptr += offset;
+    if constexpr (Limited) {
+      if (offset < 0) {
+        return charge(context);
+      }
+    }
+    return true;
+  }
+
+  // the comparison a fused branch performs
+  static constexpr auto fused_compare(Instruction::Type const type) noexcept -> Instruction::Type
+  {
+    switch (type) {
+    case Instruction::Type::JLT:
+      return Instruction::Type::LT;
+    case Instruction::Type::JLE:
+      return Instruction::Type::LE;
+    case Instruction::Type::JGT:
+      return Instruction::Type::GT;
+    case Instruction::Type::JGE:
+      return Instruction::Type::GE;
+    case Instruction::Type::JEQ:
+      return Instruction::Type::EQ;
+    default:
+      return Instruction::Type::NE;
+    }
+  }
+
+  // Arithmetic wraps around like the JIT and the transpiled code. Division by zero
+  // and INT_MIN / -1 have no defined result and give 0.
+  static constexpr auto binary(Instruction::Type const type, int const lhs, int const rhs) noexcept -> int
+  {
+    auto const l = static_cast<unsigned>(lhs);
+    auto const r = static_cast<unsigned>(rhs);
+    switch (type) {
+    case Instruction::Type::ADD:
+      return static_cast<int>(l + r);
+    case Instruction::Type::SUB:
+      return static_cast<int>(l - r);
+    case Instruction::Type::MUL:
+      return static_cast<int>(l * r);
+    case Instruction::Type::DIV:
+      return rhs == 0 || (rhs == -1 && lhs == std::numeric_limits<int>::min()) ? 0 : lhs / rhs;
+    case Instruction::Type::MOD:
+      return rhs == 0 || rhs == -1 ? 0 : lhs % rhs;
+    case Instruction::Type::LT:
+      return lhs < rhs;
+    case Instruction::Type::LE:
+      return lhs <= rhs;
+    case Instruction::Type::GT:
+      return lhs > rhs;
+    case Instruction::Type::GE:
+      return lhs >= rhs;
+    case Instruction::Type::EQ:
+      return lhs == rhs;
+    case Instruction::Type::NE:
+      return lhs != rhs;
+    default:
+      return 0;
+    }
+  }
+
+  // IEEE 754 results, spelled out for division by zero, which constant evaluation rejects
+  static constexpr auto binary_double(Instruction::Type const type, double const lhs, double const rhs) noexcept -> double
+  {
+    switch (type) {
+    case Instruction::Type::DADD:
+      return lhs + rhs;
+    case Instruction::Type::DSUB:
+      return lhs - rhs;
+    case Instruction::Type::DMUL:
+      return lhs * rhs;
+    case Instruction::Type::DDIV:
+      if (rhs == 0.0) {
+        if (lhs == 0.0 || lhs != lhs) {
+          return std::numeric_limits<double>::quiet_NaN();
+        }
+        bool const negative{ (lhs < 0.0) != (std::bit_cast<std::uint64_t>(rhs) >> 63U != 0) };
+        return negative ? -std::numeric_limits<double>::infinity() : std::numeric_limits<double>::infinity();
+      }
+      return lhs / rhs;
+    default:
+      return 0.0;
+    }
+  }
+
+  static constexpr auto compare_double(Instruction::Type const type, double const lhs, double const rhs) noexcept -> int
+  {
+    switch (type) {
+    case Instruction::Type::DLT:
+      return lhs < rhs;
+    case Instruction::Type::DLE:
+      return lhs <= rhs;
+    case Instruction::Type::DGT:
+      return lhs > rhs;
+    case Instruction::Type::DGE:
+      return lhs >= rhs;
+    case Instruction::Type::DEQ:
+      return lhs == rhs;
+    default:
+      return lhs != rhs;
+    }
+  }
+
+  // Out of range conversions are undefined in C, here they saturate and NaN gives 0
+  static constexpr auto to_int(double const value) noexcept -> int
+  {
+    if (value != value) {
+      return 0;
+    }
+    if (value <= static_cast<double>(std::numeric_limits<int>::min())) {
+      return std::numeric_limits<int>::min();
+    }
+    if (value >= static_cast<double>(std::numeric_limits<int>::max())) {
+      return std::numeric_limits<int>::max();
+    }
+    return static_cast<int>(value);
+  }
+
+  // main's result as an int, chars are promoted and doubles truncated
+  static constexpr auto as_int(Literal const& lit) noexcept -> int
+  {
+    switch (lit.type) {
+    case Literal::Type::INT_:
+      return std::get<int>(lit.val);
+    case Literal::Type::CHAR_:
+      return std::get<char>(lit.val);
+    case Literal::Type::DOUBLE_:
+      return to_int(std::get<double>(lit.val));
+    default:
+      return 0;
+    }
+  }
+
+  Limits limits_{};
+  bool limited_{ false };// any limit set, resume picks the loop that checks them
 };
 
-}// namespace sci
\ No newline at end of file
+}// namespace sci
@@ -0,0 +1,348 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <optional>
+#include <utility>
+#include <vector>
+
+#if defined(__x86_64__) && defined(__unix__)
+#include <sys/mman.h>
+#define SCI_JIT_AVAILABLE 1
+#else
+#define SCI_JIT_AVAILABLE 0
+#endif
+
+#include "CompiledProgram.h"
+#include "Interpreter.h"
+
+namespace sci {
+
+// Baseline template JIT translating CompiledProgram to x86-64 machine code.
+//
+// Every function reachable from the root becomes a native function called with `call`/`ret`.
+// The operand stack lives in memory, rdi points at its next free int slot and each
+// function returns with rdi moved by its (statically known) net stack effect.
+// Only programs whose behaviour is identical to Interpreter<FuncStackSize, MemorySize, CompStackSize>
+// are compiled: int literals, ADD, CALL and RET, no recursion, and stacks and frames that
+// never overflow. JitProgram::compile returns nullopt for anything else.
+class JitProgram
+{
+  void* code_{ nullptr };
+  std::size_t code_size_{ 0 };
+  std::size_t entry_{ 0 };
+  int net_{ 0 };
+  std::size_t max_comp_depth_{ 0 };
+  std::size_t call_depth_{ 0 };
+  std::size_t memory_{ 0 };
+  std::uint64_t calls_{ 0 };
+
+  struct FunctionInfo
+  {
+    enum class State {
+      UNVISITED,
+      IN_PROGRESS,
+      DONE,
+      FAILED,
+    };
+    State state{ State::UNVISITED };
+    int length{ 0 };// instructions up to and including the first RET
+    int net{ 0 };// stack slots left behind for the caller
+    int max_depth{ 0 };// highest operand stack use relative to entry, callees included
+    int call_depth{ 1 };// frames on func_stack, this one included
+    int memory{ 0 };// Values of VM memory its frame and the deepest callee frames take
+    std::uint64_t calls{ 0 };// CALLs it executes, the ones in its callees included
+  };
+  using Analysis = std::array<FunctionInfo, CompiledProgram::NUM_OF_FUNC>;
+
+public:
+  JitProgram() = default;
+  JitProgram(JitProgram const&) = delete;
+  auto operator=(JitProgram const&) -> JitProgram& = delete;
+  JitProgram(JitProgram&& other) noexcept { *this = std::move(other); }
+  auto operator=(JitProgram&& other) noexcept -> JitProgram&
+  {
+    std::swap(code_, other.code_);
+    std::swap(code_size_, other.code_size_);
+    std::swap(entry_, other.entry_);
+    std::swap(net_, other.net_);
+    std::swap(max_comp_depth_, other.max_comp_depth_);
+    std::swap(call_depth_, other.call_depth_);
+    std::swap(memory_, other.memory_);
+    std::swap(calls_, other.calls_);
+    return *this;
+  }
+  ~JitProgram() { release(); }
+
+  // Whole program for Interpreter<FuncStackSize, MemorySize, CompStackSize>, run() replaces interpret()
+  [[nodiscard]] static auto compile(CompiledProgram const& program,
+    std::size_t const func_stack_size,
+    std::size_t const memory_size,
+    std::size_t const comp_stack_size) -> std::optional<JitProgram>
+  {
+    auto result = compile_function(program, 0);
+    // an empty comp_stack at the end is left to the interpreter, see ConstexprStack::top
+    if (!result
+        || result->net_ < 1
+        || result->call_depth_ > func_stack_size
+        || result->memory_ > memory_size
+        || result->max_comp_depth_ > comp_stack_size) {
+      return std::nullopt;
+    }
+    return result;
+  }
+
+  // `func` and everything it calls, invoked through call()
+  [[nodiscard]] static auto compile_function(CompiledProgram const& program, int const func)
+    -> std::optional<JitProgram>
+  {
+#if SCI_JIT_AVAILABLE
+    Analysis analysis{};
+    if (!analyze(program, func, analysis)) {
+      return std::nullopt;
+    }
+
+    std::vector<std::uint8_t> code;
+    std::array<std::size_t, CompiledProgram::NUM_OF_FUNC> offsets{};
+    std::vector<std::pair<std::size_t, std::size_t>> calls;// rel32 position, callee
+
+    for (std::size_t f{ 0 }; f < analysis.size(); ++f) {
+      if (analysis[f].state != FunctionInfo::State::DONE) {
+        continue;
+      }
+      offsets[f] = code.size();
+      auto const& instructions = program.functions[f].instructions;
+      for (std::size_t i{ 0 }; i < static_cast<std::size_t>(analysis[f].length); ++i) {
+        auto const& ins = instructions[i];
+        switch (ins.type) {
+        case Instruction::Type::VAL:
+          emit(code, { 0xC7, 0x07 });// mov dword [rdi], imm32
+          emit_i32(code, ins.par.i);
+          emit(code, { 0x48, 0x83, 0xC7, 0x04 });// add rdi, 4
+          break;
+
+        case Instruction::Type::ADD:
+          emit(code, { 0x48, 0x83, 0xEF, 0x04 });// sub rdi, 4
+          emit(code, { 0x8B, 0x07 });// mov eax, [rdi]
+          emit(code, { 0x01, 0x47, 0xFC });// add [rdi-4], eax
+          break;
+
+        case Instruction::Type::CALL:
+          emit(code, { 0xE8 });// call rel32
+          calls.emplace_back(code.size(), static_cast<std::size_t>(ins.par.i));
+          emit_i32(code, 0);
+          break;
+
+        case Instruction::Type::RET:
+          emit(code, { 0xC3 });// ret
+          break;
+
+        default:
+          return std::nullopt;
+        }
+      }
+    }
+
+    // int* entry(int* stack): runs `func`, returns the new top of the operand stack
+    std::size_t const entry{ code.size() };
+    emit(code, { 0xE8 });// call rel32
+    calls.emplace_back(code.size(), static_cast<std::size_t>(func));
+    emit_i32(code, 0);
+    emit(code, { 0x48, 0x89, 0xF8 });// mov rax, rdi
+    emit(code, { 0xC3 });// ret
+
+    for (auto const& [pos, callee] : calls) {
+      auto const rel = static_cast<std::int64_t>(offsets[callee]) - static_cast<std::int64_t>(pos + 4);
+      auto const rel32 = static_cast<std::int32_t>(rel);
+      std::memcpy(code.data() + pos, &rel32, sizeof(rel32));
+    }
+
+    JitProgram result;
+    if (!result.map(code)) {
+      return std::nullopt;
+    }
+    auto const& root = analysis[static_cast<std::size_t>(func)];
+    result.entry_ = entry;
+    result.net_ = root.net;
+    result.max_comp_depth_ = static_cast<std::size_t>(root.max_depth);
+    result.call_depth_ = static_cast<std::size_t>(root.call_depth);
+    result.memory_ = static_cast<std::size_t>(root.memory);
+    result.calls_ = root.calls;
+    return result;
+#else
+    (void)program;
+    (void)func;
+    return std::nullopt;
+#endif
+  }
+
+  [[nodiscard]] auto run() const -> int
+  {
+    std::array<int, 64> small_stack;
+    if (max_comp_depth_ <= small_stack.size()) {
+      return call(small_stack.data())[-1];
+    }
+    std::vector<int> stack(max_comp_depth_);
+    return call(stack.data())[-1];
+  }
+
+  // Runs the compiled function on `stack`, which needs max_comp_depth() free slots.
+  // Returns the new top, net() slots above `stack`.
+  auto call(int* const stack) const -> int*
+  {
+    using Entry = int* (*)(int*);
+    auto const entry = reinterpret_cast<Entry>(static_cast<std::uint8_t*>(code_) + entry_);
+    return entry(stack);
+  }
+
+  [[nodiscard]] auto code_size() const noexcept { return code_size_; }
+  [[nodiscard]] auto net() const noexcept { return net_; }
+  [[nodiscard]] auto max_comp_depth() const noexcept { return max_comp_depth_; }
+  [[nodiscard]] auto call_depth() const noexcept { return call_depth_; }
+  // Values the skipped frames would have taken behind the caller's frame
+  [[nodiscard]] auto memory() const noexcept { return memory_; }
+  // Calls the native code makes, the fuel the interpreter would charge for them
+  [[nodiscard]] auto calls() const noexcept { return calls_; }
+
+private:
+  static auto emit(std::vector<std::uint8_t>& code, std::initializer_list<std::uint8_t> bytes) -> void
+  {
+    code.insert(code.end(), bytes);
+  }
+
+  static auto emit_i32(std::vector<std::uint8_t>& code, std::int32_t const value) -> void
+  {
+    std::uint8_t bytes[sizeof(value)];
+    std::memcpy(bytes, &value, sizeof(value));
+    code.insert(code.end(), std::begin(bytes), std::end(bytes));
+  }
+
+  // Computes stack effects of `func` and everything it calls, fails on anything
+  // the JIT does not translate or that the interpreter would not run to a RET.
+  static auto analyze(CompiledProgram const& program, int const func, Analysis& analysis) -> bool
+  {
+    if (func < 0 || func >= CompiledProgram::NUM_OF_FUNC) {
+      return false;
+    }
+    auto const f = static_cast<std::size_t>(func);
+    auto& info = analysis[f];
+    switch (info.state) {
+    case FunctionInfo::State::DONE:
+      return true;
+    case FunctionInfo::State::IN_PROGRESS:// recursion
+    case FunctionInfo::State::FAILED:
+      return false;
+    default:
+      break;
+    }
+    info.state = FunctionInfo::State::IN_PROGRESS;
+    int const frame_size{ program.functions[f].frame_size };
+    info.memory = frame_size;
+
+    int depth{ 0 };
+    for (int i{ 0 }; i < CompiledFunction::NUM_OF_INS; ++i) {
+      auto const& ins = program.functions[f].instructions[static_cast<std::size_t>(i)];
+      switch (ins.type) {
+      case Instruction::Type::VAL:
+        if (ins.par_type != Literal::Type::INT_) {
+          info.state = FunctionInfo::State::FAILED;
+          return false;
+        }
+        ++depth;
+        break;
+
+      case Instruction::Type::ADD:
+        if (depth < 2) {
+          info.state = FunctionInfo::State::FAILED;
+          return false;
+        }
+        --depth;
+        break;
+
+      case Instruction::Type::CALL: {
+        int const callee{ ins.par.i };
+        if (!analyze(program, callee, analysis)) {
+          info.state = FunctionInfo::State::FAILED;
+          return false;
+        }
+        auto const& callee_info = analysis[static_cast<std::size_t>(callee)];
+        info.max_depth = std::max(info.max_depth, depth + callee_info.max_depth);
+        info.call_depth = std::max(info.call_depth, callee_info.call_depth + 1);
+        info.memory = std::max(info.memory, frame_size + callee_info.memory);
+        info.calls += callee_info.calls + 1;
+        depth += callee_info.net;
+        break;
+      }
+
+      case Instruction::Type::RET:
+        info.length = i + 1;
+        info.net = depth;
+        info.state = FunctionInfo::State::DONE;
+        return true;
+
+      default:
+        info.state = FunctionInfo::State::FAILED;
+        return false;
+      }
+      info.max_depth = std::max(info.max_depth, depth);
+    }
+
+    info.state = FunctionInfo::State::FAILED;
+    return false;
+  }
+
+#if SCI_JIT_AVAILABLE
+  auto map(std::vector<std::uint8_t> const& code) -> bool
+  {
+    void* const mem = mmap(nullptr, code.size(), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (mem == MAP_FAILED) {
+      return false;
+    }
+    std::memcpy(mem, code.data(), code.size());
+    if (mprotect(mem, code.size(), PROT_READ | PROT_EXEC) != 0) {
+      munmap(mem, code.size());
+      return false;
+    }
+    code_ = mem;
+    code_size_ = code.size();
+    return true;
+  }
+#endif
+
+  auto release() noexcept -> void
+  {
+#if SCI_JIT_AVAILABLE
+    if (code_) {
+      munmap(code_, code_size_);
+    }
+#endif
+    code_ = nullptr;
+    code_size_ = 0;
+  }
+};
+
+// Runs a program natively when JitProgram can compile it, otherwise through the interpreter
+template<std::size_t FuncStackSize, std::size_t MemorySize, std::size_t CompStackSize>
+class JitInterpreter
+{
+  CompiledProgram const& program_;
+  std::optional<JitProgram> jit_;
+
+public:
+  explicit JitInterpreter(CompiledProgram const& program)
+    : program_{ program }, jit_{ JitProgram::compile(program, FuncStackSize, MemorySize, CompStackSize) }
+  {}
+
+  [[nodiscard]] auto compiled() const noexcept { return jit_.has_value(); }
+
+  [[nodiscard]] auto interpret() const -> int
+  {
+    if (jit_) {
+      return jit_->run();
+    }
+    return Interpreter<FuncStackSize, MemorySize, CompStackSize>{}.interpret(program_);
+  }
+};
+
+}// namespace sci
@@ -0,0 +1,167 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <type_traits>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <immintrin.h>
+#define SCI_SIMD_KERNELS 1
+#else
+#define SCI_SIMD_KERNELS 0
+#endif
+
+#include "CompiledProgram.h"
+
+namespace sci {
+
+// Loops over VM memory behind the SUM, DOT, FILL and COPY instructions. With SSE2 they
+// take 2 Values per vector, with AVX2 (ENABLE_AVX2) 4, during constant evaluation and
+// elsewhere they run element by element. An int lives in the low half of its Value, so
+// the int kernels add whole vectors and only read the even 32 bit lanes at the end.
+// They wrap around like ADD and MUL. Doubles are summed in 4 interleaved partial sums
+// on every path, so the result does not depend on the instruction set, but it may
+// round differently from a sum in source order. A count below 1 is an empty range.
+namespace kernels {
+  constexpr std::size_t LANES{ 4 };// partial sums of the double kernels
+
+  constexpr auto sum(Value const* values, int const count) noexcept -> int
+  {
+    unsigned total{ 0 };
+    int i{ 0 };
+#if SCI_SIMD_KERNELS
+    if (!std::is_constant_evaluated()) {
+#if defined(__AVX2__)
+      __m256i acc{ _mm256_setzero_si256() };
+      for (; i + 4 <= count; i += 4) {
+        acc = _mm256_add_epi32(acc, _mm256_loadu_si256(reinterpret_cast<__m256i const*>(values + i)));
+      }
+      __m128i const half{ _mm_add_epi32(_mm256_castsi256_si128(acc), _mm256_extracti128_si256(acc, 1)) };
+#else
+      __m128i half{ _mm_setzero_si128() };
+      for (; i + 2 <= count; i += 2) {
+        half = _mm_add_epi32(half, _mm_loadu_si128(reinterpret_cast<__m128i const*>(values + i)));
+      }
+#endif
+      total = static_cast<unsigned>(_mm_cvtsi128_si32(half)) + static_cast<unsigned>(_mm_cvtsi128_si32(_mm_unpackhi_epi64(half, half)));
+    }
+#endif
+    for (; i < count; ++i) {
+      total += static_cast<unsigned>(values[i].i);
+    }
+    return static_cast<int>(total);
+  }
+
+  constexpr auto dot(Value const* lhs, Value const* rhs, int const count) noexcept -> int
+  {
+    unsigned total{ 0 };
+    int i{ 0 };
+#if SCI_SIMD_KERNELS
+    if (!std::is_constant_evaluated()) {
+      // _mm_mul_epu32 multiplies the even lanes, the low 32 bits of the products are the wrapped int products
+#if defined(__AVX2__)
+      __m256i acc{ _mm256_setzero_si256() };
+      for (; i + 4 <= count; i += 4) {
+        acc = _mm256_add_epi32(acc,
+          _mm256_mul_epu32(_mm256_loadu_si256(reinterpret_cast<__m256i const*>(lhs + i)),
+            _mm256_loadu_si256(reinterpret_cast<__m256i const*>(rhs + i))));
+      }
+      __m128i const half{ _mm_add_epi32(_mm256_castsi256_si128(acc), _mm256_extracti128_si256(acc, 1)) };
+#else
+      __m128i half{ _mm_setzero_si128() };
+      for (; i + 2 <= count; i += 2) {
+        half = _mm_add_epi32(half,
+          _mm_mul_epu32(_mm_loadu_si128(reinterpret_cast<__m128i const*>(lhs + i)),
+            _mm_loadu_si128(reinterpret_cast<__m128i const*>(rhs + i))));
+      }
+#endif
+      total = static_cast<unsigned>(_mm_cvtsi128_si32(half)) + static_cast<unsigned>(_mm_cvtsi128_si32(_mm_unpackhi_epi64(half, half)));
+    }
+#endif
+    for (; i < count; ++i) {
+      total += static_cast<unsigned>(lhs[i].i) * static_cast<unsigned>(rhs[i].i);
+    }
+    return static_cast<int>(total);
+  }
+
+  // partial sums of lhs[i] * rhs[i], or of lhs[i] without rhs, for i below count rounded down to LANES
+  constexpr auto partial_sums(Value const* lhs, Value const* rhs, int const count) noexcept -> std::array<double, LANES>
+  {
+    std::array<double, LANES> acc{};
+    int const blocks{ count / static_cast<int>(LANES) * static_cast<int>(LANES) };
+#if SCI_SIMD_KERNELS
+    if (!std::is_constant_evaluated()) {
+      auto const load = [lhs, rhs](int const at) {
+#if defined(__AVX2__)
+        __m256d const value{ _mm256_loadu_pd(&lhs[at].d) };
+        return rhs == nullptr ? value : _mm256_mul_pd(value, _mm256_loadu_pd(&rhs[at].d));
+#else
+        __m128d const value{ _mm_loadu_pd(&lhs[at].d) };
+        return rhs == nullptr ? value : _mm_mul_pd(value, _mm_loadu_pd(&rhs[at].d));
+#endif
+      };
+#if defined(__AVX2__)
+      __m256d sums{ _mm256_setzero_pd() };
+      for (int i{ 0 }; i < blocks; i += 4) {
+        sums = _mm256_add_pd(sums, load(i));
+      }
+      _mm256_storeu_pd(acc.data(), sums);
+#else
+      __m128d low{ _mm_setzero_pd() };
+      __m128d high{ _mm_setzero_pd() };
+      for (int i{ 0 }; i < blocks; i += 4) {
+        low = _mm_add_pd(low, load(i));
+        high = _mm_add_pd(high, load(i + 2));
+      }
+      _mm_storeu_pd(acc.data(), low);
+      _mm_storeu_pd(acc.data() + 2, high);
+#endif
+      return acc;
+    }
+#endif
+    for (int i{ 0 }; i < blocks; i += static_cast<int>(LANES)) {
+      for (std::size_t lane{ 0 }; lane < LANES; ++lane) {
+        double const value{ lhs[i + static_cast<int>(lane)].d };
+        acc[lane] += rhs == nullptr ? value : value * rhs[i + static_cast<int>(lane)].d;
+      }
+    }
+    return acc;
+  }
+
+  constexpr auto dot_double(Value const* lhs, Value const* rhs, int const count) noexcept -> double
+  {
+    auto const acc = partial_sums(lhs, rhs, count);
+    double total{ (acc[0] + acc[1]) + (acc[2] + acc[3]) };
+    for (int i{ std::max(count / static_cast<int>(LANES) * static_cast<int>(LANES), 0) }; i < count; ++i) {
+      total += rhs == nullptr ? lhs[i].d : lhs[i].d * rhs[i].d;
+    }
+    return total;
+  }
+
+  constexpr auto sum_double(Value const* values, int const count) noexcept -> double
+  {
+    return dot_double(values, nullptr, count);
+  }
+
+  constexpr auto fill(Value* values, Value const value, int const count) noexcept -> void
+  {
+    std::fill(values, values + std::max(count, 0), value);
+  }
+
+  // Forward copy like the loop `dst[i] = src[i]`: a source overlapping the destination
+  // from below repeats itself, anything else behaves like memmove
+  constexpr auto copy(Value* dst, Value const* src, int const count) noexcept -> void
+  {
+    if (count <= 0 || dst == src) {
+      return;
+    }
+    if (dst < src || dst >= src + count) {
+      std::copy(src, src + count, dst);
+      return;
+    }
+    for (int i{ 0 }; i < count; ++i) {
+      dst[i] = src[i];
+    }
+  }
+}// namespace kernels
+
+}// namespace sci
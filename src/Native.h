@@ -0,0 +1,187 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+
+#include "CompiledProgram.h"
+
+namespace sci {
+
+namespace detail {
+  // Conversion between host values and untagged VM values, one specialization per
+  // type a script can pass
+  template<typename T>
+  struct NativeType
+  {
+    static_assert(sizeof(T) == 0, "host function parameters and results are int, char, double or void");
+  };
+
+  template<>
+  struct NativeType<int>
+  {
+    static constexpr auto type{ Literal::Type::INT_ };
+    static constexpr auto get(Value const value) noexcept -> int { return value.i; }
+    static constexpr auto make(int const value) noexcept -> Value { return { value }; }
+  };
+
+  template<>
+  struct NativeType<char>
+  {
+    static constexpr auto type{ Literal::Type::CHAR_ };
+    static constexpr auto get(Value const value) noexcept -> char { return static_cast<char>(value.i); }
+    static constexpr auto make(char const value) noexcept -> Value { return { value }; }
+  };
+
+  template<>
+  struct NativeType<double>
+  {
+    static constexpr auto type{ Literal::Type::DOUBLE_ };
+    static constexpr auto get(Value const value) noexcept -> double { return value.d; }
+    static constexpr auto make(double const value) noexcept -> Value { return { .d = value }; }
+  };
+
+  template<typename R, typename... Args>
+  constexpr auto describe(std::string_view const name) noexcept -> NativeFunction
+  {
+    static_assert(sizeof...(Args) <= NativeFunction::MAX_PARAMS, "too many parameters for a host function");
+    NativeFunction native{ name, Literal::Type::NONE_, { NativeType<Args>::type... }, sizeof...(Args) };
+    if constexpr (!std::is_void_v<R>) {
+      native.return_type = NativeType<R>::type;
+    }
+    return native;
+  }
+}// namespace detail
+
+// First parameter of an async host function. resolve() it once, from any thread, to
+// wake the script waiting for the result.
+template<typename R>
+class Completion
+{
+public:
+  explicit Completion(AsyncCall const call) noexcept : call_{ call } {}
+
+  auto resolve(R const value) const -> void
+  {
+    call_.deliver(call_.target, call_.id, detail::NativeType<R>::make(value));
+  }
+
+private:
+  AsyncCall call_;
+};
+
+template<>
+class Completion<void>
+{
+public:
+  explicit Completion(AsyncCall const call) noexcept : call_{ call } {}
+
+  auto resolve() const -> void
+  {
+    call_.deliver(call_.target, call_.id, {});
+  }
+
+private:
+  AsyncCall call_;
+};
+
+namespace detail {
+  template<auto Fn, typename Signature = decltype(Fn)>
+  struct NativeThunk
+  {
+    static_assert(sizeof(Signature) == 0, "host functions are passed as function pointers");
+  };
+
+  template<auto Fn, typename R, typename... Args>
+  struct NativeThunk<Fn, R (*)(Args...)>
+  {
+    template<std::size_t... I>
+    static constexpr auto invoke(Value const* args, std::index_sequence<I...> /*indices*/) -> Value
+    {
+      if constexpr (std::is_void_v<R>) {
+        Fn(NativeType<Args>::get(args[I])...);
+        return {};
+      } else {
+        return NativeType<R>::make(Fn(NativeType<Args>::get(args[I])...));
+      }
+    }
+
+    static constexpr auto call(Value const* args) -> Value
+    {
+      return invoke(args, std::index_sequence_for<Args...>{});
+    }
+
+    static constexpr auto describe(std::string_view const name) noexcept -> NativeFunction
+    {
+      auto native = detail::describe<R, Args...>(name);
+      native.call = &call;
+      return native;
+    }
+  };
+
+  template<auto Fn, typename R, typename... Args>
+  struct NativeThunk<Fn, R (*)(Args...) noexcept> : NativeThunk<Fn, R (*)(Args...)>
+  {};
+
+  template<auto Fn, typename Signature = decltype(Fn)>
+  struct AsyncThunk
+  {
+    static_assert(sizeof(Signature) == 0, "async host functions are function pointers taking a Completion first");
+  };
+
+  template<auto Fn, typename R, typename... Args>
+  struct AsyncThunk<Fn, void (*)(Completion<R>, Args...)>
+  {
+    template<std::size_t... I>
+    static auto invoke(Value const* args, AsyncCall const done, std::index_sequence<I...> /*indices*/) -> void
+    {
+      Fn(Completion<R>{ done }, NativeType<Args>::get(args[I])...);
+    }
+
+    static auto start(Value const* args, AsyncCall const done) -> void
+    {
+      invoke(args, done, std::index_sequence_for<Args...>{});
+    }
+
+    static constexpr auto describe(std::string_view const name) noexcept -> NativeFunction
+    {
+      auto native = detail::describe<R, Args...>(name);
+      native.start = &start;
+      return native;
+    }
+  };
+
+  template<auto Fn, typename R, typename... Args>
+  struct AsyncThunk<Fn, void (*)(Completion<R>, Args...) noexcept> : AsyncThunk<Fn, void (*)(Completion<R>, Args...)>
+  {};
+}// namespace detail
+
+// Registers the host function Fn under `name`. The signature is checked when the
+// template is instantiated and the generated thunk reads the arguments straight from
+// the comp_stack, nothing is boxed. Scripts call it like a function of their own,
+// script functions of the same name take precedence:
+//   constexpr auto twice(int x) -> int { return 2 * x; }
+//   constexpr std::array natives{ sci::native<twice>("twice") };
+//   sci::Parser<N, M>{ tokens, natives }.parse();
+// Constexpr host functions keep the whole run usable in constant evaluation.
+template<auto Fn>
+constexpr auto native(std::string_view const name) noexcept -> NativeFunction
+{
+  return detail::NativeThunk<Fn>::describe(name);
+}
+
+// Registers the host function Fn, which starts an operation and returns before its
+// result is there:
+//   auto fetch(sci::Completion<int> done, int key) -> void { io.read(key, [done](int v) { done.resolve(v); }); }
+// A script calling it stops with Result::WAITING and keeps no thread busy, the result
+// reaches it through Interpreter::complete. The Scheduler does both for its scripts.
+template<auto Fn>
+constexpr auto async_native(std::string_view const name) noexcept -> NativeFunction
+{
+  return detail::AsyncThunk<Fn>::describe(name);
+}
+
+inline constexpr std::array<NativeFunction, 0> no_natives{};
+
+}// namespace sci
@@ -0,0 +1,92 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <ostream>
+
+#include "CompiledProgram.h"
+#include "ExecutionHooks.h"
+
+namespace sci {
+
+// Dispatch statistics for tuning the VM, pass it to Interpreter::interpret as hooks.
+// Counts executions per instruction type and per consecutive pair of types
+// (candidates for superinstructions) and tracks the deepest func_stack and comp_stack.
+class OpcodeStats : public ExecutionHooks
+{
+public:
+  constexpr static auto NUM_OF_TYPES{ static_cast<std::size_t>(Instruction::Type::TYPES_END) };
+  using TypeCounters = std::array<std::size_t, NUM_OF_TYPES>;
+  using PairCounters = std::array<TypeCounters, NUM_OF_TYPES>;
+
+private:
+  TypeCounters counts_{};
+  PairCounters pairs_{};
+  std::size_t executed_{ 0 };
+  std::size_t max_func_depth_{ 0 };
+  std::size_t max_comp_depth_{ 0 };
+  Instruction::Type previous_{ Instruction::Type::TYPES_END };
+
+public:
+  template<typename FuncStack, typename CompStack>
+  constexpr auto on_instruction(FuncStack const& func_stack, CompStack const& comp_stack) noexcept -> void
+  {
+    auto const type = func_stack.top().next_ins_ptr->type;
+    auto const index = static_cast<std::size_t>(type);
+
+    ++executed_;
+    ++counts_[index];
+    if (previous_ != Instruction::Type::TYPES_END) {
+      ++pairs_[static_cast<std::size_t>(previous_)][index];
+    }
+    previous_ = type;
+
+    max_func_depth_ = std::max(max_func_depth_, func_stack.size());
+    max_comp_depth_ = std::max(max_comp_depth_, comp_stack.size());
+  }
+
+  [[nodiscard]] constexpr auto executed() const noexcept { return executed_; }
+  [[nodiscard]] constexpr auto count(Instruction::Type const type) const noexcept
+  {
+    return counts_[static_cast<std::size_t>(type)];
+  }
+  [[nodiscard]] constexpr auto count(Instruction::Type const first, Instruction::Type const second) const noexcept
+  {
+    return pairs_[static_cast<std::size_t>(first)][static_cast<std::size_t>(second)];
+  }
+  [[nodiscard]] constexpr auto max_func_depth() const noexcept { return max_func_depth_; }
+  [[nodiscard]] constexpr auto max_comp_depth() const noexcept { return max_comp_depth_; }
+
+  // {"executed":N,"max_func_depth":N,"max_comp_depth":N,
+  //  "opcodes":{"VAL":N,...},"pairs":{"VAL RET":N,...}}
+  // Only opcodes and pairs that were executed at least once are listed.
+  auto write_json(std::ostream& out) const -> void
+  {
+    out << "{\"executed\":" << executed_
+        << ",\"max_func_depth\":" << max_func_depth_
+        << ",\"max_comp_depth\":" << max_comp_depth_
+        << ",\"opcodes\":{";
+    bool first{ true };
+    for (std::size_t i{ 0 }; i < NUM_OF_TYPES; ++i) {
+      if (counts_[i] == 0) {
+        continue;
+      }
+      out << (first ? "" : ",") << '"' << to_string(static_cast<Instruction::Type>(i)) << "\":" << counts_[i];
+      first = false;
+    }
+    out << "},\"pairs\":{";
+    first = true;
+    for (std::size_t i{ 0 }; i < NUM_OF_TYPES; ++i) {
+      for (std::size_t j{ 0 }; j < NUM_OF_TYPES; ++j) {
+        if (pairs_[i][j] == 0) {
+          continue;
+        }
+        out << (first ? "" : ",") << '"' << to_string(static_cast<Instruction::Type>(i)) << ' '
+            << to_string(static_cast<Instruction::Type>(j)) << "\":" << pairs_[i][j];
+        first = false;
+      }
+    }
+    out << "}}\n";
+  }
+};
+
+}// namespace sci
@@ -0,0 +1,318 @@
+#pragma once
+#include <algorithm>
+#include <array>
+
+#include "CompiledProgram.h"
+#include "StackBounds.h"
+
+namespace sci {
+
+// Fused branch replacing `compare` followed by `branch` (JZ or JNZ), NONE if there is none
+constexpr auto fused_branch(Instruction::Type const compare, Instruction::Type const branch) noexcept -> Instruction::Type
+{
+  bool const on_true{ branch == Instruction::Type::JNZ };
+  switch (compare) {
+  case Instruction::Type::LT:
+    return on_true ? Instruction::Type::JLT : Instruction::Type::JGE;
+  case Instruction::Type::LE:
+    return on_true ? Instruction::Type::JLE : Instruction::Type::JGT;
+  case Instruction::Type::GT:
+    return on_true ? Instruction::Type::JGT : Instruction::Type::JLE;
+  case Instruction::Type::GE:
+    return on_true ? Instruction::Type::JGE : Instruction::Type::JLT;
+  case Instruction::Type::EQ:
+    return on_true ? Instruction::Type::JEQ : Instruction::Type::JNE;
+  case Instruction::Type::NE:
+    return on_true ? Instruction::Type::JNE : Instruction::Type::JEQ;
+  default:
+    return Instruction::Type::NONE;
+  }
+}
+
+namespace detail {
+  constexpr auto N{ CompiledFunction::NUM_OF_INS };
+
+  // Jump targets of a function and the instructions a pass removes from it
+  struct FunctionEdit
+  {
+    int length{ 0 };
+    std::array<int, N> targets{};// by old index, a target of `length` is the end of the function
+    std::array<bool, N + 1> is_target{};
+    std::array<bool, N> removed{};
+    bool valid{ true };// false for jumps out of the function, leave those to the interpreter
+
+    constexpr explicit FunctionEdit(CompiledFunction const& func) noexcept
+    {
+      auto const& ins = func.instructions;
+      for (int i{ 0 }; i < N; ++i) {
+        if (ins[static_cast<std::size_t>(i)].type != Instruction::Type::NONE) {
+          length = i + 1;
+        }
+      }
+      for (int i{ 0 }; i < length; ++i) {
+        if (is_jump(ins[static_cast<std::size_t>(i)].type)) {
+          targets[static_cast<std::size_t>(i)] = i + 1 + ins[static_cast<std::size_t>(i)].par.i;
+          if (targets[static_cast<std::size_t>(i)] < 0 || targets[static_cast<std::size_t>(i)] > length) {
+            valid = false;
+            return;
+          }
+          is_target[static_cast<std::size_t>(targets[static_cast<std::size_t>(i)])] = true;
+        }
+      }
+    }
+
+    // drops the removed instructions and recomputes the jump offsets
+    constexpr auto apply(CompiledFunction& func) const noexcept -> void
+    {
+      auto& ins = func.instructions;
+      std::array<int, N + 1> new_index{};
+      int next{ 0 };
+      for (int i{ 0 }; i < length; ++i) {
+        new_index[static_cast<std::size_t>(i)] = next;
+        if (!removed[static_cast<std::size_t>(i)]) {
+          ++next;
+        }
+      }
+      new_index[static_cast<std::size_t>(length)] = next;
+
+      for (int i{ 0 }; i < length; ++i) {
+        if (removed[static_cast<std::size_t>(i)]) {
+          continue;
+        }
+        auto instruction = ins[static_cast<std::size_t>(i)];
+        if (is_jump(instruction.type)) {
+          instruction.par = { new_index[static_cast<std::size_t>(targets[static_cast<std::size_t>(i)])] - (new_index[static_cast<std::size_t>(i)] + 1) };
+        }
+        ins[static_cast<std::size_t>(new_index[static_cast<std::size_t>(i)])] = instruction;
+      }
+      for (int i{ next }; i < length; ++i) {
+        ins[static_cast<std::size_t>(i)] = {};
+      }
+    }
+  };
+
+  constexpr auto is_load(Instruction const& ins, int const local) noexcept -> bool
+  {
+    return ins.type == Instruction::Type::LOAD && ins.par.i == local;
+  }
+
+  // a constant int or a local other than `stored`, which the loop body writes
+  constexpr auto is_invariant(Instruction const& ins, int const stored) noexcept -> bool
+  {
+    return (ins.type == Instruction::Type::VAL && ins.par_type == Literal::Type::INT_)
+           || (ins.type == Instruction::Type::LOAD && ins.par.i != stored);
+  }
+
+  constexpr auto same_operand(Instruction const& lhs, Instruction const& rhs) noexcept -> bool
+  {
+    if (lhs.type != rhs.type || lhs.par_type != rhs.par_type) {
+      return false;
+    }
+    return lhs.par_type == Literal::Type::DOUBLE_ ? lhs.par.d == rhs.par.d : lhs.par.i == rhs.par.i;
+  }
+
+  // `base[i]` as `base, LOAD i, ADD` starting at `at`, base is an array or a pointer local
+  constexpr auto is_element(std::array<Instruction, N> const& ins, int const at, int const i, int const stored) noexcept -> bool
+  {
+    return (ins[static_cast<std::size_t>(at)].type == Instruction::Type::ADDR || (ins[static_cast<std::size_t>(at)].type == Instruction::Type::LOAD && ins[static_cast<std::size_t>(at)].par.i != stored && ins[static_cast<std::size_t>(at)].par.i != i))
+           && is_load(ins[static_cast<std::size_t>(at + 1)], i) && ins[static_cast<std::size_t>(at + 2)].type == Instruction::Type::ADD;
+  }
+
+  // Replacement of the loop whose body is [first, last), a length of 0 if it is no kernel
+  struct Kernel
+  {
+    std::array<Instruction, 16> code{};
+    int length{ 0 };
+
+    constexpr auto add(Instruction const& ins) noexcept -> void { code[static_cast<std::size_t>(length++)] = ins; }
+  };
+
+  constexpr auto match_kernel(std::array<Instruction, N> const& ins, int const first, int const last, int const i, Instruction const& bound) noexcept -> Kernel
+  {
+    using Type = Instruction::Type;
+    Kernel kernel;
+    int const size{ last - first };
+    auto const at = [&ins, first](int const offset) -> Instruction const& { return ins[static_cast<std::size_t>(first + offset)]; };
+    // the elements left: bound - i
+    auto const count = [&kernel, &bound, i] {
+      kernel.add(bound);
+      kernel.add({ Type::LOAD, { i } });
+      kernel.add({ Type::SUB, {} });
+    };
+
+    // s += p[i]
+    if (size == 7 && at(0).type == Type::LOAD && at(0).par.i != i && !is_load(bound, at(0).par.i)
+        && is_element(ins, first + 1, i, at(0).par.i) && at(4).type == Type::LOAD_IND
+        && at(5).type == Type::ADD && at(6).type == Type::STORE && at(6).par.i == at(0).par.i) {
+      kernel.add(at(1));
+      kernel.add(at(2));
+      kernel.add(at(3));
+      count();
+      kernel.add({ Type::SUM, {} });
+      kernel.add(at(0));
+      kernel.add({ Type::ADD, {} });
+      kernel.add(at(6));
+    }
+    // s += p[i] * q[i]
+    else if (size == 12 && at(0).type == Type::LOAD && at(0).par.i != i && !is_load(bound, at(0).par.i)
+             && is_element(ins, first + 1, i, at(0).par.i) && at(4).type == Type::LOAD_IND
+             && is_element(ins, first + 5, i, at(0).par.i) && at(8).type == Type::LOAD_IND
+             && at(9).type == Type::MUL && at(10).type == Type::ADD
+             && at(11).type == Type::STORE && at(11).par.i == at(0).par.i) {
+      for (int k{ 1 }; k < 4; ++k) {
+        kernel.add(at(k));
+      }
+      for (int k{ 5 }; k < 8; ++k) {
+        kernel.add(at(k));
+      }
+      count();
+      kernel.add({ Type::DOT, {} });
+      kernel.add(at(0));
+      kernel.add({ Type::ADD, {} });
+      kernel.add(at(11));
+    }
+    // p[i] = v
+    else if (size == 5 && is_element(ins, first, i, i)
+             && (at(3).type == Type::VAL || (at(3).type == Type::LOAD && at(3).par.i != i))
+             && at(4).type == Type::STORE_IND) {
+      for (int k{ 0 }; k < 4; ++k) {
+        kernel.add(at(k));
+      }
+      count();
+      kernel.add({ Type::FILL, {} });
+    }
+    // p[i] = q[i]
+    else if (size == 8 && is_element(ins, first, i, i) && is_element(ins, first + 3, i, i)
+             && at(6).type == Type::LOAD_IND && at(7).type == Type::STORE_IND) {
+      for (int k{ 0 }; k < 6; ++k) {
+        kernel.add(at(k));
+      }
+      count();
+      kernel.add({ Type::COPY, {} });
+    } else {
+      return {};
+    }
+    // the counter ends where the loop would have left it
+    kernel.add(bound);
+    kernel.add({ Type::STORE, { i } });
+    return kernel;
+  }
+
+  // Counted loops over arrays become the kernels of Kernels.h. The parser inverts loops,
+  //   LOAD i, bound, LT, JZ(end), body, LOAD i, VAL 1, ADD, STORE i, LOAD i, bound, LT, JNZ(body)
+  // and when body is one of
+  //   s += p[i]          LOAD s, base, LOAD i, ADD, LOAD_IND, ADD, STORE s
+  //   s += p[i] * q[i]   LOAD s, base, LOAD i, ADD, LOAD_IND, base, LOAD i, ADD, LOAD_IND, MUL, ADD, STORE s
+  //   p[i] = v           base, LOAD i, ADD, v, STORE_IND
+  //   p[i] = q[i]        base, LOAD i, ADD, base, LOAD i, ADD, LOAD_IND, STORE_IND
+  // with a base that is an array or a pointer local and a bound that is an int constant
+  // or a local the body does not store, everything from the body to the JNZ becomes one
+  // SUM, DOT, FILL or COPY over the bound - i elements that are left, followed by
+  // i = bound. The guard stays, so the kernel only runs where the loop would. Only int
+  // sums are rewritten, doubles summed in another order would round differently.
+  // Stores through the pointers are assumed to stay inside their arrays.
+  constexpr auto rewrite_loops(CompiledFunction& func, FunctionEdit& edit) noexcept -> void
+  {
+    using Type = Instruction::Type;
+    auto& ins = func.instructions;
+    auto const at = [&ins](int const index) -> Instruction const& { return ins[static_cast<std::size_t>(index)]; };
+    for (int jnz{ 0 }; jnz < edit.length; ++jnz) {
+      int const body{ edit.targets[static_cast<std::size_t>(jnz)] };
+      if (at(jnz).type != Type::JNZ || body < 4 || body > jnz - 7) {
+        continue;
+      }
+      int const guard{ body - 1 };
+      auto const& counter = at(guard - 3);
+      auto const& bound = at(guard - 2);
+      if (counter.type != Type::LOAD) {
+        continue;
+      }
+      int const i{ counter.par.i };
+      bool const counted{ at(guard).type == Type::JZ && edit.targets[static_cast<std::size_t>(guard)] == jnz + 1
+                          && is_invariant(bound, i) && at(guard - 1).type == Type::LT
+                          && same_operand(at(jnz - 3), counter) && same_operand(at(jnz - 2), bound) && at(jnz - 1).type == Type::LT
+                          && is_load(at(jnz - 7), i) && at(jnz - 6).type == Type::VAL && at(jnz - 6).par_type == Literal::Type::INT_
+                          && at(jnz - 6).par.i == 1 && at(jnz - 5).type == Type::ADD
+                          && at(jnz - 4).type == Type::STORE && at(jnz - 4).par.i == i };
+      if (!counted || std::any_of(edit.is_target.begin() + body + 1, edit.is_target.begin() + jnz + 1, [](bool const t) { return t; })) {
+        continue;
+      }
+      auto const kernel = match_kernel(ins, body, jnz - 7, i, bound);
+      if (kernel.length == 0) {
+        continue;
+      }
+      for (int k{ 0 }; k < kernel.length; ++k) {
+        ins[static_cast<std::size_t>(body + k)] = kernel.code[static_cast<std::size_t>(k)];
+      }
+      for (int k{ body + kernel.length }; k <= jnz; ++k) {
+        edit.removed[static_cast<std::size_t>(k)] = true;
+      }
+    }
+  }
+
+  // A comparison followed by JZ/JNZ becomes one fused compare-and-branch instruction
+  // (LT JZ -> JGE, LT JNZ -> JLT, ...), which halves the dispatches of every loop
+  // condition. A pair is left alone when something jumps to its branch.
+  constexpr auto fuse_branches(CompiledFunction& func, FunctionEdit& edit) noexcept -> void
+  {
+    auto& ins = func.instructions;
+    for (int i{ 0 }; i + 1 < edit.length; ++i) {
+      auto const& branch = ins[static_cast<std::size_t>(i + 1)];
+      if ((branch.type == Instruction::Type::JZ || branch.type == Instruction::Type::JNZ)
+          && !edit.is_target[static_cast<std::size_t>(i + 1)]) {
+        auto const fused = fused_branch(ins[static_cast<std::size_t>(i)].type, branch.type);
+        if (fused != Instruction::Type::NONE) {
+          ins[static_cast<std::size_t>(i)].type = fused;
+          edit.targets[static_cast<std::size_t>(i)] = edit.targets[static_cast<std::size_t>(i + 1)];
+          edit.removed[static_cast<std::size_t>(i + 1)] = true;
+          ++i;
+        }
+      }
+    }
+  }
+}// namespace detail
+
+// The passes in the order optimize runs them
+enum class OptimizerPass {
+  LOOPS,// detail::rewrite_loops
+  BRANCHES,// detail::fuse_branches
+};
+
+constexpr auto optimize_function(CompiledFunction& func, OptimizerPass const last = OptimizerPass::BRANCHES) noexcept -> void
+{
+  detail::FunctionEdit loops{ func };
+  if (!loops.valid) {
+    return;
+  }
+  detail::rewrite_loops(func, loops);
+  loops.apply(func);
+  if (last == OptimizerPass::LOOPS) {
+    return;
+  }
+
+  detail::FunctionEdit branches{ func };
+  detail::fuse_branches(func, branches);
+  branches.apply(func);
+}
+
+// Peephole passes over a parsed program: counted loops over arrays become kernel
+// instructions and compare-and-branch pairs are fused, see detail::rewrite_loops and
+// detail::fuse_branches. Jump offsets are recomputed after each pass. A kernel can take
+// more of the comp_stack than the loop it replaces, so the stack bounds are recomputed.
+// `last` stops after an earlier pass, sci-dis shows the program after each of them.
+constexpr auto optimize(CompiledProgram program, OptimizerPass const last = OptimizerPass::BRANCHES) noexcept -> CompiledProgram
+{
+  for (auto& func : program.functions) {
+    optimize_function(func, last);
+  }
+  if (program.info.r == Result::OK) {
+    auto const bounds = stack_bounds(program);
+    for (int i{ 0 }; i < CompiledProgram::NUM_OF_FUNC; ++i) {
+      program.functions[static_cast<std::size_t>(i)].max_comp_depth = bounds.max_depth[static_cast<std::size_t>(i)];
+    }
+    program.info.comp_stack = bounds.comp_stack;
+  }
+  return program;
+}
+
+}// namespace sci
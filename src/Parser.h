@@ -1,8 +1,13 @@
 #pragma once
+#include <algorithm>
+#include <span>
+#include <type_traits>
+
 #include "eternal.hpp"
 
 #include "Common.h"
 #include "CompiledProgram.h"
+#include "StackBounds.h"
 #include "Tokenizer.h"
 
 namespace sci {
@@ -23,11 +28,30 @@ enum class Symbol {
   NT_FUNC_DEF_PARAMS,
   NT_FUNC_DEF_PARAMS_NEXT,
   NT_EXPRESSION,
+  NT_STATEMENT,
+  NT_EXPR_STATEMENT,
+  NT_VAR_INIT,
+  NT_FOR_INIT,
+  NT_FOR_STEP,
+  NT_POINTER,
+  NT_ARRAY,
 
   NONTERMINALS_END,
 
   GEN_RET,
   GEN_NEW_FUNC,
+  GEN_NEW_VAR,
+  GEN_STORE_VAR,
+  GEN_IF,
+  GEN_ELSE,
+  GEN_ELSE_BEGIN,
+  GEN_IF_END,
+  GEN_LOOP_COND,
+  GEN_WHILE_BODY,
+  GEN_WHILE_END,
+  GEN_FOR_STEP,
+  GEN_FOR_BODY,
+  GEN_FOR_END,
 };
 
 struct TokenSymbol
@@ -47,7 +71,7 @@ constexpr bool operator<(TokenSymbol const& lhs, TokenSymbol const& rhs)
 struct SymbolSequence
 {
   char count;
-  std::array<Symbol, 10> seq;
+  std::array<Symbol, 13> seq;
 
   auto rbegin() noexcept { return seq.rbegin(); }
   auto rend() noexcept { return seq.rbegin() + count; }
@@ -59,14 +83,99 @@ class CompilingFunction
   std::string_view name_;
   int next_index_{ 0 };
   CompiledFunction* func_;
+public:
+  struct Local
+  {
+    std::string_view id;
+    Literal::Type type;// arrays decay to a pointer to their element type
+    int offset;// in the frame
+    int size;// elements of an array, 0 for scalars
+  };
+
+private:
+  // locals are function scoped, a redeclaration of the same size reuses the memory
+  std::array<Local, CompiledFunction::NUM_OF_LOCALS> locals_{};
+  int num_of_locals_{ 0 };
 
 public:
-  constexpr auto set_name(std::string_view name) noexcept -> void { name_ = name; }
+  constexpr auto set_name(std::string_view name) noexcept -> void
+  {
+    name_ = name;
+    func_->name = name;
+  }
+  constexpr auto set_return_type(Literal::Type const type) noexcept -> void { func_->return_type = type; }
+  [[nodiscard]] constexpr auto return_type() const noexcept { return func_->return_type; }
+  // instructions past NUM_OF_INS are dropped and reported by overflowed()
   constexpr auto add_instruction(Instruction const& ins) -> void
   {
-    func_->instructions[next_index_] = ins;
+    if (next_index_ < CompiledFunction::NUM_OF_INS) {
+      func_->instructions[static_cast<std::size_t>(next_index_)] = ins;
+    }
     ++next_index_;
   }
+  [[nodiscard]] constexpr auto next_index() const noexcept { return next_index_; }
+  [[nodiscard]] constexpr auto overflowed() const noexcept { return next_index_ > CompiledFunction::NUM_OF_INS; }
+
+  // points the jump at `at` to `target`
+  constexpr auto patch_jump(int const at, int const target) noexcept -> void
+  {
+    if (at < CompiledFunction::NUM_OF_INS) {
+      func_->instructions[static_cast<std::size_t>(at)].par = { target - (at + 1) };
+    }
+  }
+  // appends a copy of [first, last), which must not contain jumps
+  constexpr auto copy(int const first, int const last) -> void
+  {
+    for (int i{ first }; i < last && i < CompiledFunction::NUM_OF_INS; ++i) {
+      add_instruction(func_->instructions[static_cast<std::size_t>(i)]);
+    }
+  }
+  // moves [middle, last) in front of [first, middle), jumps must stay inside their range
+  constexpr auto rotate(int const first, int const middle, int const last) -> void
+  {
+    if (last <= CompiledFunction::NUM_OF_INS) {
+      auto const begin = func_->instructions.begin();
+      std::rotate(begin + first, begin + middle, begin + last);
+    }
+  }
+
+  // the latest declaration of `id`, -1 if there is none
+  [[nodiscard]] constexpr auto find_local(std::string_view const id) const noexcept -> int
+  {
+    for (int i{ num_of_locals_ - 1 }; i >= 0; --i) {
+      if (locals_[static_cast<std::size_t>(i)].id == id) {
+        return i;
+      }
+    }
+    return -1;
+  }
+  // -1 when all locals are taken, NONE_ leaves the type to the initializer (auto)
+  constexpr auto declare_local(std::string_view const id, Literal::Type const type, int const size) noexcept -> int
+  {
+    if (auto const index = find_local(id); index != -1 && locals_[static_cast<std::size_t>(index)].size == size) {
+      locals_[static_cast<std::size_t>(index)].type = type;
+      return index;
+    }
+    if (num_of_locals_ == CompiledFunction::NUM_OF_LOCALS) {
+      return -1;
+    }
+    locals_[static_cast<std::size_t>(num_of_locals_)] = { id, type, func_->frame_size, size };
+    func_->frame_size += std::max(size, 1);
+    return num_of_locals_++;
+  }
+  [[nodiscard]] constexpr auto local(int const index) const noexcept -> Local const& { return locals_[static_cast<std::size_t>(index)]; }
+  constexpr auto set_local_type(int const index, Literal::Type const type) noexcept -> void { locals_[static_cast<std::size_t>(index)].type = type; }
+  // removes and returns the last instruction
+  constexpr auto pop_instruction() noexcept -> Instruction
+  {
+    --next_index_;
+    if (next_index_ >= CompiledFunction::NUM_OF_INS) {
+      return {};
+    }
+    auto const ins = func_->instructions[static_cast<std::size_t>(next_index_)];
+    func_->instructions[static_cast<std::size_t>(next_index_)] = {};
+    return ins;
+  }
 };
 
 class CompilingProgram
@@ -84,7 +193,7 @@ public:
     }
   }
 
-  constexpr auto new_function(std::string_view id) noexcept -> CompilingFunction* {
+  constexpr auto new_function(std::string_view id, Literal::Type const return_type) noexcept -> CompilingFunction* {
     auto const func_ptr = [this, &id] {
       if (id == "main") {
         return &functions_[0];
@@ -95,6 +204,7 @@ public:
     }();
 
     func_ptr->set_name(id);
+    func_ptr->set_return_type(return_type);
     return func_ptr;
   }
 
@@ -110,6 +220,29 @@ public:
 
     return -1;
   }
+
+  [[nodiscard]] constexpr auto return_type(int const func) const noexcept { return prog_.functions[static_cast<std::size_t>(func)].return_type; }
+
+  // index of `native` in the program's natives, -1 when they are all taken
+  constexpr auto add_native(NativeFunction const& native) noexcept -> int
+  {
+    for (int i{ 0 }; i < CompiledProgram::NUM_OF_NATIVES; ++i) {
+      if (prog_.natives[static_cast<std::size_t>(i)].name.empty()) {
+        prog_.natives[static_cast<std::size_t>(i)] = native;
+      }
+      if (prog_.natives[static_cast<std::size_t>(i)].name == native.name) {
+        return i;
+      }
+    }
+    return -1;
+  }
+
+  [[nodiscard]] constexpr auto strings() noexcept -> StringPool& { return prog_.strings; }
+
+  [[nodiscard]] constexpr auto overflowed() const noexcept -> bool
+  {
+    return std::any_of(functions_.begin(), functions_.end(), [](auto const& f) { return f.overflowed(); });
+  }
 };
 
 template<std::size_t MaxTokens, std::size_t MaxStackSize>
@@ -196,6 +329,102 @@ private:
         Token::Type::OPEN_CURLY,
         Symbol::NT_FUNC_STATEMENT_BLOCK,
       },
+      { 2,
+        {
+          Symbol::NT_STATEMENT,
+          Symbol::NT_FUNC_STATEMENT_BLOCK,
+        } } },
+
+    { {
+        Token::Type::ID,
+        Symbol::NT_FUNC_STATEMENT_BLOCK,
+      },
+      { 2,
+        {
+          Symbol::NT_STATEMENT,
+          Symbol::NT_FUNC_STATEMENT_BLOCK,
+        } } },
+
+    { {
+        Token::Type::KWRET,
+        Symbol::NT_FUNC_STATEMENT_BLOCK,
+      },
+      { 2,
+        {
+          Symbol::NT_STATEMENT,
+          Symbol::NT_FUNC_STATEMENT_BLOCK,
+        } } },
+
+    { {
+        Token::Type::SEMICOLON,
+        Symbol::NT_FUNC_STATEMENT_BLOCK,
+      },
+      { 2,
+        {
+          Symbol::NT_STATEMENT,
+          Symbol::NT_FUNC_STATEMENT_BLOCK,
+        } } },
+
+    { {
+        Token::Type::KWTYPE,
+        Symbol::NT_FUNC_STATEMENT_BLOCK,
+      },
+      { 2,
+        {
+          Symbol::NT_STATEMENT,
+          Symbol::NT_FUNC_STATEMENT_BLOCK,
+        } } },
+
+    { {
+        Token::Type::STAR,
+        Symbol::NT_FUNC_STATEMENT_BLOCK,
+      },
+      { 2,
+        {
+          Symbol::NT_STATEMENT,
+          Symbol::NT_FUNC_STATEMENT_BLOCK,
+        } } },
+
+    { {
+        Token::Type::KWIF,
+        Symbol::NT_FUNC_STATEMENT_BLOCK,
+      },
+      { 2,
+        {
+          Symbol::NT_STATEMENT,
+          Symbol::NT_FUNC_STATEMENT_BLOCK,
+        } } },
+
+    { {
+        Token::Type::KWWHILE,
+        Symbol::NT_FUNC_STATEMENT_BLOCK,
+      },
+      { 2,
+        {
+          Symbol::NT_STATEMENT,
+          Symbol::NT_FUNC_STATEMENT_BLOCK,
+        } } },
+
+    { {
+        Token::Type::KWFOR,
+        Symbol::NT_FUNC_STATEMENT_BLOCK,
+      },
+      { 2,
+        {
+          Symbol::NT_STATEMENT,
+          Symbol::NT_FUNC_STATEMENT_BLOCK,
+        } } },
+
+    { {
+        Token::Type::CLOSE_CURLY,
+        Symbol::NT_FUNC_STATEMENT_BLOCK,
+      },
+      { 0, {} } },
+
+    { {
+        Token::Type::OPEN_CURLY,
+        Symbol::NT_STATEMENT,
+      },
       { 3,
         {
           Symbol::OPEN_CURLY,
@@ -205,41 +434,226 @@ private:
 
     { {
         Token::Type::ID,
-        Symbol::NT_FUNC_STATEMENT_BLOCK,
+        Symbol::NT_STATEMENT,
       },
-      { 3,
+      { 2,
         {
-          Symbol::NT_EXPRESSION,
+          Symbol::NT_EXPR_STATEMENT,
           Symbol::SEMICOLON,
-          Symbol::NT_FUNC_STATEMENT_BLOCK,
         } } },
 
     { {
         Token::Type::KWRET,
-        Symbol::NT_FUNC_STATEMENT_BLOCK,
+        Symbol::NT_STATEMENT,
       },
-      { 5,
+      { 4,
         {
           Symbol::KWRET,
           Symbol::NT_EXPRESSION,
           Symbol::GEN_RET,
           Symbol::SEMICOLON,
-          Symbol::NT_FUNC_STATEMENT_BLOCK,
         } } },
 
     { {
         Token::Type::SEMICOLON,
-        Symbol::NT_FUNC_STATEMENT_BLOCK,
+        Symbol::NT_STATEMENT,
+      },
+      { 1,
+        {
+          Symbol::SEMICOLON,
+        } } },
+
+    { {
+        Token::Type::KWTYPE,
+        Symbol::NT_STATEMENT,
+      },
+      { 7,
+        {
+          Symbol::KWTYPE,
+          Symbol::NT_POINTER,
+          Symbol::ID,
+          Symbol::NT_ARRAY,
+          Symbol::GEN_NEW_VAR,
+          Symbol::NT_VAR_INIT,
+          Symbol::SEMICOLON,
+        } } },
+
+    { {
+        Token::Type::STAR,
+        Symbol::NT_STATEMENT,
       },
       { 2,
         {
+          Symbol::NT_EXPR_STATEMENT,
           Symbol::SEMICOLON,
-          Symbol::NT_FUNC_STATEMENT_BLOCK,
         } } },
 
     { {
-        Token::Type::CLOSE_CURLY,
-        Symbol::NT_FUNC_STATEMENT_BLOCK,
+        Token::Type::STAR,
+        Symbol::NT_POINTER,
+      },
+      { 1,
+        {
+          Symbol::STAR,
+        } } },
+
+    { {
+        Token::Type::ID,
+        Symbol::NT_POINTER,
+      },
+      { 0, {} } },
+
+    { {
+        Token::Type::OPEN_BRACKET,
+        Symbol::NT_ARRAY,
+      },
+      { 3,
+        {
+          Symbol::OPEN_BRACKET,
+          Symbol::LITERAL,
+          Symbol::CLOSE_BRACKET,
+        } } },
+
+    { {
+        Token::Type::EQUAL,
+        Symbol::NT_ARRAY,
+      },
+      { 0, {} } },
+
+    { {
+        Token::Type::SEMICOLON,
+        Symbol::NT_ARRAY,
+      },
+      { 0, {} } },
+
+    { {
+        Token::Type::KWIF,
+        Symbol::NT_STATEMENT,
+      },
+      { 7,
+        {
+          Symbol::KWIF,
+          Symbol::OPEN_PAR,
+          Symbol::NT_EXPRESSION,
+          Symbol::CLOSE_PAR,
+          Symbol::GEN_IF,
+          Symbol::NT_STATEMENT,
+          Symbol::GEN_ELSE,
+        } } },
+
+    { {
+        Token::Type::KWWHILE,
+        Symbol::NT_STATEMENT,
+      },
+      { 8,
+        {
+          Symbol::KWWHILE,
+          Symbol::OPEN_PAR,
+          Symbol::GEN_LOOP_COND,
+          Symbol::NT_EXPRESSION,
+          Symbol::CLOSE_PAR,
+          Symbol::GEN_WHILE_BODY,
+          Symbol::NT_STATEMENT,
+          Symbol::GEN_WHILE_END,
+        } } },
+
+    { {
+        Token::Type::KWFOR,
+        Symbol::NT_STATEMENT,
+      },
+      { 13,
+        {
+          Symbol::KWFOR,
+          Symbol::OPEN_PAR,
+          Symbol::NT_FOR_INIT,
+          Symbol::SEMICOLON,
+          Symbol::GEN_LOOP_COND,
+          Symbol::NT_EXPRESSION,
+          Symbol::SEMICOLON,
+          Symbol::GEN_FOR_STEP,
+          Symbol::NT_FOR_STEP,
+          Symbol::CLOSE_PAR,
+          Symbol::GEN_FOR_BODY,
+          Symbol::NT_STATEMENT,
+          Symbol::GEN_FOR_END,
+        } } },
+
+    { {
+        Token::Type::EQUAL,
+        Symbol::NT_VAR_INIT,
+      },
+      { 3,
+        {
+          Symbol::EQUAL,
+          Symbol::NT_EXPRESSION,
+          Symbol::GEN_STORE_VAR,
+        } } },
+
+    { {
+        Token::Type::SEMICOLON,
+        Symbol::NT_VAR_INIT,
+      },
+      { 0, {} } },
+
+    { {
+        Token::Type::KWTYPE,
+        Symbol::NT_FOR_INIT,
+      },
+      { 6,
+        {
+          Symbol::KWTYPE,
+          Symbol::NT_POINTER,
+          Symbol::ID,
+          Symbol::NT_ARRAY,
+          Symbol::GEN_NEW_VAR,
+          Symbol::NT_VAR_INIT,
+        } } },
+
+    { {
+        Token::Type::STAR,
+        Symbol::NT_FOR_INIT,
+      },
+      { 1,
+        {
+          Symbol::NT_EXPR_STATEMENT,
+        } } },
+
+    { {
+        Token::Type::ID,
+        Symbol::NT_FOR_INIT,
+      },
+      { 1,
+        {
+          Symbol::NT_EXPR_STATEMENT,
+        } } },
+
+    { {
+        Token::Type::SEMICOLON,
+        Symbol::NT_FOR_INIT,
+      },
+      { 0, {} } },
+
+    { {
+        Token::Type::ID,
+        Symbol::NT_FOR_STEP,
+      },
+      { 1,
+        {
+          Symbol::NT_EXPR_STATEMENT,
+        } } },
+
+    { {
+        Token::Type::STAR,
+        Symbol::NT_FOR_STEP,
+      },
+      { 1,
+        {
+          Symbol::NT_EXPR_STATEMENT,
+        } } },
+
+    { {
+        Token::Type::CLOSE_PAR,
+        Symbol::NT_FOR_STEP,
       },
       { 0, {} } },
 
@@ -311,24 +725,34 @@ private:
   });
 
   Tokens const& tokens_;
+  std::span<NativeFunction const> natives_;
 
 public:
-  explicit constexpr Parser(Tokens const& tokens) noexcept
-    : tokens_{ tokens }
+  // `natives` are the host functions scripts may call, see Native.h
+  explicit constexpr Parser(Tokens const& tokens, std::span<NativeFunction const> const natives = {}) noexcept
+    : tokens_{ tokens }, natives_{ natives }
   {}
 
   constexpr auto parse() const noexcept -> CompiledProgram
   {
     ConstexprStack<Symbol, MaxStackSize> stack;
+    // instruction indices of open if/else and loop constructs, see the GEN_ symbols
+    ConstexprStack<int, MaxStackSize> labels;
     CompiledProgram resulting_program;
     CompilingProgram program{ resulting_program };
     CompilingFunction* current_function{ nullptr };
     std::string_view last_identifier;
+    Token::TKW last_type{ Token::TKW::INT_ };
+    bool last_pointer{ false };// `*` after the type
+    int last_array_size{ 0 };// `[size]` after the identifier, -1 if it is not a positive int
+    int last_local{ -1 };
+    bool last_expression_empty{ true };
+    Literal::Type last_expression_type{ Literal::Type::NONE_ };
 
     stack.push(Symbol::NT_PROGRAM);
 
     std::size_t tok_index{ 0 };
-    auto tokensPeek = [this, &tok_index]() -> Token {
+    auto tokensPeek = [this, &tok_index]() -> Token const& {
       return tokens_[tok_index];
     };
     auto tokensNext = [this, &tok_index]() -> void {
@@ -337,26 +761,51 @@ public:
     auto tokensEnd = [this, &tok_index]() -> bool {
       return tokens_[tok_index].type == Token::Type::EMPTY_TOKEN;
     };
+    // a stack too small for the program fails the parse instead of dropping symbols
+    bool stack_overflow{ false };
+    auto push_symbol = [&stack, &stack_overflow](Symbol const symbol) -> void {
+      stack_overflow = stack_overflow || !stack.try_push(symbol);
+    };
+    auto push_label = [&labels, &stack_overflow](int const label) -> void {
+      stack_overflow = stack_overflow || !labels.try_push(label);
+    };
+    auto pop_label = [&labels]() -> int {
+      int const label{ labels.top() };
+      labels.pop();
+      return label;
+    };
+
+    std::size_t max_stack_size{ 0 };
 
     while (!stack.empty()) {
+      if (stack_overflow) {
 #ifdef SCI_NONCONSTEXPR
-      auto printToken = [](Token const& a) { fmt::print("{} ", magic_enum::enum_name(a.type)); };
-      auto printSymbol = [](Symbol const& a) { fmt::print("{} ", magic_enum::enum_name(a)); };
-      for (std::size_t i = tok_index; tokens_[i].type != Token::Type::END_OF_SOURCECODE; ++i) {
-        printToken(tokens_[i]);
+        spdlog::error("Parser stack too small, MaxStackSize is {}", MaxStackSize);
+#endif
+        CompiledProgram overflowed;
+        overflowed.info.parser_stack = MaxStackSize + 1;
+        return overflowed;
       }
-      puts("");
-      for (int i = 0; i < stack.size(); ++i) {
-        printSymbol(stack.data()[i]);
+      max_stack_size = std::max(max_stack_size, stack.size());
+#ifdef SCI_NONCONSTEXPR
+      if (!std::is_constant_evaluated() && spdlog::should_log(spdlog::level::trace)) {
+        std::string remaining_tokens;
+        for (std::size_t i = tok_index; tokens_[i].type != Token::Type::END_OF_SOURCECODE; ++i) {
+          remaining_tokens += fmt::format("{} ", magic_enum::enum_name(tokens_[i].type));
+        }
+        std::string symbols;
+        for (std::size_t i = 0; i < stack.size(); ++i) {
+          symbols += fmt::format("{} ", magic_enum::enum_name(stack.data()[i]));
+        }
+        spdlog::trace("tokens: {}", remaining_tokens);
+        spdlog::trace("stack:  {}", symbols);
       }
-      puts("");
-      getchar();
 #endif
 
       if (stack.top() < Symbol::TERMINALS_END) {
         if (static_cast<int>(stack.top()) != static_cast<int>(tokensPeek().type)) {
 #ifdef SCI_NONCONSTEXPR
-          fmt::print("Found wrong terminal: {}, expected {}", magic_enum::enum_name(tokensPeek().type), magic_enum::enum_name(stack.top()));
+          spdlog::error("Found wrong terminal: {}, expected {}", magic_enum::enum_name(tokensPeek().type), magic_enum::enum_name(stack.top()));
 #endif
           //TODO: ERROR HANDLING
           return {};
@@ -367,6 +816,22 @@ public:
           last_identifier = std::get<std::string_view>(tokensPeek().val);
           break;
 
+        case Token::Type::KWTYPE:
+          last_type = std::get<Token::TKW>(tokensPeek().val);
+          last_pointer = false;
+          last_array_size = 0;
+          break;
+
+        case Token::Type::STAR:
+          last_pointer = true;
+          break;
+
+        case Token::Type::LITERAL: {
+          auto const& size = std::get<Literal>(tokensPeek().val);
+          last_array_size = size.type == Literal::Type::INT_ && std::get<int>(size.val) > 0 ? std::get<int>(size.val) : -1;
+          break;
+        }
+
         default:
           break;
         }
@@ -375,73 +840,160 @@ public:
         tokensNext();
 
       } else if (stack.top() > Symbol::NONTERMINALS_END) {
-        switch (stack.top()) {
+        auto const gen = stack.top();
+        stack.pop();
+        if (gen != Symbol::GEN_NEW_FUNC && !current_function) {
+#ifdef SCI_NONCONSTEXPR
+          spdlog::error("Not inside a function");
+#endif
+          return {};
+        }
+
+        switch (gen) {
         case Symbol::GEN_NEW_FUNC:
-          current_function = program.new_function(last_identifier);
+          // auto functions return int
+          current_function = program.new_function(last_identifier,
+            last_type == Token::TKW::AUTO_ ? Literal::Type::INT_ : declared_type(last_type));
           break;
 
         case Symbol::GEN_RET:
-          if (current_function) {
-            current_function->add_instruction({ Instruction::Type::RET, {} });
+          // `return;` outside of void functions returns 0 so that callers find a value
+          if (last_expression_empty) {
+            if (current_function->return_type() != Literal::Type::NONE_) {
+              current_function->add_instruction(zero(current_function->return_type()));
+            }
+          } else if (!emit_conversion(*current_function, last_expression_type, current_function->return_type())) {
+            return {};
+          }
+          current_function->add_instruction({ Instruction::Type::RET, {} });
+          break;
 
-          } else {
+        case Symbol::GEN_NEW_VAR: {
+          // pointers and arrays need an element type, there are no pointers to pointers
+          auto type = declared_type(last_type);
+          bool const array{ last_array_size != 0 };
+          if (last_type == Token::TKW::VOID_ || last_array_size < 0
+              || ((last_pointer || array) && type == Literal::Type::NONE_) || (last_pointer && array)) {
+            return {};
+          }
+          if (last_pointer || array) {
+            type = pointer_to(type);
+          }
+          last_local = current_function->declare_local(last_identifier, type, last_array_size);
+          if (last_local == -1) {
 #ifdef SCI_NONCONSTEXPR
-            fmt::print("Not inside a function");
+            spdlog::error("Too many local variables in {}", last_identifier);
 #endif
+            return {};
           }
           break;
+        }
 
-        default:
+        case Symbol::GEN_STORE_VAR: {
+          auto const& local = current_function->local(last_local);
+          if (last_expression_empty || last_expression_type == Literal::Type::NONE_ || local.size != 0) {
+            return {};
+          }
+          if (local.type == Literal::Type::NONE_) {
+            current_function->set_local_type(last_local, last_expression_type);
+          }
+          if (!emit_conversion(*current_function, last_expression_type, local.type)) {
+            return {};
+          }
+          current_function->add_instruction({ Instruction::Type::STORE, { local.offset } });
           break;
         }
 
-        stack.pop();
+        // if (cond) a else b:  cond JZ(else) a JMP(end) else: b end:
+        case Symbol::GEN_IF:
+          if (last_expression_empty || !emit_condition(*current_function, last_expression_type)) {
+            return {};
+          }
+          push_label(current_function->next_index());
+          current_function->add_instruction({ Instruction::Type::JZ, {} });
+          break;
 
-      } else {
-        if (stack.top() == Symbol::NT_EXPRESSION) {
-          auto const is_tok_expr = [](Token::Type t) {
-            Token::Type exprs[] = {
-              Token::Type::LITERAL,
-              Token::Type::PLUS,
-              Token::Type::MINUS,
-              Token::Type::STAR,
-              Token::Type::ID,
-              Token::Type::SLASH,
-              Token::Type::OPEN_PAR,
-              Token::Type::CLOSE_PAR,
-            };
-            return std::any_of(std::begin(exprs), std::end(exprs), [&t](Token::Type tt) {
-              return t == tt;
-            });
-          };
-          while (!tokensEnd()
-                 && is_tok_expr(tokensPeek().type)) {
-            switch (tokensPeek().type) {
-            case Token::Type::LITERAL:
-              current_function->add_instruction({ Instruction::Type::VAL, std::get<Literal>(tokensPeek().val) });
-              break;
-
-            case Token::Type::ID: {
-              std::string_view const id = std::get<std::string_view>(tokensPeek().val);
-              tokensNext();
-              if (tokensPeek().type == Token::Type::OPEN_PAR) {
-                // function call
-                tokensNext();// close_par
-                tokensNext();// next token
-                current_function->add_instruction({ Instruction::Type::CALL, { Literal::Type::INT_, program.get_func_ptr(id) } });
-
-              } else {
-                // variable
-              }
+        case Symbol::GEN_ELSE:
+          if (tokensPeek().type == Token::Type::KWELSE) {
+            push_symbol(Symbol::GEN_IF_END);
+            push_symbol(Symbol::NT_STATEMENT);
+            push_symbol(Symbol::GEN_ELSE_BEGIN);
+            push_symbol(Symbol::KWELSE);
+          } else {
+            current_function->patch_jump(pop_label(), current_function->next_index());
+          }
+          break;
 
-              continue;
-            }
+        case Symbol::GEN_ELSE_BEGIN: {
+          int const jz{ pop_label() };
+          push_label(current_function->next_index());
+          current_function->add_instruction({ Instruction::Type::JMP, {} });
+          current_function->patch_jump(jz, current_function->next_index());
+          break;
+        }
 
-            default:
-              break;
-            }
-            tokensNext();
+        case Symbol::GEN_IF_END:
+          current_function->patch_jump(pop_label(), current_function->next_index());
+          break;
+
+        // Loops are inverted, the condition is repeated after the body so that every
+        // iteration costs one conditional branch:
+        //   while (cond) body:             cond JZ(end) body cond JNZ(body) end:
+        //   for (init; cond; step) body:   init cond JZ(end) body step cond JNZ(body) end:
+        case Symbol::GEN_LOOP_COND:
+          push_label(current_function->next_index());
+          break;
+
+        case Symbol::GEN_WHILE_BODY:
+        case Symbol::GEN_FOR_STEP:
+          if (last_expression_empty || !emit_condition(*current_function, last_expression_type)) {
+            return {};
+          }
+          push_label(current_function->next_index());
+          current_function->add_instruction({ Instruction::Type::JZ, {} });
+          break;
+
+        case Symbol::GEN_FOR_BODY:
+          // the step is compiled in source order and moved behind the body in GEN_FOR_END
+          push_label(current_function->next_index());
+          break;
+
+        case Symbol::GEN_WHILE_END:
+        case Symbol::GEN_FOR_END: {
+          if (gen == Symbol::GEN_FOR_END) {
+            int const body{ pop_label() };
+            current_function->rotate(labels.top() + 1, body, current_function->next_index());
           }
+          int const jz{ pop_label() };
+          int const cond{ pop_label() };
+          current_function->copy(cond, jz);
+          int const jnz{ current_function->next_index() };
+          current_function->add_instruction({ Instruction::Type::JNZ, {} });
+          current_function->patch_jump(jnz, jz + 1);
+          current_function->patch_jump(jz, current_function->next_index());
+          break;
+        }
+
+        default:
+          break;
+        }
+
+      } else {
+        if (stack.top() == Symbol::NT_EXPRESSION || stack.top() == Symbol::NT_EXPR_STATEMENT) {
+          if (!current_function) {
+            return {};
+          }
+          int const start{ current_function->next_index() };
+          bool const ok{ stack.top() == Symbol::NT_EXPRESSION
+                           ? compile_expression(tok_index, *current_function, program, last_expression_type)
+                           : compile_expr_statement(tok_index, *current_function, program) };
+          if (!ok) {
+#ifdef SCI_NONCONSTEXPR
+            spdlog::error("Invalid expression at token {}", tok_index);
+#endif
+            return {};
+          }
+          last_expression_empty = current_function->next_index() == start;
           stack.pop();
           continue;
         }
@@ -457,22 +1009,660 @@ public:
         stack.pop();
         if (it != symbol_map.end()) {
           for (int i{ it->second.count - 1 }; i >= 0; --i) {
-            stack.push(it->second.seq[i]);
+            push_symbol(it->second.seq[static_cast<std::size_t>(i)]);
           }
 
         } else {
 #ifdef SCI_NONCONSTEXPR
-          fmt::print("Syntax error:\nToken:{}\nSymbol:{}\n", magic_enum::enum_name(ts.t), magic_enum::enum_name(ts.s));
+          spdlog::error("Syntax error: token {}, symbol {}", magic_enum::enum_name(ts.t), magic_enum::enum_name(ts.s));
 #endif
           return {};
         }
       }
     }
+    if (program.overflowed()) {
 #ifdef SCI_NONCONSTEXPR
-    fmt::print("finished syntax analysis\n");
+      spdlog::error("Function longer than {} instructions", CompiledFunction::NUM_OF_INS);
+#endif
+      return {};
+    }
+#ifdef SCI_NONCONSTEXPR
+    if (!std::is_constant_evaluated()) {
+      spdlog::debug("finished syntax analysis");
+    }
 #endif
+    auto const bounds = stack_bounds(resulting_program);
+    for (int i{ 0 }; i < CompiledProgram::NUM_OF_FUNC; ++i) {
+      resulting_program.functions[static_cast<std::size_t>(i)].max_comp_depth = bounds.max_depth[static_cast<std::size_t>(i)];
+    }
+    resulting_program.info = { Result::OK, tok_index + 1, max_stack_size, bounds.func_stack, bounds.comp_stack, bounds.memory };
     return resulting_program;
   }
+
+private:
+  struct Operator
+  {
+    Instruction::Type type;
+    int precedence;// -1 marks an open parenthesis
+    int length;// in tokens
+  };
+
+  // lookahead never reads past the last token
+  constexpr auto token_at(std::size_t const tok_index) const noexcept -> Token const&
+  {
+    return tokens_[std::min(tok_index, MaxTokens - 1)];
+  }
+
+  constexpr auto binary_operator(std::size_t const tok_index) const noexcept -> Operator
+  {
+    auto const type = token_at(tok_index).type;
+    auto const next = token_at(tok_index + 1).type;
+    bool const equal_follows{ next == Token::Type::EQUAL };
+    // `x op= e`, `x++` and `x--` end the expression, see compile_expr_statement
+    bool const arithmetic{ type == Token::Type::STAR || type == Token::Type::SLASH || type == Token::Type::PERCENT
+                           || type == Token::Type::PLUS || type == Token::Type::MINUS };
+    bool const step{ (type == Token::Type::PLUS || type == Token::Type::MINUS) && next == type
+                     && (token_at(tok_index + 2).type == Token::Type::SEMICOLON || token_at(tok_index + 2).type == Token::Type::CLOSE_PAR) };
+    if ((arithmetic && equal_follows) || step) {
+      return { Instruction::Type::NONE, 0, 0 };
+    }
+    switch (type) {
+    case Token::Type::STAR:
+      return { Instruction::Type::MUL, 4, 1 };
+    case Token::Type::SLASH:
+      return { Instruction::Type::DIV, 4, 1 };
+    case Token::Type::PERCENT:
+      return { Instruction::Type::MOD, 4, 1 };
+    case Token::Type::PLUS:
+      return { Instruction::Type::ADD, 3, 1 };
+    case Token::Type::MINUS:
+      return { Instruction::Type::SUB, 3, 1 };
+    case Token::Type::LEFT:
+      return equal_follows ? Operator{ Instruction::Type::LE, 2, 2 } : Operator{ Instruction::Type::LT, 2, 1 };
+    case Token::Type::RIGHT:
+      return equal_follows ? Operator{ Instruction::Type::GE, 2, 2 } : Operator{ Instruction::Type::GT, 2, 1 };
+    case Token::Type::EQUAL:
+      return equal_follows ? Operator{ Instruction::Type::EQ, 1, 2 } : Operator{ Instruction::Type::NONE, 0, 0 };
+    case Token::Type::EXCLAMATION:
+      return equal_follows ? Operator{ Instruction::Type::NE, 1, 2 } : Operator{ Instruction::Type::NONE, 0, 0 };
+    default:
+      return { Instruction::Type::NONE, 0, 0 };
+    }
+  }
+
+  // Value type of a declared variable, NONE_ for void and for auto, which takes the
+  // type of its initializer
+  static constexpr auto declared_type(Token::TKW const type) noexcept -> Literal::Type
+  {
+    switch (type) {
+    case Token::TKW::CHAR_:
+      return Literal::Type::CHAR_;
+    case Token::TKW::DOUBLE_:
+      return Literal::Type::DOUBLE_;
+    case Token::TKW::INT_:
+      return Literal::Type::INT_;
+    default:
+      return Literal::Type::NONE_;
+    }
+  }
+
+  static constexpr auto is_arithmetic(Literal::Type const type) noexcept -> bool
+  {
+    return type == Literal::Type::INT_ || type == Literal::Type::CHAR_ || type == Literal::Type::DOUBLE_;
+  }
+
+  static constexpr auto is_integral(Literal::Type const type) noexcept -> bool
+  {
+    return type == Literal::Type::INT_ || type == Literal::Type::CHAR_;
+  }
+
+  static constexpr auto is_pointer(Literal::Type const type) noexcept -> bool
+  {
+    return type == Literal::Type::INT_PTR_ || type == Literal::Type::CHAR_PTR_ || type == Literal::Type::DOUBLE_PTR_;
+  }
+
+  // NONE_ for types without pointers
+  static constexpr auto pointer_to(Literal::Type const type) noexcept -> Literal::Type
+  {
+    switch (type) {
+    case Literal::Type::INT_:
+      return Literal::Type::INT_PTR_;
+    case Literal::Type::CHAR_:
+      return Literal::Type::CHAR_PTR_;
+    case Literal::Type::DOUBLE_:
+      return Literal::Type::DOUBLE_PTR_;
+    default:
+      return Literal::Type::NONE_;
+    }
+  }
+
+  static constexpr auto pointee(Literal::Type const type) noexcept -> Literal::Type
+  {
+    switch (type) {
+    case Literal::Type::INT_PTR_:
+      return Literal::Type::INT_;
+    case Literal::Type::CHAR_PTR_:
+      return Literal::Type::CHAR_;
+    case Literal::Type::DOUBLE_PTR_:
+      return Literal::Type::DOUBLE_;
+    default:
+      return Literal::Type::NONE_;
+    }
+  }
+
+  static constexpr auto zero(Literal::Type const type) noexcept -> Instruction
+  {
+    if (type == Literal::Type::DOUBLE_) {
+      return { Instruction::Type::VAL, { .d = 0.0 }, type };
+    }
+    return { Instruction::Type::VAL, {}, type };
+  }
+
+  static constexpr auto double_operator(Instruction::Type const type) noexcept -> Instruction::Type
+  {
+    switch (type) {
+    case Instruction::Type::ADD:
+      return Instruction::Type::DADD;
+    case Instruction::Type::SUB:
+      return Instruction::Type::DSUB;
+    case Instruction::Type::MUL:
+      return Instruction::Type::DMUL;
+    case Instruction::Type::DIV:
+      return Instruction::Type::DDIV;
+    case Instruction::Type::LT:
+      return Instruction::Type::DLT;
+    case Instruction::Type::LE:
+      return Instruction::Type::DLE;
+    case Instruction::Type::GT:
+      return Instruction::Type::DGT;
+    case Instruction::Type::GE:
+      return Instruction::Type::DGE;
+    case Instruction::Type::EQ:
+      return Instruction::Type::DEQ;
+    case Instruction::Type::NE:
+      return Instruction::Type::DNE;
+    default:
+      return Instruction::Type::NONE;
+    }
+  }
+
+  // Implicit conversion of the value on top of the comp_stack, false where C has none
+  static constexpr auto emit_conversion(CompilingFunction& func, Literal::Type const from, Literal::Type const to) -> bool
+  {
+    if (from == to) {
+      return true;
+    }
+    if (!is_arithmetic(from) || !is_arithmetic(to)) {
+      return false;
+    }
+    if (to == Literal::Type::DOUBLE_) {
+      func.add_instruction({ Instruction::Type::I2D, {} });
+      return true;
+    }
+    if (from == Literal::Type::DOUBLE_) {
+      func.add_instruction({ Instruction::Type::D2I, {} });
+    }
+    if (to == Literal::Type::CHAR_) {
+      func.add_instruction({ Instruction::Type::I2C, {} });
+    }
+    return true;
+  }
+
+  // Leaves an int that is not 0 where a condition of `type` holds
+  static constexpr auto emit_condition(CompilingFunction& func, Literal::Type const type) -> bool
+  {
+    if (type == Literal::Type::DOUBLE_) {
+      func.add_instruction(zero(type));
+      func.add_instruction({ Instruction::Type::DNE, {} });
+    }
+    return is_arithmetic(type);
+  }
+
+  // Binary `op` with the usual arithmetic conversions: chars are promoted to int and
+  // an int operand next to a double becomes a double. Every element takes one Value
+  // of VM memory, so pointer arithmetic is plain int arithmetic. Returns the result
+  // type, NONE_ for operands the operator does not take.
+  static constexpr auto emit_binary(CompilingFunction& func, Instruction::Type const op, Literal::Type const lhs, Literal::Type const rhs) -> Literal::Type
+  {
+    bool const comparison{ op >= Instruction::Type::LT && op <= Instruction::Type::NE };
+    if (is_pointer(lhs) || is_pointer(rhs)) {
+      auto result = Literal::Type::NONE_;
+      if (is_pointer(lhs) && is_integral(rhs) && (op == Instruction::Type::ADD || op == Instruction::Type::SUB)) {
+        result = lhs;
+      } else if (is_integral(lhs) && is_pointer(rhs) && op == Instruction::Type::ADD) {
+        result = rhs;
+      } else if (lhs == rhs && (op == Instruction::Type::SUB || comparison)) {
+        result = Literal::Type::INT_;
+      }
+      if (result != Literal::Type::NONE_) {
+        func.add_instruction({ op, {} });
+      }
+      return result;
+    }
+    if (!is_arithmetic(lhs) || !is_arithmetic(rhs)) {
+      return Literal::Type::NONE_;
+    }
+    if (lhs != Literal::Type::DOUBLE_ && rhs != Literal::Type::DOUBLE_) {
+      func.add_instruction({ op, {} });
+      return Literal::Type::INT_;
+    }
+    auto const double_op = double_operator(op);
+    if (double_op == Instruction::Type::NONE) {
+      return Literal::Type::NONE_;
+    }
+    if (rhs != Literal::Type::DOUBLE_) {
+      func.add_instruction({ Instruction::Type::I2D, {} });
+    }
+    if (lhs != Literal::Type::DOUBLE_) {
+      func.add_instruction({ Instruction::Type::I2D_UNDER, {} });
+    }
+    func.add_instruction({ double_op, {} });
+    return comparison ? Literal::Type::INT_ : Literal::Type::DOUBLE_;
+  }
+
+  // Shunting-yard over expressions of literals, locals, calls of script functions
+  // without arguments, calls of builtins and host functions, parentheses, unary minus,
+  // `*` and `&`, indexing and the binary operators in C precedence. Stops before the
+  // first token that cannot continue the expression (`;`, `=`, an unmatched `)`, ...).
+  // The operand types are tracked alongside, so every instruction is emitted for the
+  // types it works on and `type` receives the type of the result. An empty expression
+  // emits nothing, succeeds and has type NONE_, like a call of a void function.
+  constexpr auto compile_expression(std::size_t& tok_index, CompilingFunction& func, CompilingProgram& program, Literal::Type& type) const noexcept -> bool
+  {
+    constexpr int NEG_PRECEDENCE{ 5 };
+    ConstexprStack<Operator, MaxStackSize> operators;
+    ConstexprStack<Literal::Type, MaxStackSize> types;
+    std::size_t const start{ tok_index };
+    int open_pars{ 0 };
+
+    auto const pop_operator = [&operators, &types, &func]() -> bool {
+      auto const op = operators.top().type;
+      operators.pop();
+      auto const rhs = types.top();
+      switch (op) {
+      case Instruction::Type::NEG:
+        if (!is_arithmetic(rhs)) {
+          return false;
+        }
+        func.add_instruction({ rhs == Literal::Type::DOUBLE_ ? Instruction::Type::DNEG : Instruction::Type::NEG, {} });
+        types.top() = rhs == Literal::Type::DOUBLE_ ? rhs : Literal::Type::INT_;
+        return true;
+
+      case Instruction::Type::LOAD_IND:
+        if (!is_pointer(rhs)) {
+          return false;
+        }
+        func.add_instruction({ op, {} });
+        types.top() = pointee(rhs);
+        return true;
+
+      // the operand has to be an lvalue, the load that ends its code gives way to its address
+      case Instruction::Type::ADDR: {
+        auto const load = func.pop_instruction();
+        if ((load.type != Instruction::Type::LOAD && load.type != Instruction::Type::LOAD_IND) || !is_arithmetic(rhs)) {
+          return false;
+        }
+        if (load.type == Instruction::Type::LOAD) {
+          func.add_instruction({ Instruction::Type::ADDR, load.par });
+        }
+        types.top() = pointer_to(rhs);
+        return true;
+      }
+
+      default:
+        break;
+      }
+      types.pop();
+      auto const result = emit_binary(func, op, types.top(), rhs);
+      types.top() = result;
+      return result != Literal::Type::NONE_;
+    };
+
+    bool expect_operand{ true };
+    while (true) {
+      Token const& tok = token_at(tok_index);
+      if (expect_operand) {
+        switch (tok.type) {
+        case Token::Type::LITERAL: {
+          auto const& literal = std::get<Literal>(tok.val);
+          Value value{};
+          switch (literal.type) {
+          case Literal::Type::STRING_:
+            value.i = program.strings().intern(std::get<std::string_view>(literal.val), Tokenizer<MaxTokens>::unescape);
+            if (value.i == -1) {
+              return false;
+            }
+            break;
+          case Literal::Type::CHAR_:
+            value.i = std::get<char>(literal.val);
+            break;
+          case Literal::Type::DOUBLE_:
+            value.d = std::get<double>(literal.val);
+            break;
+          default:
+            value.i = std::get<int>(literal.val);
+            break;
+          }
+          func.add_instruction({ Instruction::Type::VAL, value, literal.type });
+          if (!types.try_push(literal.type)) {
+            return false;
+          }
+          expect_operand = false;
+          break;
+        }
+
+        case Token::Type::ID: {
+          std::string_view const id = std::get<std::string_view>(tok.val);
+          Literal::Type operand_type{ Literal::Type::NONE_ };
+          if (token_at(tok_index + 1).type == Token::Type::OPEN_PAR) {
+            int const callee{ program.get_func_ptr(id) };
+            if (callee == -1) {
+              bool const ok{ builtin(id) != Instruction::Type::NONE
+                               ? compile_builtin_call(tok_index, func, program, operand_type)
+                               : compile_native_call(tok_index, func, program, operand_type) };
+              if (!ok) {
+                return false;
+              }
+            } else {
+              if (token_at(tok_index + 2).type != Token::Type::CLOSE_PAR) {
+                return false;
+              }
+              func.add_instruction({ Instruction::Type::CALL, { callee } });
+              operand_type = program.return_type(callee);
+              tok_index += 2;
+            }
+
+          } else {
+            int const index{ func.find_local(id) };
+            if (index == -1) {
+              return false;
+            }
+            // arrays decay to the address of their first element
+            auto const& local = func.local(index);
+            func.add_instruction({ local.size != 0 ? Instruction::Type::ADDR : Instruction::Type::LOAD, { local.offset } });
+            operand_type = local.type;
+          }
+          if (!types.try_push(operand_type)) {
+            return false;
+          }
+          expect_operand = false;
+          break;
+        }
+
+        case Token::Type::OPEN_PAR:
+          if (!operators.try_push({ Instruction::Type::NONE, -1, 1 })) {
+            return false;
+          }
+          ++open_pars;
+          break;
+
+        case Token::Type::MINUS:
+          if (!operators.try_push({ Instruction::Type::NEG, NEG_PRECEDENCE, 1 })) {
+            return false;
+          }
+          break;
+
+        case Token::Type::STAR:
+          if (!operators.try_push({ Instruction::Type::LOAD_IND, NEG_PRECEDENCE, 1 })) {
+            return false;
+          }
+          break;
+
+        case Token::Type::AMPERSAND:
+          if (!operators.try_push({ Instruction::Type::ADDR, NEG_PRECEDENCE, 1 })) {
+            return false;
+          }
+          break;
+
+        case Token::Type::PLUS:
+          break;
+
+        default:
+          // nothing at all is an empty expression, anything else misses an operand
+          type = Literal::Type::NONE_;
+          return tok_index == start;
+        }
+        ++tok_index;
+        continue;
+      }
+
+      // p[i] is *(p + i), it binds tighter than the pending unary operators
+      if (tok.type == Token::Type::OPEN_BRACKET) {
+        auto const pointer = types.top();
+        int const index_start{ func.next_index() };
+        Literal::Type index{ Literal::Type::NONE_ };
+        ++tok_index;
+        if (!is_pointer(pointer) || !compile_expression(tok_index, func, program, index) || func.next_index() == index_start
+            || !is_integral(index) || token_at(tok_index).type != Token::Type::CLOSE_BRACKET) {
+          return false;
+        }
+        ++tok_index;
+        func.add_instruction({ Instruction::Type::ADD, {} });
+        func.add_instruction({ Instruction::Type::LOAD_IND, {} });
+        types.top() = pointee(pointer);
+        continue;
+      }
+
+      if (tok.type == Token::Type::CLOSE_PAR && open_pars > 0) {
+        while (operators.top().precedence != -1) {
+          if (!pop_operator()) {
+            return false;
+          }
+        }
+        operators.pop();
+        --open_pars;
+        ++tok_index;
+        continue;
+      }
+
+      auto const op = binary_operator(tok_index);
+      if (op.type == Instruction::Type::NONE) {
+        break;
+      }
+      // all binary operators are left associative
+      while (!operators.empty() && operators.top().precedence >= op.precedence) {
+        if (!pop_operator()) {
+          return false;
+        }
+      }
+      if (!operators.try_push(op)) {
+        return false;
+      }
+      tok_index += static_cast<std::size_t>(op.length);
+      expect_operand = true;
+    }
+
+    if (open_pars != 0) {
+      return false;
+    }
+    while (!operators.empty()) {
+      if (!pop_operator()) {
+        return false;
+      }
+    }
+    type = types.top();
+    return true;
+  }
+
+  // one argument of a call, after a comma unless it is the first
+  constexpr auto compile_argument(std::size_t& tok_index, CompilingFunction& func, CompilingProgram& program, bool const first, Literal::Type& type) const noexcept -> bool
+  {
+    if (!first) {
+      if (token_at(tok_index).type != Token::Type::COMMA) {
+        return false;
+      }
+      ++tok_index;
+    }
+    int const start{ func.next_index() };
+    return compile_expression(tok_index, func, program, type) && func.next_index() != start;
+  }
+
+  // `name(args)` of a registered host function, starting at `name` and leaving tok_index
+  // at the closing parenthesis. Every argument is converted to its parameter type.
+  constexpr auto compile_native_call(std::size_t& tok_index, CompilingFunction& func, CompilingProgram& program, Literal::Type& type) const noexcept -> bool
+  {
+    auto const id = std::get<std::string_view>(token_at(tok_index).val);
+    auto const it = std::find_if(natives_.begin(), natives_.end(), [&id](auto const& n) { return n.name == id; });
+    if (it == natives_.end()) {
+      return false;
+    }
+    int const index{ program.add_native(*it) };
+    if (index == -1) {
+      return false;
+    }
+    tok_index += 2;
+    for (int param{ 0 }; param < it->arity; ++param) {
+      Literal::Type arg{ Literal::Type::NONE_ };
+      if (!compile_argument(tok_index, func, program, param == 0, arg) || !emit_conversion(func, arg, it->params[static_cast<std::size_t>(param)])) {
+        return false;
+      }
+    }
+    if (token_at(tok_index).type != Token::Type::CLOSE_PAR) {
+      return false;
+    }
+    func.add_instruction({ Instruction::Type::CALL_NATIVE, { index } });
+    type = it->return_type;
+    return true;
+  }
+
+  // Instruction of the builtin `name`, NONE for other names
+  static constexpr auto builtin(std::string_view const name) noexcept -> Instruction::Type
+  {
+    if (name == "__sum") {
+      return Instruction::Type::SUM;
+    }
+    if (name == "__dot") {
+      return Instruction::Type::DOT;
+    }
+    if (name == "__memset") {
+      return Instruction::Type::FILL;
+    }
+    if (name == "__memcpy") {
+      return Instruction::Type::COPY;
+    }
+    return Instruction::Type::NONE;
+  }
+
+  // Builtins over the n elements behind pointers of the same type, see Kernels.h:
+  //   T __sum(T* p, int n), T __dot(T* p, T* q, int n) for int and double, char sums to int
+  //   void __memset(T* p, T value, int n), void __memcpy(T* dst, T* src, int n)
+  // Starts at the name and leaves tok_index at the closing parenthesis.
+  constexpr auto compile_builtin_call(std::size_t& tok_index, CompilingFunction& func, CompilingProgram& program, Literal::Type& type) const noexcept -> bool
+  {
+    auto const op = builtin(std::get<std::string_view>(token_at(tok_index).val));
+    int const arity{ op == Instruction::Type::SUM ? 2 : 3 };
+    Literal::Type pointer{ Literal::Type::NONE_ };
+    tok_index += 2;
+    for (int param{ 0 }; param < arity; ++param) {
+      Literal::Type arg{ Literal::Type::NONE_ };
+      if (!compile_argument(tok_index, func, program, param == 0, arg)) {
+        return false;
+      }
+      bool valid{ arg == pointer };
+      if (param == 0) {
+        valid = is_pointer(arg);
+        pointer = arg;
+      } else if (param == arity - 1) {
+        valid = is_integral(arg);
+      } else if (op == Instruction::Type::FILL) {
+        valid = emit_conversion(func, arg, pointee(pointer));
+      }
+      if (!valid) {
+        return false;
+      }
+    }
+    if (token_at(tok_index).type != Token::Type::CLOSE_PAR) {
+      return false;
+    }
+    bool const doubles{ pointer == Literal::Type::DOUBLE_PTR_ };
+    switch (op) {
+    case Instruction::Type::SUM:
+      func.add_instruction({ doubles ? Instruction::Type::DSUM : op, {} });
+      type = doubles ? Literal::Type::DOUBLE_ : Literal::Type::INT_;
+      break;
+    case Instruction::Type::DOT:
+      func.add_instruction({ doubles ? Instruction::Type::DDOT : op, {} });
+      type = doubles ? Literal::Type::DOUBLE_ : Literal::Type::INT_;
+      break;
+    default:
+      func.add_instruction({ op, {} });
+      type = Literal::Type::NONE_;
+      break;
+    }
+    return true;
+  }
+
+  // Statement starting with an identifier or `*`: `lvalue = e`, `lvalue op= e`,
+  // `lvalue++`, `lvalue--` or an expression whose value is discarded. Lvalues are
+  // locals and dereferences, the load that ends their code becomes the store.
+  constexpr auto compile_expr_statement(std::size_t& tok_index, CompilingFunction& func, CompilingProgram& program) const noexcept -> bool
+  {
+    int const start{ func.next_index() };
+    Literal::Type type{ Literal::Type::NONE_ };
+    if (!compile_expression(tok_index, func, program, type) || func.next_index() == start) {
+      return false;
+    }
+
+    auto const type_at = [this, &tok_index](std::size_t const offset) {
+      return token_at(tok_index + offset).type;
+    };
+    auto const compound = [&type_at]() -> Instruction::Type {
+      switch (type_at(0)) {
+      case Token::Type::PLUS:
+        return Instruction::Type::ADD;
+      case Token::Type::MINUS:
+        return Instruction::Type::SUB;
+      case Token::Type::STAR:
+        return Instruction::Type::MUL;
+      case Token::Type::SLASH:
+        return Instruction::Type::DIV;
+      case Token::Type::PERCENT:
+        return Instruction::Type::MOD;
+      default:
+        return Instruction::Type::NONE;
+      }
+    }();
+    bool const assign{ type_at(0) == Token::Type::EQUAL && type_at(1) != Token::Type::EQUAL };
+    bool const update{ compound != Instruction::Type::NONE && type_at(1) == Token::Type::EQUAL };
+    bool const step{ (type_at(0) == Token::Type::PLUS || type_at(0) == Token::Type::MINUS) && type_at(1) == type_at(0) };
+
+    if (!assign && !update && !step) {
+      if (type != Literal::Type::NONE_) {// void calls leave nothing
+        func.add_instruction({ Instruction::Type::POP, {} });
+      }
+      return true;
+    }
+
+    auto const load = func.pop_instruction();
+    if ((load.type != Instruction::Type::LOAD && load.type != Instruction::Type::LOAD_IND) || type == Literal::Type::NONE_) {
+      return false;
+    }
+    bool const indirect{ load.type == Instruction::Type::LOAD_IND };
+    if (!assign) {
+      if (indirect) {// the address is needed for the load and the store
+        func.add_instruction({ Instruction::Type::DUP, {} });
+      }
+      func.add_instruction(load);
+    }
+    tok_index += assign ? 1 : 2;
+    Literal::Type value_type{ Literal::Type::INT_ };
+    if (step) {
+      func.add_instruction({ Instruction::Type::VAL, { 1 } });
+    } else {
+      int const value_start{ func.next_index() };
+      if (!compile_expression(tok_index, func, program, value_type) || func.next_index() == value_start) {
+        return false;
+      }
+    }
+    if (!assign) {
+      value_type = emit_binary(func, compound, type, value_type);
+    }
+    if (!emit_conversion(func, value_type, type)) {
+      return false;
+    }
+    func.add_instruction({ indirect ? Instruction::Type::STORE_IND : Instruction::Type::STORE, load.par });
+    return true;
+  }
 };
 
 }// namespace sci
\ No newline at end of file
@@ -0,0 +1,98 @@
+#pragma once
+#include <array>
+#include <map>
+#include <ostream>
+#include <vector>
+
+#include "CompiledProgram.h"
+#include "ExecutionHooks.h"
+
+namespace sci {
+
+// Sampling profiler for interpreted scripts, pass it to Interpreter::interpret as hooks.
+// Every `period` instructions it records the function and instruction offset on top of
+// func_stack together with the whole call stack.
+class SamplingProfiler : public ExecutionHooks
+{
+public:
+  using FunctionCounters = std::array<std::size_t, CompiledProgram::NUM_OF_FUNC>;
+  using InstructionCounters = std::array<std::array<std::size_t, CompiledFunction::NUM_OF_INS>, CompiledProgram::NUM_OF_FUNC>;
+
+private:
+  CompiledProgram const& program_;
+  std::size_t period_;
+  std::size_t countdown_;
+  std::size_t samples_{ 0 };
+  FunctionCounters func_samples_{};
+  InstructionCounters ins_samples_{};
+  std::map<std::vector<int>, std::size_t> stacks_;
+
+public:
+  explicit SamplingProfiler(CompiledProgram const& program, std::size_t const period = 1) noexcept
+    : program_{ program }, period_{ period > 0 ? period : 1 }, countdown_{ period_ }
+  {}
+
+  template<typename FuncStack, typename CompStack>
+  auto on_instruction(FuncStack const& func_stack, CompStack const& /*comp_stack*/) -> void
+  {
+    if (--countdown_ != 0) {
+      return;
+    }
+    countdown_ = period_;
+    sample(func_stack);
+  }
+
+  [[nodiscard]] auto samples() const noexcept { return samples_; }
+  [[nodiscard]] auto function_samples() const noexcept -> FunctionCounters const& { return func_samples_; }
+  [[nodiscard]] auto instruction_samples() const noexcept -> InstructionCounters const& { return ins_samples_; }
+
+  // Writes one line per distinct call stack in the collapsed format used by flamegraph.pl:
+  // "main;f;ahoj 12"
+  auto write_collapsed(std::ostream& out) const -> void
+  {
+    for (auto const& [stack, count] : stacks_) {
+      bool first{ true };
+      for (int const func_index : stack) {
+        if (!first) {
+          out << ';';
+        }
+        first = false;
+        out << function_name(func_index);
+      }
+      out << ' ' << count << '\n';
+    }
+  }
+
+private:
+  template<typename FuncStack>
+  auto sample(FuncStack const& func_stack) -> void
+  {
+    if (func_stack.empty()) {
+      return;
+    }
+    auto const& frame = func_stack.top();
+    auto const func = static_cast<std::size_t>(frame.func_index);
+    auto const offset = frame.next_ins_ptr - program_.functions[func].instructions.data();
+
+    ++samples_;
+    ++func_samples_[func];
+    if (offset >= 0 && offset < CompiledFunction::NUM_OF_INS) {
+      ++ins_samples_[func][static_cast<std::size_t>(offset)];
+    }
+
+    std::vector<int> stack;
+    stack.reserve(func_stack.size());
+    for (std::size_t i{ 0 }; i < func_stack.size(); ++i) {
+      stack.push_back(func_stack.data()[i].func_index);
+    }
+    ++stacks_[stack];
+  }
+
+  [[nodiscard]] auto function_name(int const func_index) const -> std::string_view
+  {
+    auto const name = program_.functions[static_cast<std::size_t>(func_index)].name;
+    return name.empty() ? std::string_view{ "?" } : name;
+  }
+};
+
+}// namespace sci
@@ -0,0 +1,263 @@
+#pragma once
+#include <algorithm>
+#include <condition_variable>
+#include <coroutine>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <optional>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "Budget.h"
+#include "CompiledProgram.h"
+#include "Common.h"
+#include "Interpreter.h"
+
+namespace sci {
+
+// Coroutine handle of a script run that gives the thread back between slices of
+// instructions and while it waits for an async host function. It starts suspended,
+// every step() runs one slice.
+class ScriptTask
+{
+public:
+  struct promise_type
+  {
+    ExecResult result{ Result::SUSPENDED, {}, 0 };
+    NativeFunction const* to_start{ nullptr };// async host call start_waiting() makes
+    Value const* args{ nullptr };// its arguments, in the coroutine frame
+    bool waiting{ false };// until deliver()
+    Value delivered{};
+
+    auto get_return_object() noexcept -> ScriptTask
+    {
+      return ScriptTask{ std::coroutine_handle<promise_type>::from_promise(*this) };
+    }
+    static auto initial_suspend() noexcept -> std::suspend_always { return {}; }
+    static auto final_suspend() noexcept -> std::suspend_always { return {}; }
+    auto return_value(ExecResult const& value) noexcept -> void { result = value; }
+    static auto unhandled_exception() noexcept -> void { std::terminate(); }
+  };
+
+  ScriptTask(ScriptTask&& other) noexcept : handle{ std::exchange(other.handle, {}) } {}
+  auto operator=(ScriptTask&& other) noexcept -> ScriptTask&
+  {
+    if (this != &other) {
+      destroy();
+      handle = std::exchange(other.handle, {});
+    }
+    return *this;
+  }
+  ScriptTask(ScriptTask const&) = delete;
+  auto operator=(ScriptTask const&) -> ScriptTask& = delete;
+  ~ScriptTask() { destroy(); }
+
+  [[nodiscard]] auto done() const noexcept -> bool { return !handle || handle.done(); }
+
+  // Runs the next slice, false once the script has finished. A waiting script does not run.
+  auto step() -> bool
+  {
+    if (!done() && !waiting()) {
+      handle.resume();
+    }
+    return !done();
+  }
+
+  // Stopped at an async host call, the result has not been delivered yet
+  [[nodiscard]] auto waiting() const noexcept -> bool { return handle && handle.promise().waiting; }
+
+  // Starts the async host call the script stopped at, its Completion resolves to `done`
+  auto start_waiting(AsyncCall const done) -> void
+  {
+    if (waiting() && handle.promise().to_start != nullptr) {
+      std::exchange(handle.promise().to_start, nullptr)->start(handle.promise().args, done);
+    }
+  }
+
+  // Result of the async host call, the next step() continues the script with it
+  auto deliver(Value const value) noexcept -> void
+  {
+    if (waiting()) {
+      handle.promise().delivered = value;
+      handle.promise().waiting = false;
+    }
+  }
+
+  // Result::SUSPENDED until the script has finished
+  [[nodiscard]] auto result() const noexcept -> ExecResult
+  {
+    return handle ? handle.promise().result : ExecResult{ Result::ERR, {}, 0 };
+  }
+
+private:
+  explicit ScriptTask(std::coroutine_handle<promise_type> const h) noexcept : handle{ h } {}
+
+  auto destroy() noexcept -> void
+  {
+    if (handle) {
+      handle.destroy();
+    }
+  }
+
+  std::coroutine_handle<promise_type> handle;
+};
+
+namespace detail {
+  // Suspends a run_in_slices coroutine at an async host call until ScriptTask::deliver
+  struct AwaitNative
+  {
+    NativeFunction const* native;
+    Value const* args;
+    ScriptTask::promise_type* promise{ nullptr };
+
+    static auto await_ready() noexcept -> bool { return false; }
+    auto await_suspend(std::coroutine_handle<ScriptTask::promise_type> const h) noexcept -> void
+    {
+      promise = &h.promise();
+      promise->to_start = native;
+      promise->args = args;
+      promise->waiting = true;
+    }
+    [[nodiscard]] auto await_resume() const noexcept -> Value { return promise->delivered; }
+  };
+}// namespace detail
+
+// Runs `program` on `interpreter` in slices of at most `slice` instructions. The
+// ExecutionContext lives in the coroutine frame, so a suspended script costs one heap
+// allocation and the program has to outlive the task.
+template<typename Interp>
+auto run_in_slices(Interp const interpreter, CompiledProgram const& program, std::uint64_t const slice) -> ScriptTask
+{
+  typename Interp::Context context;
+  if (auto const r = interpreter.start(program, context); r != Result::OK) {
+    co_return ExecResult{ r, {}, 0, context.stats };
+  }
+  while (true) {
+    InstructionBudget budget{ std::max<std::uint64_t>(slice, 1) };
+    auto const result = interpreter.resume(context, budget);
+    if (result.r == Result::WAITING) {
+      interpreter.complete(context, co_await detail::AwaitNative{ &program.natives[static_cast<std::size_t>(context.waiting_native)], context.native_args.data() });
+      continue;
+    }
+    if (result.r != Result::SUSPENDED) {
+      co_return ExecResult{ result.r, result.value, result.func_index, context.stats };
+    }
+    co_await std::suspend_always{};
+  }
+}
+
+// Round robin over scripts on the calling thread: each run_once() gives the task in
+// front one slice and puts it back at the end, so a long script cannot starve the others.
+// A script calling an async host function is parked until the function's Completion is
+// resolved, which may happen on any thread, and then queued again. Waiting scripts cost
+// their coroutine frame, no thread.
+class Scheduler
+{
+public:
+  Scheduler() = default;
+  Scheduler(Scheduler const&) = delete;
+  auto operator=(Scheduler const&) -> Scheduler& = delete;
+
+  // Queues `task`, its result is available under the returned id once it finished
+  auto spawn(ScriptTask task) -> std::size_t
+  {
+    results.emplace_back();
+    queue.push_back({ results.size() - 1, std::move(task) });
+    return results.size() - 1;
+  }
+
+  // Runs one slice, false if no script is ready to run
+  auto run_once() -> bool
+  {
+    wake_completed();
+    if (queue.empty()) {
+      return false;
+    }
+    auto entry = std::move(queue.front());
+    queue.pop_front();
+    if (!entry.task.step()) {
+      results[entry.id] = entry.task.result();
+    } else if (entry.task.waiting()) {
+      // parked first, the host function may resolve before start_waiting returns
+      auto& task = parked.emplace(entry.id, std::move(entry.task)).first->second;
+      task.start_waiting({ &Scheduler::deliver, this, entry.id });
+    } else {
+      queue.push_back(std::move(entry));
+    }
+    return true;
+  }
+
+  // Runs until every script finished, sleeps while all of them wait for host functions
+  auto run() -> void
+  {
+    while (true) {
+      if (run_once()) {
+        continue;
+      }
+      if (parked.empty()) {
+        return;
+      }
+      std::unique_lock lock{ mutex };
+      woken.wait(lock, [this] { return !completed.empty(); });
+    }
+  }
+
+  // Scripts that have not finished, waiting ones included
+  [[nodiscard]] auto pending() const noexcept -> std::size_t { return queue.size() + parked.size(); }
+
+  [[nodiscard]] auto waiting() const noexcept -> std::size_t { return parked.size(); }
+
+  // Empty while the script is still running
+  [[nodiscard]] auto result(std::size_t const id) const -> std::optional<ExecResult>
+  {
+    return id < results.size() ? results[id] : std::nullopt;
+  }
+
+private:
+  struct Entry
+  {
+    std::size_t id;
+    ScriptTask task;
+  };
+
+  // AsyncCall::deliver of the host calls, called from any thread
+  static auto deliver(void* const target, std::size_t const id, Value const value) -> void
+  {
+    auto& scheduler = *static_cast<Scheduler*>(target);
+    std::lock_guard const lock{ scheduler.mutex };
+    scheduler.completed.emplace_back(id, value);
+    scheduler.woken.notify_one();
+  }
+
+  // queues the parked scripts whose host calls completed
+  auto wake_completed() -> void
+  {
+    std::vector<std::pair<std::size_t, Value>> ready;
+    {
+      std::lock_guard const lock{ mutex };
+      ready.swap(completed);
+    }
+    for (auto const& [id, value] : ready) {
+      auto const it = parked.find(id);
+      if (it == parked.end()) {
+        continue;
+      }
+      it->second.deliver(value);
+      queue.push_back({ id, std::move(it->second) });
+      parked.erase(it);
+    }
+  }
+
+  std::deque<Entry> queue;
+  std::unordered_map<std::size_t, ScriptTask> parked;
+  std::vector<std::optional<ExecResult>> results;
+
+  std::mutex mutex;// guards completed
+  std::condition_variable woken;
+  std::vector<std::pair<std::size_t, Value>> completed;
+};
+
+}// namespace sci
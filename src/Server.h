@@ -0,0 +1,360 @@
+#pragma once
+#include <array>
+#include <bit>
+#include <charconv>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "CompiledProgram.h"
+#include "Common.h"
+#include "Interpreter.h"
+#include "Native.h"
+#include "Optimizer.h"
+#include "Parser.h"
+#include "Snapshot.h"
+#include "SourceCode.h"
+#include "Tokenizer.h"
+
+namespace sci {
+
+// Pieces of sci-server and sci-daemon that do not touch sockets, threads or processes
+
+namespace server {
+  constexpr std::size_t MAX_TOKENS{ 4096 };
+  using Interpreter = sci::Interpreter<64, 4096, 256>;
+
+  // `request()` in a script waits for the argument of the request it serves
+  inline auto request_argument(Completion<int> const /*done*/) -> void
+  {}
+
+  inline constexpr std::array natives{ async_native<request_argument>("request") };
+
+  // One request line: `<script> [<int argument>]`
+  struct Request
+  {
+    std::string_view script;
+    int argument{ 0 };
+  };
+
+  inline auto parse_request(std::string_view line) -> std::optional<Request>
+  {
+    auto const next_word = [&line] {
+      auto const begin = line.find_first_not_of(" \t\r");
+      if (begin == std::string_view::npos) {
+        line = {};
+        return std::string_view{};
+      }
+      line.remove_prefix(begin);
+      auto const word = line.substr(0, line.find_first_of(" \t\r"));
+      line.remove_prefix(word.size());
+      return word;
+    };
+    Request request{ next_word() };
+    if (request.script.empty()) {
+      return std::nullopt;
+    }
+    if (auto const argument = next_word(); !argument.empty()) {
+      auto const [end, error] = std::from_chars(argument.data(), argument.data() + argument.size(), request.argument);
+      if (error != std::errc{} || end != argument.data() + argument.size()) {
+        return std::nullopt;
+      }
+    }
+    if (!next_word().empty()) {
+      return std::nullopt;
+    }
+    return request;
+  }
+
+  inline auto result_name(Result const r) -> std::string_view
+  {
+    switch (r) {
+    case Result::OK:
+      return "OK";
+    case Result::SUSPENDED:
+      return "SUSPENDED";
+    case Result::WAITING:
+      return "WAITING";
+    case Result::LIMIT:
+      return "LIMIT";
+    case Result::OUT_OF_MEMORY:
+      return "OUT_OF_MEMORY";
+    default:
+      return "ERR";
+    }
+  }
+
+  // `OK <value>` or the result name, one line
+  inline auto format_reply(ExecResult const& result) -> std::string
+  {
+    if (result.r != Result::OK) {
+      return std::string{ result_name(result.r) } + '\n';
+    }
+    std::array<char, 32> buffer{};
+    auto const value = result.value.val;
+    char* end{ buffer.data() };
+    if (auto const* d = std::get_if<double>(&value)) {
+      end = std::to_chars(buffer.data(), buffer.data() + buffer.size(), *d).ptr;
+    } else if (auto const* c = std::get_if<char>(&value)) {
+      end = std::to_chars(buffer.data(), buffer.data() + buffer.size(), static_cast<int>(*c)).ptr;
+    } else if (auto const* i = std::get_if<int>(&value)) {
+      end = std::to_chars(buffer.data(), buffer.data() + buffer.size(), *i).ptr;
+    }
+    return "OK " + std::string{ buffer.data(), end } + '\n';
+  }
+
+  // A compiled script run up to its first request() once, every request starts from
+  // there. Scripts that never call request() run from the start each time. The program
+  // keeps views into the source, so a script keeps a copy of it and cannot be moved.
+  class WarmScript
+  {
+  public:
+    WarmScript(std::string name, std::string text, Interpreter const interpreter)
+      : name_{ std::move(name) }, source_{ std::move(text) }, interpreter_{ interpreter }
+    {
+      SourceCode const src{ source_ };
+      Tokenizer<MAX_TOKENS> const tok{ src };
+      auto const tokens = std::make_unique<Tokenizer<MAX_TOKENS>::ResultingTokens>(tok.tokenize());
+      Parser<MAX_TOKENS, 256> const par{ *tokens, natives };
+      program_ = std::make_unique<CompiledProgram>(optimize(par.parse()));
+      if (program_->info.r != Result::OK) {
+        return;
+      }
+      auto context = std::make_unique<Interpreter::Context>();
+      Unlimited budget;
+      if (interpreter_.start(*program_, *context) == Result::OK && interpreter_.resume(*context, budget).r == Result::WAITING) {
+        blob_ = snapshot(*context);
+        snapshot_ = std::make_unique<Snapshot>(*program_, blob_);
+      }
+    }
+
+    WarmScript(WarmScript const&) = delete;
+    auto operator=(WarmScript const&) -> WarmScript& = delete;
+
+    [[nodiscard]] auto name() const noexcept -> std::string const& { return name_; }
+    [[nodiscard]] auto compiled() const noexcept -> bool { return program_->info.r == Result::OK; }
+    [[nodiscard]] auto warm() const noexcept -> bool { return snapshot_ != nullptr; }
+
+    // Runs one request in `context`, every request() of the script gets `argument`
+    auto serve(int const argument, Interpreter::Context& context) const -> ExecResult
+    {
+      if (!compiled()) {
+        return { Result::ERR, {}, 0 };
+      }
+      auto const r = warm() ? snapshot_->fork(interpreter_, context) : interpreter_.start(*program_, context);
+      if (r != Result::OK) {
+        return { r, {}, 0, context.stats };
+      }
+      Unlimited budget;
+      while (true) {
+        auto result = interpreter_.resume(context, budget);
+        if (result.r != Result::WAITING) {
+          result.memory = context.stats;
+          return result;
+        }
+        interpreter_.complete(context, { argument });
+      }
+    }
+
+  private:
+    std::string name_;
+    std::string source_;
+    Interpreter interpreter_;
+    std::unique_ptr<CompiledProgram> program_;
+    std::vector<std::byte> blob_;
+    std::unique_ptr<Snapshot> snapshot_;
+  };
+
+  // Scripts by path, compiled again once the file's modification time changes. Safe to
+  // use from several threads, a WarmScript handed out stays valid after a reload.
+  class ScriptCache
+  {
+  public:
+    explicit ScriptCache(Interpreter const interpreter) noexcept : interpreter_{ interpreter } {}
+
+    // nullptr if the file cannot be read, a script that does not compile is cached too
+    auto get(std::string const& path) -> std::shared_ptr<WarmScript const>
+    {
+      std::error_code error;
+      auto const mtime = std::filesystem::last_write_time(path, error);
+      if (error) {
+        return nullptr;
+      }
+      {
+        std::lock_guard const lock{ mutex_ };
+        if (auto const it = entries_.find(path); it != entries_.end() && it->second.mtime == mtime) {
+          return it->second.script;
+        }
+      }
+      // compiled outside the lock, a request racing for the same file compiles it as well
+      std::ifstream input{ path };
+      if (!input) {
+        return nullptr;
+      }
+      std::string const text{ std::istreambuf_iterator<char>{ input }, std::istreambuf_iterator<char>{} };
+      auto script = std::make_shared<WarmScript const>(path, text, interpreter_);
+      std::lock_guard const lock{ mutex_ };
+      entries_.insert_or_assign(path, Entry{ mtime, script });
+      return script;
+    }
+
+    [[nodiscard]] auto size() -> std::size_t
+    {
+      std::lock_guard const lock{ mutex_ };
+      return entries_.size();
+    }
+
+  private:
+    struct Entry
+    {
+      std::filesystem::file_time_type mtime;
+      std::shared_ptr<WarmScript const> script;
+    };
+
+    Interpreter interpreter_;
+    std::mutex mutex_;
+    std::unordered_map<std::string, Entry> entries_;
+  };
+
+  // sci-daemon's binary protocol, integers are little endian:
+  //   request  u16 path length, i32 argument, the path
+  //   reply    u8 Status, u8 Literal::Type, u16 0, u32 run time in microseconds,
+  //            i64 or f64 value
+  enum class Status : std::uint8_t {
+    OK,
+    LIMIT,
+    OUT_OF_MEMORY,
+    ERR,
+    NO_SCRIPT,// the path cannot be read
+    COMPILE_ERROR,
+    BAD_REQUEST,
+  };
+
+  constexpr std::size_t REQUEST_HEADER_SIZE{ 6 };
+  constexpr std::size_t REPLY_SIZE{ 16 };
+
+  struct Reply
+  {
+    Status status{ Status::OK };
+    Literal value{ Literal::Type::NONE_, 0 };
+    std::uint32_t micros{ 0 };
+  };
+
+  namespace detail {
+    template<typename T>
+    constexpr auto put(char* out, T const value) noexcept -> void
+    {
+      auto const bits = static_cast<std::uint64_t>(value);
+      for (std::size_t i{ 0 }; i < sizeof(T); ++i) {
+        out[i] = static_cast<char>((bits >> (8 * i)) & 0xFFU);
+      }
+    }
+
+    template<typename T>
+    constexpr auto get(char const* in) noexcept -> T
+    {
+      std::uint64_t bits{ 0 };
+      for (std::size_t i{ 0 }; i < sizeof(T); ++i) {
+        bits |= static_cast<std::uint64_t>(static_cast<unsigned char>(in[i])) << (8 * i);
+      }
+      return static_cast<T>(bits);
+    }
+  }// namespace detail
+
+  inline auto encode_request(std::string_view const path, int const argument) -> std::string
+  {
+    std::string request(REQUEST_HEADER_SIZE, '\0');
+    detail::put(request.data(), static_cast<std::uint16_t>(path.size()));
+    detail::put(request.data() + 2, static_cast<std::uint32_t>(argument));
+    return request.append(path);
+  }
+
+  struct RequestHeader
+  {
+    std::size_t path_size;
+    int argument;
+  };
+
+  inline auto decode_request_header(std::array<char, REQUEST_HEADER_SIZE> const& header) noexcept -> RequestHeader
+  {
+    return { detail::get<std::uint16_t>(header.data()), static_cast<int>(detail::get<std::uint32_t>(header.data() + 2)) };
+  }
+
+  inline auto encode_reply(Reply const& reply) noexcept -> std::array<char, REPLY_SIZE>
+  {
+    std::array<char, REPLY_SIZE> out{};
+    out[0] = static_cast<char>(reply.status);
+    out[1] = static_cast<char>(reply.value.type);
+    detail::put(out.data() + 4, reply.micros);
+    std::uint64_t bits{ 0 };
+    if (auto const* d = std::get_if<double>(&reply.value.val)) {
+      bits = std::bit_cast<std::uint64_t>(*d);
+    } else if (auto const* c = std::get_if<char>(&reply.value.val)) {
+      bits = static_cast<std::uint64_t>(static_cast<std::int64_t>(*c));
+    } else if (auto const* i = std::get_if<int>(&reply.value.val)) {
+      bits = static_cast<std::uint64_t>(static_cast<std::int64_t>(*i));
+    }
+    detail::put(out.data() + 8, bits);
+    return out;
+  }
+
+  inline auto decode_reply(std::array<char, REPLY_SIZE> const& in) noexcept -> Reply
+  {
+    Reply reply{ static_cast<Status>(in[0]), { static_cast<Literal::Type>(in[1]), 0 }, detail::get<std::uint32_t>(in.data() + 4) };
+    auto const bits = detail::get<std::uint64_t>(in.data() + 8);
+    switch (reply.value.type) {
+    case Literal::Type::DOUBLE_:
+      reply.value.val = std::bit_cast<double>(bits);
+      break;
+    case Literal::Type::CHAR_:
+      reply.value.val = static_cast<char>(bits);
+      break;
+    default:
+      reply.value.val = static_cast<int>(bits);
+      break;
+    }
+    return reply;
+  }
+
+  // Runs the script at `path` for one request in `context`, timing the run alone
+  inline auto handle(ScriptCache& cache, std::string const& path, int const argument, Interpreter::Context& context) -> Reply
+  {
+    auto const script = cache.get(path);
+    if (script == nullptr) {
+      return { Status::NO_SCRIPT };
+    }
+    if (!script->compiled()) {
+      return { Status::COMPILE_ERROR };
+    }
+    auto const started = std::chrono::steady_clock::now();
+    auto const result = script->serve(argument, context);
+    auto const micros = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - started).count();
+    Reply reply{ Status::ERR, { Literal::Type::NONE_, 0 }, static_cast<std::uint32_t>(micros) };
+    switch (result.r) {
+    case Result::OK:
+      reply.status = Status::OK;
+      reply.value = result.value;
+      break;
+    case Result::LIMIT:
+      reply.status = Status::LIMIT;
+      break;
+    case Result::OUT_OF_MEMORY:
+      reply.status = Status::OUT_OF_MEMORY;
+      break;
+    default:
+      break;
+    }
+    return reply;
+  }
+}// namespace server
+
+}// namespace sci
@@ -0,0 +1,115 @@
+#pragma once
+#include <cerrno>
+#include <chrono>
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "Budget.h"
+
+namespace sci {
+
+// The Unix socket plumbing sci-server and sci-daemon share, POSIX only
+namespace server {
+  // set once SIGINT or SIGTERM arrives, see handle_stop_signals
+  inline volatile std::sig_atomic_t stopping{ 0 };
+
+  inline auto stop(int /*signal*/) -> void
+  {
+    stopping = 1;
+  }
+
+  // SIGINT and SIGTERM set `stopping`, writes to a closed connection fail instead of raising SIGPIPE
+  inline auto handle_stop_signals() -> void
+  {
+    std::signal(SIGPIPE, SIG_IGN);
+    std::signal(SIGINT, stop);
+    std::signal(SIGTERM, stop);
+  }
+
+  inline auto read_all(int const fd, char* out, std::size_t size) -> bool
+  {
+    while (size != 0) {
+      auto const received = ::read(fd, out, size);
+      if (received <= 0) {
+        return false;
+      }
+      out += received;
+      size -= static_cast<std::size_t>(received);
+    }
+    return true;
+  }
+
+  inline auto write_all(int const fd, std::string_view text) -> bool
+  {
+    while (!text.empty()) {
+      auto const written = ::write(fd, text.data(), text.size());
+      if (written <= 0) {
+        return false;
+      }
+      text.remove_prefix(static_cast<std::size_t>(written));
+    }
+    return true;
+  }
+
+  // Reads the leading `--fuel <n>`, `--time-ms <n>` and `--memory <bytes>` options of `args`
+  // into `limits` and returns the index of the first argument after them. Other options go
+  // to `other(name, value)`, which returns false for those it does not know either.
+  template<typename Other>
+  auto parse_limit_options(std::vector<std::string_view> const& args, Limits& limits, Other&& other) -> std::size_t
+  {
+    std::size_t arg{ 0 };
+    for (; arg + 1 < args.size() && args[arg].starts_with("--"); arg += 2) {
+      auto const value = std::strtoull(std::string{ args[arg + 1] }.c_str(), nullptr, 10);
+      if (args[arg] == "--fuel") {
+        limits.fuel = value;
+      } else if (args[arg] == "--time-ms") {
+        limits.time = std::chrono::milliseconds{ value };
+      } else if (args[arg] == "--memory") {
+        limits.memory = value;
+      } else if (!other(args[arg], value)) {
+        break;
+      }
+    }
+    return arg;
+  }
+
+  inline auto parse_limit_options(std::vector<std::string_view> const& args, Limits& limits) -> std::size_t
+  {
+    return parse_limit_options(args, limits, [](std::string_view /*name*/, unsigned long long /*value*/) { return false; });
+  }
+
+  // A listening Unix socket at `path`, replacing a stale one. -1 after telling stderr
+  // why, prefixed with `program`.
+  inline auto listen_unix(std::string_view const program, std::string const& path) -> int
+  {
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(address.sun_path)) {
+      std::cerr << program << ": socket path too long\n";
+      return -1;
+    }
+    std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+    int const listener{ ::socket(AF_UNIX, SOCK_STREAM, 0) };
+    ::unlink(path.c_str());
+    if (listener < 0 || ::bind(listener, reinterpret_cast<sockaddr const*>(&address), sizeof(address)) != 0
+        || ::listen(listener, SOMAXCONN) != 0) {
+      std::cerr << program << ": " << path << ": " << std::strerror(errno) << '\n';
+      if (listener >= 0) {
+        ::close(listener);
+      }
+      return -1;
+    }
+    return listener;
+  }
+}// namespace server
+
+}// namespace sci
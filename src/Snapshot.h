@@ -0,0 +1,223 @@
+#pragma once
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <span>
+#include <vector>
+
+#include "CompiledProgram.h"
+#include "Common.h"
+#include "Interpreter.h"
+
+namespace sci {
+
+// Snapshots of a started ExecutionContext, typically one parked at an async host call
+// after the script's initialisation:
+//   int main() { ...fill tables...; int request = next(); return serve(request); }
+// A server runs the init once, snapshots the context WAITING in next() and forks every
+// request from the blob with Snapshot::fork and Interpreter::complete. The blob holds
+// no pointers, instruction pointers are offsets into their function, so it can be
+// written to a file and mapped by another process running the same program. Only the
+// live frames and comp_stack Values are stored. Within one process copying the context
+// is enough, it points into the program and not into itself.
+
+// Identifies the bytecode a snapshot belongs to, FNV-1a over everything a run reads
+inline auto fingerprint(CompiledProgram const& program) noexcept -> std::uint64_t
+{
+  std::uint64_t hash{ 14695981039346656037ULL };
+  auto const mix = [&hash](std::uint64_t const value) {
+    for (int byte{ 0 }; byte < 8; ++byte) {
+      hash = (hash ^ ((value >> (8 * byte)) & 0xFFU)) * 1099511628211ULL;
+    }
+  };
+  for (auto const& func : program.functions) {
+    mix(static_cast<std::uint64_t>(func.frame_size));
+    mix(static_cast<std::uint64_t>(func.return_type));
+    for (auto const& ins : func.instructions) {
+      mix(static_cast<std::uint64_t>(ins.type));
+      mix(static_cast<std::uint64_t>(ins.par_type));
+      mix(ins.par_type == Literal::Type::DOUBLE_ ? std::bit_cast<std::uint64_t>(ins.par.d) : static_cast<std::uint32_t>(ins.par.i));
+    }
+  }
+  for (auto const& native : program.natives) {
+    for (char const c : native.name) {
+      mix(static_cast<unsigned char>(c));
+    }
+    mix(static_cast<std::uint64_t>(native.arity));
+  }
+  return hash;
+}
+
+// Blob layout, host byte order: SnapshotHeader, `frames` SnapshotFrames, `comp_values`
+// and `memory_values` Values
+struct SnapshotHeader
+{
+  constexpr static std::uint32_t MAGIC{ 0x53434953 };// "SCIS"
+  constexpr static std::uint32_t VERSION{ 1 };
+  std::uint32_t magic{ MAGIC };
+  std::uint32_t version{ VERSION };
+  std::uint64_t program{ 0 };// fingerprint
+  std::uint32_t frames{ 0 };
+  std::uint32_t comp_values{ 0 };
+  std::uint32_t memory_values{ 0 };// the frames take [0, memory_values)
+  std::int32_t waiting_native{ -1 };
+  std::array<Value, NativeFunction::MAX_PARAMS> native_args{};
+};
+
+struct SnapshotFrame
+{
+  std::int32_t next_instruction;// offset into the function's instructions
+  std::int32_t func_index;
+  std::int32_t base;
+  std::int32_t end;
+};
+
+namespace detail {
+  inline auto snapshot_bytes(SnapshotHeader const& header) noexcept -> std::size_t
+  {
+    return sizeof(SnapshotHeader) + header.frames * sizeof(SnapshotFrame)
+           + (static_cast<std::size_t>(header.comp_values) + header.memory_values) * sizeof(Value);
+  }
+
+  template<typename Context>
+  auto snapshot_header(Context const& context) noexcept -> SnapshotHeader
+  {
+    SnapshotHeader header;
+    header.program = fingerprint(*context.program);
+    header.frames = static_cast<std::uint32_t>(context.func_stack.size());
+    header.comp_values = static_cast<std::uint32_t>(context.comp_stack.size());
+    header.memory_values = context.func_stack.empty() ? 0U : static_cast<std::uint32_t>(context.func_stack.top().end);
+    header.waiting_native = context.waiting_native;
+    header.native_args = context.native_args;
+    return header;
+  }
+}// namespace detail
+
+// Bytes save_snapshot writes for `context`
+template<typename Context>
+auto snapshot_size(Context const& context) noexcept -> std::size_t
+{
+  return detail::snapshot_bytes(detail::snapshot_header(context));
+}
+
+// Writes `context` to `out`, the bytes written or 0 if `out` is too small
+template<typename Context>
+auto save_snapshot(Context const& context, std::span<std::byte> const out) noexcept -> std::size_t
+{
+  auto const header = detail::snapshot_header(context);
+  auto const size = detail::snapshot_bytes(header);
+  if (out.size() < size) {
+    return 0;
+  }
+  std::byte* at{ out.data() };
+  std::memcpy(at, &header, sizeof(header));
+  at += sizeof(header);
+  for (std::size_t i{ 0 }; i < header.frames; ++i) {
+    auto const& frame = context.func_stack.data()[i];
+    auto const& func = context.program->functions[static_cast<std::size_t>(frame.func_index)];
+    SnapshotFrame const saved{ static_cast<std::int32_t>(frame.next_ins_ptr - func.instructions.data()), frame.func_index, frame.base, frame.end };
+    std::memcpy(at, &saved, sizeof(saved));
+    at += sizeof(saved);
+  }
+  std::memcpy(at, context.comp_stack.data().data(), header.comp_values * sizeof(Value));
+  at += header.comp_values * sizeof(Value);
+  std::memcpy(at, context.memory.data(), header.memory_values * sizeof(Value));
+  return size;
+}
+
+template<typename Context>
+auto snapshot(Context const& context) -> std::vector<std::byte>
+{
+  std::vector<std::byte> blob(snapshot_size(context));
+  save_snapshot(context, blob);
+  return blob;
+}
+
+// A blob checked against its program once, forks from it copy the saved state only.
+// The blob is not copied and has to outlive the Snapshot, it may be a mapped file.
+class Snapshot
+{
+public:
+  Snapshot(CompiledProgram const& program, std::span<std::byte const> const blob) noexcept
+    : program_{ &program }, blob_{ blob }, valid_{ check() }
+  {}
+
+  // false if the blob is damaged or belongs to another program
+  [[nodiscard]] auto valid() const noexcept -> bool { return valid_; }
+
+  // Starts `context` on `interpreter` like Interpreter::start and replaces main's fresh
+  // frame with the saved state, so the Limits of `interpreter` apply to the fork. ERR if
+  // the snapshot is not valid or does not fit the context.
+  template<typename Interp>
+  auto fork(Interp const& interpreter, typename Interp::Context& context) const noexcept -> Result
+  {
+    if (!valid_ || header_.frames > context.func_stack.data().size() || header_.comp_values > context.comp_stack.data().size()
+        || header_.memory_values > context.memory.size()) {
+      return Result::ERR;
+    }
+    if (auto const r = interpreter.start(*program_, context); r != Result::OK) {
+      return r;
+    }
+    if (static_cast<int>(header_.memory_values) > context.memory_quota) {
+      return Result::OUT_OF_MEMORY;
+    }
+    std::byte const* at{ blob_.data() + sizeof(SnapshotHeader) };
+    context.func_stack.clear();
+    for (std::size_t i{ 0 }; i < header_.frames; ++i) {
+      SnapshotFrame frame{};
+      std::memcpy(&frame, at, sizeof(frame));
+      at += sizeof(frame);
+      auto const& func = program_->functions[static_cast<std::size_t>(frame.func_index)];
+      context.func_stack.push_unchecked({ func.instructions.data() + frame.next_instruction, frame.func_index, frame.base, frame.end });
+    }
+    for (std::size_t i{ 0 }; i < header_.comp_values; ++i) {
+      Value value;
+      std::memcpy(&value, at, sizeof(value));
+      at += sizeof(value);
+      context.comp_stack.push_unchecked(value);
+    }
+    std::memcpy(context.memory.data(), at, header_.memory_values * sizeof(Value));
+    context.waiting_native = header_.waiting_native;
+    context.native_args = header_.native_args;
+    context.stats.peak_bytes = header_.memory_values * sizeof(Value);
+    context.stats.total_bytes = context.stats.peak_bytes;
+    return Result::OK;
+  }
+
+private:
+  auto check() noexcept -> bool
+  {
+    if (blob_.size() < sizeof(header_)) {
+      return false;
+    }
+    std::memcpy(&header_, blob_.data(), sizeof(header_));
+    if (header_.magic != SnapshotHeader::MAGIC || header_.version != SnapshotHeader::VERSION
+        || header_.program != fingerprint(*program_) || header_.frames == 0 || blob_.size() != detail::snapshot_bytes(header_)
+        || header_.waiting_native < -1 || header_.waiting_native >= CompiledProgram::NUM_OF_NATIVES) {
+      return false;
+    }
+    std::byte const* at{ blob_.data() + sizeof(header_) };
+    std::int32_t previous_end{ 0 };
+    for (std::size_t i{ 0 }; i < header_.frames; ++i) {
+      SnapshotFrame frame{};
+      std::memcpy(&frame, at, sizeof(frame));
+      at += sizeof(frame);
+      // frames lie behind each other, the last one ends where the saved memory does
+      if (frame.func_index < 0 || frame.func_index >= CompiledProgram::NUM_OF_FUNC || frame.next_instruction < 0
+          || frame.next_instruction >= CompiledFunction::NUM_OF_INS || frame.base != previous_end || frame.end < frame.base) {
+        return false;
+      }
+      previous_end = frame.end;
+    }
+    return previous_end == static_cast<std::int32_t>(header_.memory_values);
+  }
+
+  CompiledProgram const* program_;
+  std::span<std::byte const> blob_;
+  SnapshotHeader header_{};
+  bool valid_;
+};
+
+}// namespace sci
@@ -0,0 +1,141 @@
+#pragma once
+#include <algorithm>
+#include <array>
+
+#include "CompiledProgram.h"
+#include "Common.h"
+
+namespace sci {
+
+struct StackBounds
+{
+  Result r{ Result::ERR };
+  std::size_t func_stack{ 0 };// frames, main included
+  std::size_t comp_stack{ 0 };
+  std::size_t memory{ 0 };// Values, the frames of the deepest call chain
+  // per function, callees included, -1 where not reachable from main
+  std::array<int, CompiledProgram::NUM_OF_FUNC> max_depth{};
+  std::array<int, CompiledProgram::NUM_OF_FUNC> net{};
+};
+
+namespace detail {
+  struct BoundsAnalysis
+  {
+    enum class State {
+      UNVISITED,
+      IN_PROGRESS,
+      DONE,
+    };
+    CompiledProgram const& program;
+    std::array<State, CompiledProgram::NUM_OF_FUNC> state{};
+    std::array<int, CompiledProgram::NUM_OF_FUNC> call_depth{};
+    std::array<int, CompiledProgram::NUM_OF_FUNC> memory{};
+    StackBounds& bounds;
+
+    // Walks every path through `func` keeping the comp_stack depth before each
+    // instruction. Paths meeting at an instruction have to agree on the depth,
+    // so loops cannot grow the stack. Recursion has no static bound.
+    constexpr auto analyze(int const func) noexcept -> bool
+    {
+      if (func < 0 || func >= CompiledProgram::NUM_OF_FUNC || state[static_cast<std::size_t>(func)] == State::IN_PROGRESS) {
+        return false;
+      }
+      auto const f = static_cast<std::size_t>(func);
+      if (state[f] == State::DONE) {
+        return true;
+      }
+      state[f] = State::IN_PROGRESS;
+
+      constexpr auto N{ CompiledFunction::NUM_OF_INS };
+      auto const& ins = program.functions[f].instructions;
+      std::array<int, N> depth{};
+      depth.fill(-1);
+      ConstexprStack<int, N> pending;
+      int max_depth{ 0 };
+      int net{ -1 };
+      int frames{ 1 };
+      int callee_memory{ 0 };
+
+      auto const reach = [&depth, &pending](int const index, int const d) {
+        if (index < 0 || index >= N) {
+          return false;
+        }
+        if (depth[static_cast<std::size_t>(index)] == -1) {
+          depth[static_cast<std::size_t>(index)] = d;
+          pending.push(index);
+          return true;
+        }
+        return depth[static_cast<std::size_t>(index)] == d;
+      };
+
+      depth[0] = 0;
+      pending.push(0);
+      while (!pending.empty()) {
+        int const i{ pending.top() };
+        pending.pop();
+        auto const type = ins[static_cast<std::size_t>(i)].type;
+        auto const effect = stack_effect(ins[static_cast<std::size_t>(i)], program);
+        int d{ depth[static_cast<std::size_t>(i)] - effect.pops };
+        if (d < 0) {
+          return false;
+        }
+        d += effect.pushes;
+        max_depth = std::max(max_depth, d);
+
+        if (type == Instruction::Type::CALL) {
+          int const callee{ ins[static_cast<std::size_t>(i)].par.i };
+          if (!analyze(callee)) {
+            return false;
+          }
+          max_depth = std::max(max_depth, d + bounds.max_depth[static_cast<std::size_t>(callee)]);
+          frames = std::max(frames, call_depth[static_cast<std::size_t>(callee)] + 1);
+          callee_memory = std::max(callee_memory, memory[static_cast<std::size_t>(callee)]);
+          d += bounds.net[static_cast<std::size_t>(callee)];
+        }
+
+        if (type == Instruction::Type::RET || type == Instruction::Type::NONE) {
+          if (net != -1 && net != d) {
+            return false;
+          }
+          net = d;
+          continue;
+        }
+        if (is_jump(type) && !reach(i + 1 + ins[static_cast<std::size_t>(i)].par.i, d)) {
+          return false;
+        }
+        if (type != Instruction::Type::JMP && !reach(i + 1, d)) {
+          return false;
+        }
+      }
+
+      bounds.max_depth[f] = max_depth;
+      bounds.net[f] = std::max(net, 0);// never returns, nothing follows its calls
+      call_depth[f] = frames;
+      memory[f] = program.functions[f].frame_size + callee_memory;
+      state[f] = State::DONE;
+      return true;
+    }
+  };
+}// namespace detail
+
+// Stack and memory sizes that Interpreter<func_stack, memory, comp_stack> needs to run `program`
+// without overflow, which makes StackChecks::UNCHECKED safe. r is ERR for recursion,
+// calls of unknown functions, underflow and loops that change the stack depth.
+constexpr auto stack_bounds(CompiledProgram const& program) noexcept -> StackBounds
+{
+  StackBounds bounds;
+  bounds.max_depth.fill(-1);
+  detail::BoundsAnalysis analysis{ program, {}, {}, {}, bounds };
+  if (!analysis.analyze(0)) {
+    StackBounds unbounded;
+    unbounded.max_depth.fill(-1);
+    return unbounded;
+  }
+  bounds.r = Result::OK;
+  bounds.func_stack = static_cast<std::size_t>(analysis.call_depth[0]);
+  bounds.comp_stack = static_cast<std::size_t>(bounds.max_depth[0]);
+  bounds.memory = static_cast<std::size_t>(analysis.memory[0]);
+  return bounds;
+}
+
+}// namespace sci
@@ -0,0 +1,94 @@
+#pragma once
+#include <array>
+#include <string_view>
+
+namespace sci {
+
+// Interned string literals of a program, instructions refer to them by index.
+// Literals without escapes are views into the source code, so they cost no copy;
+// the others are decoded into the pool's own buffer. Entries keep offsets instead of
+// pointers into the buffer so that a copied program stays valid. Equal strings share
+// one index.
+class StringPool
+{
+public:
+  constexpr static auto MAX_STRINGS{ 32 };
+  constexpr static std::size_t BUFFER_SIZE{ 512 };
+
+private:
+  struct Entry
+  {
+    std::string_view source;// empty for decoded strings
+    std::size_t offset;// into buffer_
+    std::size_t size;
+  };
+
+  std::array<Entry, MAX_STRINGS> entries_{};
+  std::array<char, BUFFER_SIZE> buffer_{};
+  int num_of_strings_{ 0 };
+  std::size_t buffer_used_{ 0 };
+
+public:
+  [[nodiscard]] constexpr auto size() const noexcept { return num_of_strings_; }
+
+  [[nodiscard]] constexpr auto get(int const index) const noexcept -> std::string_view
+  {
+    auto const& e = entries_[static_cast<std::size_t>(index)];
+    if (!e.source.empty() || e.size == 0) {
+      return e.source;
+    }
+    return { buffer_.data() + e.offset, e.size };
+  }
+
+  // `raw` is the literal between the quotes, `unescape` maps the character after
+  // a backslash to its value. Returns the index, -1 when the pool is full.
+  template<typename Unescape>
+  constexpr auto intern(std::string_view const raw, Unescape&& unescape) noexcept -> int
+  {
+    if (raw.find('\\') == std::string_view::npos) {
+      if (auto const index = find(raw); index != -1) {
+        return index;
+      }
+      return add({ raw, 0, raw.size() });
+    }
+
+    // decoded strings are never longer than the raw text
+    if (buffer_used_ + raw.size() > BUFFER_SIZE) {
+      return -1;
+    }
+    std::size_t size{ 0 };
+    for (std::size_t i{ 0 }; i < raw.size(); ++i) {
+      buffer_[buffer_used_ + size++] = raw[i] == '\\' ? unescape(raw[++i]) : raw[i];
+    }
+    if (auto const index = find({ buffer_.data() + buffer_used_, size }); index != -1) {
+      return index;
+    }
+    auto const index = add({ {}, buffer_used_, size });
+    if (index != -1) {
+      buffer_used_ += size;
+    }
+    return index;
+  }
+
+private:
+  constexpr auto find(std::string_view const text) const noexcept -> int
+  {
+    for (int i{ 0 }; i < num_of_strings_; ++i) {
+      if (get(i) == text) {
+        return i;
+      }
+    }
+    return -1;
+  }
+
+  constexpr auto add(Entry const& entry) noexcept -> int
+  {
+    if (num_of_strings_ == MAX_STRINGS) {
+      return -1;
+    }
+    entries_[static_cast<std::size_t>(num_of_strings_)] = entry;
+    return num_of_strings_++;
+  }
+};
+
+}// namespace sci
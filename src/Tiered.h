@@ -0,0 +1,79 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <optional>
+
+#include "CompiledProgram.h"
+#include "ExecutionHooks.h"
+#include "Jit.h"
+
+namespace sci {
+
+// Tiered execution, pass it to Interpreter::interpret as hooks and keep it alive across runs.
+// Calls are counted per function; once they reach `threshold` the function is promoted to
+// the JIT tier and later calls run natively. Functions the JIT rejects, which includes every
+// function with a loop, and those that need frames in VM memory, stay interpreted and are
+// not retried, so short scripts never pay for compilation.
+template<std::size_t FuncStackSize, std::size_t CompStackSize>
+class TieredExecution : public ExecutionHooks
+{
+  CompiledProgram const& program_;
+  std::size_t threshold_;
+  std::array<std::size_t, CompiledProgram::NUM_OF_FUNC> calls_{};
+  std::array<std::optional<JitProgram>, CompiledProgram::NUM_OF_FUNC> promoted_;
+  std::array<bool, CompiledProgram::NUM_OF_FUNC> rejected_{};
+
+public:
+  explicit TieredExecution(CompiledProgram const& program, std::size_t const threshold = 1000)
+    : program_{ program }, threshold_{ threshold }
+  {}
+
+  template<typename FuncStack, typename CompStack>
+  auto on_call(int const func_index, FuncStack const& func_stack, CompStack& comp_stack, std::uint64_t& fuel) noexcept -> bool
+  {
+    if (func_index < 0 || func_index >= CompiledProgram::NUM_OF_FUNC) {
+      return false;
+    }
+    auto const f = static_cast<std::size_t>(func_index);
+    if (!promoted_[f]) {
+      if (rejected_[f] || ++calls_[f] < threshold_) {
+        return false;
+      }
+      // the interpreter runs noexcept, a function that cannot get its code buffer stays interpreted
+      try {
+        promoted_[f] = JitProgram::compile_function(program_, func_index);
+      } catch (...) {
+        promoted_[f].reset();
+      }
+      // native code skips the callee frames, which would escape MemorySize and Limits::memory
+      if (promoted_[f] && promoted_[f]->memory() > 0) {
+        promoted_[f].reset();
+      }
+      if (!promoted_[f]) {
+        rejected_[f] = true;
+        return false;
+      }
+    }
+
+    auto const& native = *promoted_[f];
+    // stay interpreted where native code would not report the overflow or the spent fuel
+    if (func_stack.size() + native.call_depth() > FuncStackSize
+        || comp_stack.size() + native.max_comp_depth() > CompStackSize
+        || native.calls() > fuel) {
+      return false;
+    }
+    fuel -= native.calls();
+
+    std::array<int, CompStackSize> stack;
+    int const* const top = native.call(stack.data());
+    for (int const* value = stack.data(); value != top; ++value) {
+      comp_stack.push({ *value });
+    }
+    return true;
+  }
+
+  [[nodiscard]] auto calls(int const func_index) const noexcept { return calls_[static_cast<std::size_t>(func_index)]; }
+  [[nodiscard]] auto promoted(int const func_index) const noexcept { return promoted_[static_cast<std::size_t>(func_index)].has_value(); }
+};
+
+}// namespace sci
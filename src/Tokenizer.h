@@ -7,6 +7,7 @@
 #include "my_ctype.h"
 
 #include "Common.h"
+#include "FloatParsing.h"
 #include "SourceCode.h"
 
 namespace sci {
@@ -23,6 +24,7 @@ struct Token
   enum class TKW {
     AUTO_,
     CHAR_,
+    DOUBLE_,
     INT_,
     VOID_,
   };
@@ -48,6 +50,64 @@ public:
   };
 
 private:
+  // Kept as static members so that constant evaluation builds them once,
+  // not on every getNextToken call.
+  static constexpr auto const char_token_map = mapbox::eternal::map<char, Token::Type>({
+    { '!', Token::Type::EXCLAMATION },
+    { '%', Token::Type::PERCENT },
+    { '&', Token::Type::AMPERSAND },
+    { '(', Token::Type::OPEN_PAR },
+    { ')', Token::Type::CLOSE_PAR },
+    { '*', Token::Type::STAR },
+    { '+', Token::Type::PLUS },
+    { ',', Token::Type::COMMA },
+    { '-', Token::Type::MINUS },
+    { '.', Token::Type::DOT },
+    { '/', Token::Type::SLASH },
+    { ':', Token::Type::COLON },
+    { ';', Token::Type::SEMICOLON },
+    { '<', Token::Type::LEFT },
+    { '=', Token::Type::EQUAL },
+    { '>', Token::Type::RIGHT },
+    { '[', Token::Type::OPEN_BRACKET },
+    { '\'', Token::Type::APOSTROPHE },
+    { '\\', Token::Type::BACKSLASH },
+    { ']', Token::Type::CLOSE_BRACKET },
+    { '^', Token::Type::UP },
+    { '{', Token::Type::OPEN_CURLY },
+    { '|', Token::Type::PIPE },
+    { '}', Token::Type::CLOSE_CURLY },
+    { '~', Token::Type::TILDE },
+  });
+
+  static constexpr auto const string_token_map = mapbox::eternal::map<std::string_view, Token>({
+    { "auto", { Token::Type::KWTYPE, Token::TKW::AUTO_ } },
+    { "char", { Token::Type::KWTYPE, Token::TKW::CHAR_ } },
+    { "const", { Token::Type::KWCONST, 0 } },
+    { "double", { Token::Type::KWTYPE, Token::TKW::DOUBLE_ } },
+    { "else", { Token::Type::KWELSE, 0 } },
+    { "for", { Token::Type::KWFOR, 0 } },
+    { "if", { Token::Type::KWIF, 0 } },
+    { "int", { Token::Type::KWTYPE, Token::TKW::INT_ } },
+    { "return", { Token::Type::KWRET, 0 } },
+    { "void", { Token::Type::KWTYPE, Token::TKW::VOID_ } },
+    { "while", { Token::Type::KWWHILE, 0 } },
+  });
+
+  static constexpr auto const escaped_literal_map = mapbox::eternal::map<char, char>({
+    { 'a', '\a' },
+    { 'b', '\b' },
+    { 'f', '\f' },
+    { 'n', '\n' },
+    { 'r', '\r' },
+    { 't', '\t' },
+    { 'v', '\v' },
+    { '\\', '\\' },
+    { '\'', '\'' },
+    { '"', '"' },
+    { '?', '?' },
+  });
+
   SourceCode const& src_;
   int line_num_{ 1 };
   bool ended_{ false };
@@ -58,48 +118,17 @@ public:
     : src_{ src }
   {}
 
+  // Value of the escape sequence `\c`, 0 for unknown escapes
+  [[nodiscard]] static constexpr auto unescape(char const c) noexcept -> char
+  {
+    auto const it = escaped_literal_map.find(c);
+    return it != escaped_literal_map.end() ? it->second : '\0';
+  }
+
   [[nodiscard]] constexpr auto ended() const noexcept { return ended_; }
   [[nodiscard]] constexpr auto getError() const noexcept { return current_error_; }
   [[nodiscard]] constexpr auto getNextToken(int& i) const noexcept -> TokenResult
   {
-    constexpr auto const char_token_map = mapbox::eternal::map<char, Token::Type>({
-      { '!', Token::Type::EXCLAMATION },
-      { '"', Token::Type::QUOTATION },
-      { '%', Token::Type::PERCENT },
-      { '&', Token::Type::AMPERSAND },
-      { '(', Token::Type::OPEN_PAR },
-      { ')', Token::Type::CLOSE_PAR },
-      { '*', Token::Type::STAR },
-      { '+', Token::Type::PLUS },
-      { ',', Token::Type::COMMA },
-      { '-', Token::Type::MINUS },
-      { '.', Token::Type::DOT },
-      { '/', Token::Type::SLASH },
-      { ':', Token::Type::COLON },
-      { ';', Token::Type::SEMICOLON },
-      { '<', Token::Type::LEFT },
-      { '=', Token::Type::EQUAL },
-      { '>', Token::Type::RIGHT },
-      { '[', Token::Type::OPEN_BRACKET },
-      { '\'', Token::Type::APOSTROPHE },
-      { '\\', Token::Type::BACKSLASH },
-      { ']', Token::Type::CLOSE_BRACKET },
-      { '^', Token::Type::UP },
-      { '{', Token::Type::OPEN_CURLY },
-      { '|', Token::Type::PIPE },
-      { '}', Token::Type::CLOSE_CURLY },
-      { '~', Token::Type::TILDE },
-    });
-
-    constexpr auto const string_token_map = mapbox::eternal::map<std::string_view, Token>({
-      { "auto", { Token::Type::KWTYPE, Token::TKW::AUTO_ } },
-      { "char", { Token::Type::KWTYPE, Token::TKW::CHAR_ } },
-      { "const", { Token::Type::KWCONST, 0 } },
-      { "int", { Token::Type::KWTYPE, Token::TKW::INT_ } },
-      { "return", { Token::Type::KWRET, 0 } },
-      { "void", { Token::Type::KWTYPE, Token::TKW::VOID_ } },
-    });
-
     for (auto c = src_.getNextChar(i); c != nullptr; c = src_.getNextChar(i)) {
       if (sci::isspace(*c)) {
 //        if (*c == '\n') {
@@ -119,19 +148,6 @@ public:
             // TODO: unicode codepoint \Uhhhhhhhh
 
           } else {
-            constexpr auto const escaped_literal_map = mapbox::eternal::map<char, char>({
-              { 'a', '\a' },
-              { 'b', '\b' },
-              { 'f', '\f' },
-              { 'n', '\n' },
-              { 'r', '\r' },
-              { 't', '\t' },
-              { 'v', '\v' },
-              { '\\', '\\' },
-              { '\'', '\'' },
-              { '"', '"' },
-              { '?', '?' },
-            });
             auto it = escaped_literal_map.find(escaped);
             if (it != escaped_literal_map.end()) {
               return { { Token::Type::LITERAL, Literal{ Literal::Type::CHAR_, it->second } }, Result::OK };
@@ -150,6 +166,24 @@ public:
         }
         continue;
 
+      } else if (*c == '"') {
+        // the literal keeps its escapes, they are decoded when the parser interns it
+        char const* const first = src_.peekNextChar(i);
+        std::size_t size{ 0 };
+        for (auto s = src_.getNextChar(i); s == nullptr || *s != '"'; s = src_.getNextChar(i), ++size) {
+          if (s == nullptr) {
+            return { { Token::Type::ERROR, "String not closed" }, Result::ERR };
+          }
+          if (*s == '\\') {
+            auto const escaped = src_.getNextChar(i);
+            if (escaped == nullptr || escaped_literal_map.find(*escaped) == escaped_literal_map.end()) {
+              return { { Token::Type::ERROR, "Unknown escape char" }, Result::ERR };
+            }
+            ++size;
+          }
+        }
+        return { { Token::Type::LITERAL, Literal{ Literal::Type::STRING_, std::string_view{ first, size } } }, Result::OK };
+
       } else if (*c == '#') {
         src_.ignoreToNewLine(i);
 //        ++line_num_;
@@ -171,6 +205,11 @@ public:
         }
 
       } else if (sci::isdigit(*c)) {
+        if (int const end = double_end(i); end != i) {
+          std::string_view const text{ c, static_cast<std::size_t>(end - i + 1) };
+          i = end;
+          return { { Token::Type::LITERAL, Literal{ Literal::Type::DOUBLE_, parse_double(text) } }, Result::OK };
+        }
         return { { Token::Type::LITERAL, Literal{ Literal::Type::INT_, src_.readWholeInt(*c, i) } }, Result::OK };
 
       } else {
@@ -187,6 +226,48 @@ public:
     return { {}, Result::END };
   }
 
+  // Past the end of a floating-point literal (digits, then a fraction or an exponent)
+  // whose first digit was just read, `i` itself for an int literal
+  [[nodiscard]] constexpr auto double_end(int i) const noexcept -> int
+  {
+    auto const char_at = [this](int j) {
+      auto const c = src_.peekNextChar(j);
+      return c != nullptr ? *c : '\0';
+    };
+    int const start{ i };
+    bool fraction_or_exponent{ false };
+    while (sci::isdigit(char_at(i))) {
+      ++i;
+    }
+    if (char_at(i) == '.') {
+      fraction_or_exponent = true;
+      for (++i; sci::isdigit(char_at(i)); ++i) {}
+    }
+    if (char_at(i) == 'e' || char_at(i) == 'E') {
+      int j{ i + 1 };
+      if (char_at(j) == '+' || char_at(j) == '-') {
+        ++j;
+      }
+      if (sci::isdigit(char_at(j))) {
+        fraction_or_exponent = true;
+        for (i = j; sci::isdigit(char_at(i)); ++i) {}
+      }
+    }
+    return fraction_or_exponent ? i : start;
+  }
+
+  // Tokens tokenize() produces for the whole source, END_OF_SOURCECODE or ERROR included,
+  // so Tokenizer<count()> is the smallest tokenizer that does not truncate it
+  [[nodiscard]] constexpr auto count() const noexcept -> std::size_t
+  {
+    int i = 0;
+    std::size_t tok_num = 0;
+    while (getNextToken(i).r == Result::OK) {
+      ++tok_num;
+    }
+    return tok_num + 1;
+  }
+
   [[nodiscard]] constexpr auto tokenize() const -> ResultingTokens
   {
     ResultingTokens tokens;
@@ -194,6 +275,11 @@ public:
     TokenResult tr;
     int tok_num = 0;
     for (; (tr = getNextToken(i)).r == Result::OK; ++tok_num) {
+      // last slot is reserved for END_OF_SOURCECODE or ERROR
+      if (tok_num + 1 >= static_cast<int>(MaxTokens)) {
+        tr.r = Result::ERR;
+        break;
+      }
       tokens[tok_num] = tr.t;
     }
     if (tr.r == Result::END) {
@@ -0,0 +1,157 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <string_view>
+
+#include "ExecutionHooks.h"
+
+namespace sci {
+
+// Low-overhead tracing of compiler phases and interpreter runs.
+// Events go into a fixed ring buffer (the oldest are overwritten) and can be
+// exported as Chrome trace JSON (chrome://tracing, Perfetto). Used as hooks for
+// Interpreter::interpret it also counts executed instructions and stack high-water marks.
+template<std::size_t Capacity = 1024>
+class Tracer : public ExecutionHooks
+{
+public:
+  using Clock = std::chrono::steady_clock;
+
+  struct Event
+  {
+    std::string_view name;
+    char phase;// 'B' begin, 'E' end, 'C' counter
+    Clock::time_point time;
+    std::int64_t value;
+  };
+
+  struct PhaseTime
+  {
+    std::string_view name;
+    Clock::duration duration;
+  };
+
+  class Phase
+  {
+    Tracer& tracer_;
+    std::string_view name_;
+
+  public:
+    Phase(Tracer& tracer, std::string_view const name)
+      : tracer_{ tracer }, name_{ name }
+    {
+      tracer_.begin(name_);
+    }
+    Phase(Phase const&) = delete;
+    auto operator=(Phase const&) -> Phase& = delete;
+    ~Phase() { tracer_.end(name_); }
+  };
+
+private:
+  constexpr static std::size_t MAX_PHASES{ 16 };
+
+  std::array<Event, Capacity> events_{};
+  std::size_t recorded_{ 0 };
+  Clock::time_point start_{ Clock::now() };
+
+  std::array<PhaseTime, MAX_PHASES> phases_{};
+  std::array<Clock::time_point, MAX_PHASES> phase_begin_{};
+  std::size_t num_phases_{ 0 };
+
+  std::int64_t instructions_{ 0 };
+  std::size_t max_func_depth_{ 0 };
+  std::size_t max_comp_depth_{ 0 };
+
+public:
+  auto begin(std::string_view const name) -> void
+  {
+    auto const now = Clock::now();
+    record({ name, 'B', now, 0 });
+    phase_begin_[phase_index(name)] = now;
+  }
+
+  auto end(std::string_view const name) -> void
+  {
+    auto const now = Clock::now();
+    record({ name, 'E', now, 0 });
+    auto const index = phase_index(name);
+    phases_[index].duration += now - phase_begin_[index];
+  }
+
+  auto counter(std::string_view const name, std::int64_t const value) -> void
+  {
+    record({ name, 'C', Clock::now(), value });
+  }
+
+  [[nodiscard]] auto phase(std::string_view const name) -> Phase { return { *this, name }; }
+
+  template<typename FuncStack, typename CompStack>
+  auto on_instruction(FuncStack const& func_stack, CompStack const& comp_stack) noexcept -> void
+  {
+    ++instructions_;
+    max_func_depth_ = std::max(max_func_depth_, func_stack.size());
+    max_comp_depth_ = std::max(max_comp_depth_, comp_stack.size());
+  }
+
+  [[nodiscard]] auto instructions() const noexcept { return instructions_; }
+  [[nodiscard]] auto max_func_depth() const noexcept { return max_func_depth_; }
+  [[nodiscard]] auto max_comp_depth() const noexcept { return max_comp_depth_; }
+
+  // Accumulated time of every phase, in order of first use
+  template<typename Function>
+  auto for_each_phase(Function&& f) const -> void
+  {
+    for (std::size_t i{ 0 }; i < num_phases_; ++i) {
+      f(phases_[i]);
+    }
+  }
+
+  [[nodiscard]] auto dropped() const noexcept -> std::size_t
+  {
+    return recorded_ > Capacity ? recorded_ - Capacity : 0;
+  }
+
+  auto write_chrome_trace(std::ostream& out) const -> void
+  {
+    out << "{\"traceEvents\":[";
+    auto const first = dropped();
+    for (auto i = first; i < recorded_; ++i) {
+      auto const& e = events_[i % Capacity];
+      auto const ts = std::chrono::duration_cast<std::chrono::microseconds>(e.time - start_).count();
+      out << (i == first ? "" : ",") << "\n{\"name\":\"" << e.name << "\",\"ph\":\"" << e.phase
+          << "\",\"ts\":" << ts << ",\"pid\":1,\"tid\":1";
+      if (e.phase == 'C') {
+        out << ",\"args\":{\"" << e.name << "\":" << e.value << '}';
+      }
+      out << '}';
+    }
+    out << "\n]}\n";
+  }
+
+private:
+  auto record(Event const& e) noexcept -> void
+  {
+    events_[recorded_ % Capacity] = e;
+    ++recorded_;
+  }
+
+  // Phases past MAX_PHASES share the last slot
+  auto phase_index(std::string_view const name) noexcept -> std::size_t
+  {
+    for (std::size_t i{ 0 }; i < num_phases_; ++i) {
+      if (phases_[i].name == name) {
+        return i;
+      }
+    }
+    if (num_phases_ == MAX_PHASES) {
+      return MAX_PHASES - 1;
+    }
+    phases_[num_phases_] = { name, {} };
+    return num_phases_++;
+  }
+};
+
+}// namespace sci
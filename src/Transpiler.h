@@ -0,0 +1,515 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <limits>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "CompiledProgram.h"
+#include "Common.h"
+#include "Disassembler.h"
+#include "StackBounds.h"
+
+namespace sci {
+
+// Ahead-of-time translation of a CompiledProgram into a C++ translation unit.
+// Every script function becomes an inline C++ function working on a Value operand
+// stack and a block of frame memory laid out like the interpreter's, jumps become
+// gotos, so the host compiler can inline call chains and optimize whole loops. The
+// generated entry point `auto <symbol>() -> int` returns what Interpreter::interpret
+// returns for the program, as long as the interpreter stacks and memory would not
+// overflow (AOT code is sized by stack_bounds instead). The generated code includes
+// Kernels.h for SUM, DOT, FILL and COPY. Recursive programs and host function calls
+// are not translated.
+class Transpiler
+{
+public:
+  struct Output
+  {
+    Result r;
+    std::string text;// generated code, or the error message
+  };
+
+private:
+  struct FunctionInfo
+  {
+    enum class State {
+      UNVISITED,
+      IN_PROGRESS,
+      DONE,
+    };
+    State state{ State::UNVISITED };
+    bool can_fail{ false };// returns nullptr for an access outside the live frames, callees included
+    int length{ 0 };
+    std::array<bool, CompiledFunction::NUM_OF_INS + 1> target{};// instructions jumped to, length for the end
+  };
+
+  CompiledProgram const& program_;
+  std::array<FunctionInfo, CompiledProgram::NUM_OF_FUNC> info_{};
+  std::vector<int> order_;// callees before callers
+  std::string error_;
+
+public:
+  explicit Transpiler(CompiledProgram const& program) noexcept
+    : program_{ program }
+  {}
+
+  [[nodiscard]] auto transpile(std::string_view const symbol) -> Output
+  {
+    if (!analyze(0)) {
+      return { Result::ERR, error_ };
+    }
+    auto const bounds = stack_bounds(program_);
+    if (bounds.r != Result::OK) {
+      return { Result::ERR, "stack depth not bounded statically" };
+    }
+
+    std::string out;
+    out += "// Generated by sci-aot, do not edit\n";
+    out += "#include <algorithm>\n#include <limits>\n\n#include \"Kernels.h\"\n\n";
+    out += "namespace {\n";
+    out += prelude;
+    for (int const f : order_) {
+      emit_function(out, f);
+    }
+    out += "}// namespace\n\n";
+    out += "auto " + std::string{ symbol } + "() -> int\n{\n";
+    out += "  sci::Value stack[" + std::to_string(std::max<std::size_t>(bounds.comp_stack, 1)) + "]{};\n";
+    out += "  sci::Value memory[" + std::to_string(std::max<std::size_t>(bounds.memory, 1)) + "]{};\n";
+    out += "  sci::Value const* const sp{ sci_f0(stack, memory, 0) };\n";
+    out += "  if (sp == nullptr || sp == stack) {\n    return 0;\n  }\n";
+    // indexed from stack, GCC takes sp[-1] for a possible null dereference
+    std::string const top{ "stack[sp - stack - 1]" };
+    switch (program_.functions[0].return_type) {
+    case Literal::Type::INT_:
+      out += "  return " + top + ".i;\n";
+      break;
+    case Literal::Type::CHAR_:
+      out += "  return static_cast<char>(" + top + ".i);\n";
+      break;
+    case Literal::Type::DOUBLE_:
+      out += "  return sci_to_int(" + top + ".d);\n";
+      break;
+    default:
+      out += "  return 0;\n";
+      break;
+    }
+    out += "}\n";
+    return { Result::OK, std::move(out) };
+  }
+
+  [[nodiscard]] static auto header(std::string_view const symbol) -> std::string
+  {
+    return "// Generated by sci-aot, do not edit\n#pragma once\n\nauto " + std::string{ symbol } + "() -> int;\n";
+  }
+
+private:
+  // Interpreter::binary, to_int and in_frames; DDIV is plain IEEE 754 division at run time
+  static constexpr std::string_view prelude{
+    "inline auto sci_div(int const lhs, int const rhs) -> int\n"
+    "{\n"
+    "  return rhs == 0 || (rhs == -1 && lhs == std::numeric_limits<int>::min()) ? 0 : lhs / rhs;\n"
+    "}\n\n"
+    "inline auto sci_mod(int const lhs, int const rhs) -> int\n"
+    "{\n"
+    "  return rhs == 0 || rhs == -1 ? 0 : lhs % rhs;\n"
+    "}\n\n"
+    "inline auto sci_to_int(double const value) -> int\n"
+    "{\n"
+    "  if (value != value) {\n"
+    "    return 0;\n"
+    "  }\n"
+    "  if (value <= static_cast<double>(std::numeric_limits<int>::min())) {\n"
+    "    return std::numeric_limits<int>::min();\n"
+    "  }\n"
+    "  if (value >= static_cast<double>(std::numeric_limits<int>::max())) {\n"
+    "    return std::numeric_limits<int>::max();\n"
+    "  }\n"
+    "  return static_cast<int>(value);\n"
+    "}\n\n"
+    "inline auto sci_in_frames(int const address, int const count, int const end) -> bool\n"
+    "{\n"
+    "  return count <= 0 || (address >= 0 && address <= end - count);\n"
+    "}\n\n"
+  };
+
+  auto fail(std::string message) -> bool
+  {
+    error_ = std::move(message);
+    return false;
+  }
+
+  auto name(int const func) const -> std::string
+  {
+    auto const n = program_.functions[static_cast<std::size_t>(func)].name;
+    return n.empty() ? std::to_string(func) : std::string{ n };
+  }
+
+  // What cannot be translated, the jump targets and the accesses that can fail,
+  // stack_bounds checks the stack depths
+  auto analyze(int const func) -> bool
+  {
+    if (func < 0 || func >= CompiledProgram::NUM_OF_FUNC) {
+      return fail("call of an unknown function");
+    }
+    auto& info = info_[static_cast<std::size_t>(func)];
+    if (info.state == FunctionInfo::State::DONE) {
+      return true;
+    }
+    if (info.state == FunctionInfo::State::IN_PROGRESS) {
+      return fail("recursive call of " + name(func) + " is not supported");
+    }
+    info.state = FunctionInfo::State::IN_PROGRESS;
+
+    auto const& f = program_.functions[static_cast<std::size_t>(func)];
+    info.length = instruction_count(f);
+    for (int i{ 0 }; i < info.length; ++i) {
+      auto const& ins = f.instructions[static_cast<std::size_t>(i)];
+      switch (ins.type) {
+      case Instruction::Type::CALL: {
+        if (!analyze(ins.par.i)) {
+          return false;
+        }
+        info.can_fail = info.can_fail || info_[static_cast<std::size_t>(ins.par.i)].can_fail;
+        break;
+      }
+
+      case Instruction::Type::CALL_NATIVE:
+        return fail(name(func) + ": host function calls are not supported");
+
+      case Instruction::Type::LOAD_IND:
+      case Instruction::Type::STORE_IND:
+      case Instruction::Type::SUM:
+      case Instruction::Type::DSUM:
+      case Instruction::Type::DOT:
+      case Instruction::Type::DDOT:
+      case Instruction::Type::FILL:
+      case Instruction::Type::COPY:
+        info.can_fail = true;
+        break;
+
+      case Instruction::Type::JMP:
+      case Instruction::Type::JZ:
+      case Instruction::Type::JNZ:
+      case Instruction::Type::JLT:
+      case Instruction::Type::JLE:
+      case Instruction::Type::JGT:
+      case Instruction::Type::JGE:
+      case Instruction::Type::JEQ:
+      case Instruction::Type::JNE:
+        if (i + 1 + ins.par.i < 0 || i + 1 + ins.par.i >= CompiledFunction::NUM_OF_INS) {
+          return fail(name(func) + ": jump out of the function");
+        }
+        // every instruction after the last one is a NONE returning like the end
+        info.target[static_cast<std::size_t>(std::min(i + 1 + ins.par.i, info.length))] = true;
+        break;
+
+      case Instruction::Type::VAL:
+      case Instruction::Type::ADD:
+      case Instruction::Type::RET:
+      case Instruction::Type::SUB:
+      case Instruction::Type::MUL:
+      case Instruction::Type::DIV:
+      case Instruction::Type::MOD:
+      case Instruction::Type::NEG:
+      case Instruction::Type::DADD:
+      case Instruction::Type::DSUB:
+      case Instruction::Type::DMUL:
+      case Instruction::Type::DDIV:
+      case Instruction::Type::DNEG:
+      case Instruction::Type::DLT:
+      case Instruction::Type::DLE:
+      case Instruction::Type::DGT:
+      case Instruction::Type::DGE:
+      case Instruction::Type::DEQ:
+      case Instruction::Type::DNE:
+      case Instruction::Type::I2D:
+      case Instruction::Type::I2D_UNDER:
+      case Instruction::Type::D2I:
+      case Instruction::Type::I2C:
+      case Instruction::Type::LT:
+      case Instruction::Type::LE:
+      case Instruction::Type::GT:
+      case Instruction::Type::GE:
+      case Instruction::Type::EQ:
+      case Instruction::Type::NE:
+      case Instruction::Type::LOAD:
+      case Instruction::Type::STORE:
+      case Instruction::Type::POP:
+      case Instruction::Type::ADDR:
+      case Instruction::Type::DUP:
+        break;
+
+      default:
+        return fail(name(func) + ": unsupported instruction " + std::string{ to_string(ins.type) });
+      }
+    }
+    info.state = FunctionInfo::State::DONE;
+    order_.push_back(func);
+    return true;
+  }
+
+  // a double literal that reads back exactly
+  static auto double_literal(double const value) -> std::string
+  {
+    if (value != value) {
+      return "std::numeric_limits<double>::quiet_NaN()";
+    }
+    if (value == std::numeric_limits<double>::infinity() || value == -std::numeric_limits<double>::infinity()) {
+      return std::string{ value < 0.0 ? "-" : "" } + "std::numeric_limits<double>::infinity()";
+    }
+    std::array<char, 64> buffer{};
+    auto const [end, error] = std::to_chars(buffer.data(), buffer.data() + buffer.size(), value < 0.0 ? -value : value, std::chars_format::hex);
+    return std::string{ value < 0.0 ? "-0x" : "0x" } + std::string{ buffer.data(), end };
+  }
+
+  static auto int_binary(std::string_view const op) -> std::string
+  {
+    return "  --sp;\n  sp[-1].i = static_cast<int>(static_cast<unsigned>(sp[-1].i) " + std::string{ op }
+           + " static_cast<unsigned>(sp[0].i));\n";
+  }
+
+  static auto branch(std::string_view const condition, int const target) -> std::string
+  {
+    return "  if (" + std::string{ condition } + ") {\n    goto l" + std::to_string(target) + ";\n  }\n";
+  }
+
+  auto emit_function(std::string& out, int const func) const -> void
+  {
+    auto const& f = program_.functions[static_cast<std::size_t>(func)];
+    auto const& info = info_[static_cast<std::size_t>(func)];
+    out += "// " + name(func) + "\n";
+    out += "inline auto sci_f" + std::to_string(func)
+           + "(sci::Value* sp, [[maybe_unused]] sci::Value* memory, [[maybe_unused]] int const base) -> sci::Value*\n{\n";
+    out += "  [[maybe_unused]] int const end{ base + " + std::to_string(f.frame_size) + " };\n";
+    if (f.frame_size > 0) {
+      out += "  std::fill(memory + base, memory + end, sci::Value{});\n";
+    }
+
+    auto const comparison = [&](std::string_view const type, std::string_view const op) {
+      out += "  --sp;\n  sp[-1].i = sp[-1]." + std::string{ type } + " " + std::string{ op } + " sp[0]."
+             + std::string{ type } + ";\n";
+    };
+    auto const double_binary = [&](std::string_view const op) {
+      out += "  --sp;\n  sp[-1].d = sp[-1].d " + std::string{ op } + " sp[0].d;\n";
+    };
+    auto const fused = [&](std::string_view const op, int const target) {
+      out += "  sp -= 2;\n" + branch("sp[0].i " + std::string{ op } + " sp[1].i", target);
+    };
+    auto const check = [&](std::string_view const condition) {
+      out += "    if (!(" + std::string{ condition } + ")) {\n      return nullptr;\n    }\n";
+    };
+
+    for (int i{ 0 }; i < info.length; ++i) {
+      if (info.target[static_cast<std::size_t>(i)]) {
+        out += "l" + std::to_string(i) + ":\n";
+      }
+      auto const& ins = f.instructions[static_cast<std::size_t>(i)];
+      int const target{ std::min(i + 1 + ins.par.i, info.length) };
+      auto const offset = std::to_string(ins.par.i);
+      switch (ins.type) {
+      case Instruction::Type::VAL:
+        if (ins.par_type == Literal::Type::DOUBLE_) {
+          out += "  *sp++ = sci::Value{ .d = " + double_literal(ins.par.d) + " };\n";
+        } else {
+          out += "  *sp++ = sci::Value{ " + std::to_string(ins.par.i) + " };\n";
+        }
+        break;
+
+      // wrap around like the interpreter instead of overflowing
+      case Instruction::Type::ADD:
+        out += int_binary("+");
+        break;
+      case Instruction::Type::SUB:
+        out += int_binary("-");
+        break;
+      case Instruction::Type::MUL:
+        out += int_binary("*");
+        break;
+      case Instruction::Type::DIV:
+        out += "  --sp;\n  sp[-1].i = sci_div(sp[-1].i, sp[0].i);\n";
+        break;
+      case Instruction::Type::MOD:
+        out += "  --sp;\n  sp[-1].i = sci_mod(sp[-1].i, sp[0].i);\n";
+        break;
+      case Instruction::Type::NEG:
+        out += "  sp[-1].i = static_cast<int>(0U - static_cast<unsigned>(sp[-1].i));\n";
+        break;
+
+      case Instruction::Type::LT:
+        comparison("i", "<");
+        break;
+      case Instruction::Type::LE:
+        comparison("i", "<=");
+        break;
+      case Instruction::Type::GT:
+        comparison("i", ">");
+        break;
+      case Instruction::Type::GE:
+        comparison("i", ">=");
+        break;
+      case Instruction::Type::EQ:
+        comparison("i", "==");
+        break;
+      case Instruction::Type::NE:
+        comparison("i", "!=");
+        break;
+
+      case Instruction::Type::DADD:
+        double_binary("+");
+        break;
+      case Instruction::Type::DSUB:
+        double_binary("-");
+        break;
+      case Instruction::Type::DMUL:
+        double_binary("*");
+        break;
+      case Instruction::Type::DDIV:
+        double_binary("/");
+        break;
+      case Instruction::Type::DNEG:
+        out += "  sp[-1].d = -sp[-1].d;\n";
+        break;
+      case Instruction::Type::DLT:
+        comparison("d", "<");
+        break;
+      case Instruction::Type::DLE:
+        comparison("d", "<=");
+        break;
+      case Instruction::Type::DGT:
+        comparison("d", ">");
+        break;
+      case Instruction::Type::DGE:
+        comparison("d", ">=");
+        break;
+      case Instruction::Type::DEQ:
+        comparison("d", "==");
+        break;
+      case Instruction::Type::DNE:
+        comparison("d", "!=");
+        break;
+
+      case Instruction::Type::I2D:
+        out += "  sp[-1].d = sp[-1].i;\n";
+        break;
+      case Instruction::Type::I2D_UNDER:
+        out += "  sp[-2].d = sp[-2].i;\n";
+        break;
+      case Instruction::Type::D2I:
+        out += "  sp[-1].i = sci_to_int(sp[-1].d);\n";
+        break;
+      case Instruction::Type::I2C:
+        out += "  sp[-1].i = static_cast<char>(sp[-1].i);\n";
+        break;
+
+      case Instruction::Type::LOAD:
+        out += "  *sp++ = memory[base + " + offset + "];\n";
+        break;
+      case Instruction::Type::STORE:
+        out += "  memory[base + " + offset + "] = *--sp;\n";
+        break;
+      case Instruction::Type::POP:
+        out += "  --sp;\n";
+        break;
+      case Instruction::Type::ADDR:
+        out += "  *sp++ = sci::Value{ base + " + offset + " };\n";
+        break;
+      case Instruction::Type::DUP:
+        out += "  *sp = sp[-1];\n  ++sp;\n";
+        break;
+
+      // live frames only, like the interpreter
+      case Instruction::Type::LOAD_IND:
+        out += "  {\n    int const address{ (--sp)->i };\n";
+        check("address >= 0 && address < end");
+        out += "    *sp++ = memory[address];\n  }\n";
+        break;
+      case Instruction::Type::STORE_IND:
+        out += "  {\n    sci::Value const value{ *--sp };\n    int const address{ (--sp)->i };\n";
+        check("address >= 0 && address < end");
+        out += "    memory[address] = value;\n  }\n";
+        break;
+
+      case Instruction::Type::SUM:
+      case Instruction::Type::DSUM:
+        out += "  {\n    int const count{ (--sp)->i };\n    int const address{ (--sp)->i };\n";
+        check("sci_in_frames(address, count, end)");
+        out += ins.type == Instruction::Type::SUM
+                 ? "    *sp++ = sci::Value{ sci::kernels::sum(memory + (count > 0 ? address : 0), count) };\n  }\n"
+                 : "    *sp++ = sci::Value{ .d = sci::kernels::sum_double(memory + (count > 0 ? address : 0), count) };\n  }\n";
+        break;
+      case Instruction::Type::DOT:
+      case Instruction::Type::DDOT:
+        out += "  {\n    int const count{ (--sp)->i };\n    int const rhs{ (--sp)->i };\n    int const lhs{ (--sp)->i };\n";
+        check("sci_in_frames(lhs, count, end) && sci_in_frames(rhs, count, end)");
+        out += "    sci::Value const* l{ memory + (count > 0 ? lhs : 0) };\n";
+        out += "    sci::Value const* r{ memory + (count > 0 ? rhs : 0) };\n";
+        out += ins.type == Instruction::Type::DOT ? "    *sp++ = sci::Value{ sci::kernels::dot(l, r, count) };\n  }\n"
+                                                  : "    *sp++ = sci::Value{ .d = sci::kernels::dot_double(l, r, count) };\n  }\n";
+        break;
+      case Instruction::Type::FILL:
+        out += "  {\n    int const count{ (--sp)->i };\n    sci::Value const value{ *--sp };\n    int const address{ (--sp)->i };\n";
+        check("sci_in_frames(address, count, end)");
+        out += "    sci::kernels::fill(memory + (count > 0 ? address : 0), value, count);\n  }\n";
+        break;
+      case Instruction::Type::COPY:
+        out += "  {\n    int const count{ (--sp)->i };\n    int const src{ (--sp)->i };\n    int const dst{ (--sp)->i };\n";
+        check("sci_in_frames(src, count, end) && sci_in_frames(dst, count, end)");
+        out += "    sci::kernels::copy(memory + (count > 0 ? dst : 0), memory + (count > 0 ? src : 0), count);\n  }\n";
+        break;
+
+      case Instruction::Type::JMP:
+        out += "  goto l" + std::to_string(target) + ";\n";
+        break;
+      case Instruction::Type::JZ:
+        out += branch("(--sp)->i == 0", target);
+        break;
+      case Instruction::Type::JNZ:
+        out += branch("(--sp)->i != 0", target);
+        break;
+      case Instruction::Type::JLT:
+        fused("<", target);
+        break;
+      case Instruction::Type::JLE:
+        fused("<=", target);
+        break;
+      case Instruction::Type::JGT:
+        fused(">", target);
+        break;
+      case Instruction::Type::JGE:
+        fused(">=", target);
+        break;
+      case Instruction::Type::JEQ:
+        fused("==", target);
+        break;
+      case Instruction::Type::JNE:
+        fused("!=", target);
+        break;
+
+      // the callee clears its own frame, which starts where this one ends
+      case Instruction::Type::CALL:
+        out += "  sp = sci_f" + std::to_string(ins.par.i) + "(sp, memory, end);\n";
+        if (info_[static_cast<std::size_t>(ins.par.i)].can_fail) {
+          out += "  if (sp == nullptr) {\n    return nullptr;\n  }\n";
+        }
+        break;
+
+      case Instruction::Type::RET:
+        out += "  return sp;\n";
+        break;
+
+      default:
+        break;
+      }
+    }
+    if (info.target[static_cast<std::size_t>(info.length)]) {
+      out += "l" + std::to_string(info.length) + ":\n";
+    }
+    out += "  return sp;\n";
+    out += "}\n\n";
+  }
+};
+
+}// namespace sci
@@ -0,0 +1,52 @@
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <memory>
+#include <string>
+
+#include "Parser.h"
+#include "SourceCode.h"
+#include "Tokenizer.h"
+#include "Transpiler.h"
+
+// sci-aot <script> <output base> <symbol>
+// Writes <output base>.cpp defining `auto <symbol>() -> int` and <output base>.h declaring it.
+auto main(int argc, char const** argv) -> int
+{
+  constexpr std::size_t MaxTokens{ 4096 };
+
+  if (argc != 4) {
+    std::cerr << "usage: sci-aot <script> <output base> <symbol>\n";
+    return 2;
+  }
+
+  std::ifstream input{ argv[1] };
+  if (!input) {
+    std::cerr << "sci-aot: could not open " << argv[1] << '\n';
+    return 1;
+  }
+  std::string const text{ std::istreambuf_iterator<char>{ input }, std::istreambuf_iterator<char>{} };
+
+  sci::SourceCode const src{ text };
+  sci::Tokenizer<MaxTokens> const tok{ src };
+  auto const tokens = std::make_unique<sci::Tokenizer<MaxTokens>::ResultingTokens>(tok.tokenize());
+  sci::Parser<MaxTokens, 256> const par{ *tokens };
+  auto const exe = std::make_unique<sci::CompiledProgram>(par.parse());
+  if (exe->info.r != sci::Result::OK) {
+    std::cerr << "sci-aot: " << argv[1] << " does not compile\n";
+    return 1;
+  }
+
+  sci::Transpiler transpiler{ *exe };
+  auto const output = transpiler.transpile(argv[3]);
+  if (output.r != sci::Result::OK) {
+    std::cerr << argv[1] << ": " << output.text << '\n';
+    return 1;
+  }
+
+  std::string const base{ argv[2] };
+  std::ofstream{ base + ".cpp" } << "#include \"" << base.substr(base.find_last_of("/\\") + 1) << ".h\"\n\n"
+                                 << output.text;
+  std::ofstream{ base + ".h" } << sci::Transpiler::header(argv[3]);
+  return 0;
+}
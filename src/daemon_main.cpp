@@ -0,0 +1,80 @@
+#include <array>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "Server.h"
+#include "ServerSocket.h"
+
+// sci-daemon [--fuel <n>] [--time-ms <n>] [--memory <bytes>] <socket>
+//
+// Keeps scripts compiled and warm across runs: the first request for a path compiles the
+// file and runs it up to its first request() call, later ones start from there until the
+// file's modification time changes. Every connection on the Unix socket <socket> gets a
+// thread of its own, requests and replies use the binary protocol in Server.h. The
+// reply carries the run time without the compile, so a client can tell the two apart.
+namespace {
+// Answers the requests of one connection until the client closes it
+auto serve_connection(int const fd, sci::server::ScriptCache& cache) -> void
+{
+  auto context = std::make_unique<sci::server::Interpreter::Context>();
+  std::array<char, sci::server::REQUEST_HEADER_SIZE> header{};
+  std::string path;
+  while (sci::server::read_all(fd, header.data(), header.size())) {
+    auto const request = sci::server::decode_request_header(header);
+    path.resize(request.path_size);
+    if (!sci::server::read_all(fd, path.data(), path.size())) {
+      break;
+    }
+    auto const reply = sci::server::encode_reply(
+      path.empty() ? sci::server::Reply{ sci::server::Status::BAD_REQUEST } : sci::server::handle(cache, path, request.argument, *context));
+    if (!sci::server::write_all(fd, { reply.data(), reply.size() })) {
+      break;
+    }
+  }
+  ::close(fd);
+}
+}// namespace
+
+auto main(int argc, char const** argv) -> int
+{
+  sci::Limits limits;
+  std::vector<std::string_view> args(argv + 1, argv + argc);
+  std::size_t const arg{ sci::server::parse_limit_options(args, limits) };
+  if (args.size() != arg + 1) {
+    std::cerr << "usage: sci-daemon [--fuel <n>] [--time-ms <n>] [--memory <bytes>] <socket>\n";
+    return 2;
+  }
+
+  std::string const socket_path{ args[arg] };
+  int const listener{ sci::server::listen_unix("sci-daemon", socket_path) };
+  if (listener < 0) {
+    return 1;
+  }
+  sci::server::handle_stop_signals();
+
+  // the connection threads are not joined, they end with the process
+  static sci::server::ScriptCache cache{ sci::server::Interpreter{ limits } };
+  while (sci::server::stopping == 0) {
+    pollfd ready{ listener, POLLIN, 0 };
+    if (::poll(&ready, 1, 100) > 0 && (ready.revents & POLLIN) != 0) {
+      if (int const fd{ ::accept(listener, nullptr, nullptr) }; fd >= 0) {
+        std::thread{ serve_connection, fd, std::ref(cache) }.detach();
+      }
+    }
+  }
+
+  ::close(listener);
+  ::unlink(socket_path.c_str());
+  // without destroying the cache under a connection thread that is still running
+  std::quick_exit(EXIT_SUCCESS);
+}
@@ -0,0 +1,72 @@
+#include <array>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <string_view>
+
+#include "Disassembler.h"
+#include "Optimizer.h"
+#include "Parser.h"
+#include "SourceCode.h"
+#include "Tokenizer.h"
+
+// sci-dis <script>
+// Prints the bytecode the parser generates for <script>, then the program after each
+// optimizer pass that changed it, and the instruction counts per function before and
+// after optimize.
+auto main(int argc, char const** argv) -> int
+{
+  constexpr std::size_t MaxTokens{ 4096 };
+
+  if (argc != 2) {
+    std::cerr << "usage: sci-dis <script>\n";
+    return 2;
+  }
+
+  std::ifstream input{ argv[1] };
+  if (!input) {
+    std::cerr << "sci-dis: could not open " << argv[1] << '\n';
+    return 1;
+  }
+  std::string const text{ std::istreambuf_iterator<char>{ input }, std::istreambuf_iterator<char>{} };
+
+  sci::SourceCode const src{ text };
+  sci::Tokenizer<MaxTokens> const tok{ src };
+  auto const tokens = std::make_unique<sci::Tokenizer<MaxTokens>::ResultingTokens>(tok.tokenize());
+  sci::Parser<MaxTokens, 256> const par{ *tokens };
+  auto const parsed = std::make_unique<sci::CompiledProgram>(par.parse());
+  if (parsed->info.r != sci::Result::OK) {
+    std::cerr << "sci-dis: " << argv[1] << " does not compile\n";
+    return 1;
+  }
+
+  std::ostringstream listing;
+  sci::disassemble(*parsed, listing);
+  std::cout << "== parsed\n" << listing.str();
+
+  constexpr std::array passes{ std::pair{ sci::OptimizerPass::LOOPS, "loops" }, std::pair{ sci::OptimizerPass::BRANCHES, "branches" } };
+  auto optimized = std::make_unique<sci::CompiledProgram>();
+  for (auto const& [pass, name] : passes) {
+    *optimized = sci::optimize(*parsed, pass);
+    std::ostringstream after;
+    sci::disassemble(*optimized, after);
+    if (after.str() == listing.str()) {
+      std::cout << "== after " << name << ": unchanged\n";
+      continue;
+    }
+    std::cout << "== after " << name << '\n' << after.str();
+    listing = std::move(after);
+  }
+
+  std::cout << "== instructions\n";
+  for (std::size_t i{ 0 }; i < parsed->functions.size(); ++i) {
+    if (!parsed->functions[i].name.empty()) {
+      std::cout << parsed->functions[i].name << ": " << sci::instruction_count(parsed->functions[i]) << " -> "
+                << sci::instruction_count(optimized->functions[i]) << '\n';
+    }
+  }
+  return 0;
+}
@@ -1,26 +1,41 @@
 #include <algorithm>
+#include <chrono>
+#include <cstdint>
 #include <fstream>
-#include <functional>
+#include <iostream>
+#include <iterator>
 #include <memory>
+#include <numeric>
 #include <string>
-#include <unordered_map>
+#include <string_view>
+#include <variant>
 #include <vector>
 
-#include <cassert>
-#include <cctype>
+#include <cstdlib>
 
 #include <fmt/core.h>
 #include <magic_enum.hpp>
+#include <spdlog/cfg/env.h>
+#include <spdlog/spdlog.h>
 
 #define SCI_NONCONSTEXPR
+#include "Budget.h"
+#include "Disassembler.h"
 #include "Interpreter.h"
+#include "OpcodeStats.h"
+#include "Optimizer.h"
 #include "Parser.h"
 #include "SourceCode.h"
 #include "Tokenizer.h"
+#include "Trace.h"
 
-auto main(/*int argc, char const **argv*/) -> int
-{
-  constexpr sci::SourceCode src{ R"(
+// SimpleCInterpreter [--repeat <n>] [--time] [--dump-tokens] [--dump-bytecode] [<file> | -]
+//
+// Compiles the file, or stdin for `-`, and runs it --repeat times, 1 by default. Without
+// a file it runs a built-in example. --time prints the phase timings and the interpreter's
+// instructions per second to stderr, the dumps go to stdout before the run.
+namespace {
+constexpr char example[] = R"(
 int ahoj() {
    return 420;
 }
@@ -32,53 +47,209 @@ int f() {
 int main() {
    return f();
 }
-)"
+)";
+
+constexpr std::size_t MAX_TOKENS{ 4096 };
+constexpr std::size_t PARSER_STACK{ 1024 };
+using Interpreter = sci::Interpreter<256, 16384, 1024>;
+
+struct Options
+{
+  std::uint64_t repeat{ 1 };
+  bool time{ false };
+  bool dump_tokens{ false };
+  bool dump_bytecode{ false };
+  std::string_view file;
+};
+
+// counts executed instructions for --time, the timed runs go without hooks
+struct InstructionCounter : sci::ExecutionHooks
+{
+  std::uint64_t executed{ 0 };
+
+  template<typename FuncStack, typename CompStack>
+  constexpr auto on_instruction(FuncStack const& /*func_stack*/, CompStack const& /*comp_stack*/) noexcept -> void
+  {
+    ++executed;
+  }
+};
+
+auto parse_options(std::vector<std::string_view> const& args, Options& options) -> bool
+{
+  for (std::size_t i{ 0 }; i < args.size(); ++i) {
+    if (args[i] == "--repeat" && i + 1 < args.size()) {
+      options.repeat = std::strtoull(std::string{ args[++i] }.c_str(), nullptr, 10);
+    } else if (args[i] == "--time") {
+      options.time = true;
+    } else if (args[i] == "--dump-tokens") {
+      options.dump_tokens = true;
+    } else if (args[i] == "--dump-bytecode") {
+      options.dump_bytecode = true;
+    } else if (options.file.empty() && (args[i] == "-" || !args[i].starts_with("--"))) {
+      options.file = args[i];
+    } else {
+      return false;
+    }
+  }
+  return options.repeat > 0;
+}
+
+auto read_source(std::string_view const file, std::string& text) -> bool
+{
+  if (file.empty()) {
+    text = example;
+    return true;
+  }
+  if (file == "-") {
+    text.assign(std::istreambuf_iterator<char>{ std::cin }, std::istreambuf_iterator<char>{});
+    return true;
+  }
+  std::ifstream input{ std::string{ file } };
+  if (!input) {
+    return false;
+  }
+  text.assign(std::istreambuf_iterator<char>{ input }, std::istreambuf_iterator<char>{});
+  return true;
+}
+
+auto dump_tokens(sci::Tokenizer<MAX_TOKENS>::ResultingTokens const& tokens) -> void
+{
+  for (std::size_t i{ 0 }; i < tokens.size() && tokens[i].type != sci::Token::Type::EMPTY_TOKEN; ++i) {
+    fmt::print("{:5} {:20}", i, magic_enum::enum_name(tokens[i].type));
+    std::visit([](auto const& value) {
+      using T = std::decay_t<decltype(value)>;
+      if constexpr (std::is_same_v<T, sci::Token::TKW>) {
+        fmt::print(" {}", magic_enum::enum_name(value));
+      } else if constexpr (std::is_same_v<T, sci::Literal>) {
+        std::visit([](auto const& v) { fmt::print(" {}", v); }, value.val);
+      } else if constexpr (std::is_same_v<T, std::string_view>) {
+        fmt::print(" {}", value);
+      }
+    }, tokens[i].val);
+    fmt::print("\n");
+  }
+}
+}// namespace
+
+auto main(int argc, char const** argv) -> int
+{
+  Options options;
+  if (!parse_options({ argv + 1, argv + argc }, options)) {
+    fmt::print(stderr, "usage: SimpleCInterpreter [--repeat <n>] [--time] [--dump-tokens] [--dump-bytecode] [<file> | -]\n");
+    return EXIT_FAILURE;
+  }
+  std::string text;
+  if (!read_source(options.file, text)) {
+    spdlog::error("could not open {}", options.file);
+    return EXIT_FAILURE;
+  }
+  sci::SourceCode const src{ text };
+  // log levels come from SPDLOG_LEVEL, e.g. SPDLOG_LEVEL=debug prints phase timings
+  spdlog::cfg::load_env_levels();
+  char const* const trace_file = std::getenv("SCI_TRACE_FILE");
+  bool const tracing = trace_file != nullptr || spdlog::should_log(spdlog::level::debug);
+  sci::Tracer tracer;
+
+  sci::Tokenizer<MAX_TOKENS> const tok{ src };
+  auto const tokens = [&] {
+    auto const phase = tracer.phase("tokenize");
+    return std::make_unique<sci::Tokenizer<MAX_TOKENS>::ResultingTokens>(tok.tokenize());
+  }();
+  tracer.counter("tokens", std::count_if(tokens->begin(), tokens->end(), [](auto const& t) {
+    return t.type != sci::Token::Type::EMPTY_TOKEN;
+  }));
+  if (options.dump_tokens) {
+    dump_tokens(*tokens);
+  }
+
+  sci::Parser<MAX_TOKENS, PARSER_STACK> const par{ *tokens };
+  auto exe = [&] {
+    auto const phase = tracer.phase("parse");
+    return std::make_unique<sci::CompiledProgram>(par.parse());
+  }();
+  if (exe->info.r != sci::Result::OK) {
+    spdlog::error("the script does not compile");
+    return EXIT_FAILURE;
+  }
+  {
+    auto const phase = tracer.phase("optimize");
+    *exe = sci::optimize(*exe);
+  }
+  tracer.counter("instructions", std::accumulate(exe->functions.begin(), exe->functions.end(), 0, [](int sum, auto const& f) {
+    return sum + static_cast<int>(std::count_if(f.instructions.begin(), f.instructions.end(), [](auto const& ins) {
+      return ins.type != sci::Instruction::Type::NONE;
+    }));
+  }));
+  if (options.dump_bytecode) {
+    sci::disassemble(*exe, std::cout);
+  }
+
+  // one context for every repetition, start() clears what a run reads
+  Interpreter const interpreter;
+  auto context = std::make_unique<Interpreter::Context>();
+  auto const run = [&](auto& hooks) -> sci::ExecResult {
+    if (auto const r = interpreter.start(*exe, *context); r != sci::Result::OK) {
+      return { r, {}, 0, context->stats };
+    }
+    sci::Unlimited budget;
+    return interpreter.resume(*context, budget, hooks);
   };
-  sci::Tokenizer<100> tok{ src };
-
-  auto tokens = tok.tokenize();
-
-  sci::Parser<100, 100> par{ tokens };
-  auto exe = par.parse();
-  sci::Interpreter<10, 3, 10> interpreter;
-  auto result = interpreter.interpret(exe);
-  fmt::print("RESULT: {}\n", result);
-
-  //sci::SourceCode src{ "" };
-  //sci::Tokenizer tok{ &src };
-
-  //auto t = tok.getNextToken();
-
-  //fmt::print("{}", t.r == sci::Tokenizer::Result::END);
-  //  if (argc < 2) {
-  //    fmt::print("No parameter specified\n");
-  //    return 0;
-  //  }
-  //
-  //  sci::FileSourceCode src_stream{ argv[1] };
-  //  if (!src_stream.is_open()) {
-  //    fmt::print("Could not open specified source file: {}\n", argv[1]);
-  //    exit(1);
-  //  }
-  //
-  //  sci::SourceCode input_src{ &src_stream };
-  //  sci::Tokenizer tokenizer{ &input_src };
-  //
-  //  std::vector<sci::Token> const tokens_forward = tokenizer.tokenize();
-  //
-  //  for (auto const &tok : tokens_forward) {
-  //    fmt::print("{}\t\t", magic_enum::enum_name(tok.type));
-  //    if (tok.type == sci::Token::Type::ID) {
-  //      fmt::print("{}", std::get<std::string>(tok.val));
-  //    } else if (tok.type == sci::Token::Type::LITERAL) {
-  //      fmt::print("{}", std::get<int>(tok.val));
-  //    }
-  //    fmt::print("\n");
-  //  }
-  //
-  //  std::vector<sci::Token> tokens;
-  //  std::copy(std::crbegin(tokens_forward), std::crend(tokens_forward), std::back_inserter(tokens));
-  //
-  //
-  //  return 0;
+  sci::ExecResult result{ sci::Result::ERR, {}, 0 };
+#ifdef SCI_OPCODE_STATS
+  sci::OpcodeStats stats;
+#endif
+  auto const started = std::chrono::steady_clock::now();
+  {
+    auto const phase = tracer.phase("interpret");
+    for (std::uint64_t i{ 0 }; i < options.repeat; ++i) {
+#ifdef SCI_OPCODE_STATS
+      result = run(stats);
+#else
+      if (tracing) {
+        result = run(tracer);
+      } else {
+        sci::ExecutionHooks hooks;
+        result = run(hooks);
+      }
+#endif
+    }
+  }
+  auto const interpreted = std::chrono::steady_clock::now() - started;
+#ifdef SCI_OPCODE_STATS
+  std::ofstream stats_file{ "opcode_stats.json" };
+  stats.write_json(stats_file);
+#endif
+  tracer.counter("executed", tracer.instructions());
+  tracer.counter("max_func_depth", static_cast<std::int64_t>(tracer.max_func_depth()));
+  tracer.counter("max_comp_depth", static_cast<std::int64_t>(tracer.max_comp_depth()));
+
+  tracer.for_each_phase([](auto const& p) {
+    spdlog::debug("{}: {} us", p.name, std::chrono::duration_cast<std::chrono::microseconds>(p.duration).count());
+  });
+  spdlog::debug("executed {} instructions, max func_stack depth {}, max comp_stack depth {}",
+    tracer.instructions(),
+    tracer.max_func_depth(),
+    tracer.max_comp_depth());
+  if (trace_file) {
+    std::ofstream trace{ trace_file };
+    tracer.write_chrome_trace(trace);
+  }
+  if (options.time) {
+    tracer.for_each_phase([](auto const& p) {
+      fmt::print(stderr, "{:10} {:12.3f} us\n", p.name, std::chrono::duration<double, std::micro>(p.duration).count());
+    });
+    // counted in one more run, so the timed ones pay nothing for it
+    InstructionCounter counter;
+    run(counter);
+    auto const seconds = std::chrono::duration<double>(interpreted).count();
+    fmt::print(stderr, "{:10} {:12.3f} us, {} runs\n", "per run", seconds * 1e6 / static_cast<double>(options.repeat), options.repeat);
+    fmt::print(stderr, "{:10} {:12} per run, {:.3g} per second\n", "executed", counter.executed,
+      static_cast<double>(counter.executed) * static_cast<double>(options.repeat) / seconds);
+  }
+
+  if (result.r != sci::Result::OK) {
+    spdlog::error("stack overflow, underflow or memory access out of bounds in function {}", exe->functions[static_cast<std::size_t>(result.func_index)].name);
+    return EXIT_FAILURE;
+  }
+  std::visit([](auto const& value) { fmt::print("RESULT: {}\n", value); }, result.value.val);
 }
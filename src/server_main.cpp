@@ -0,0 +1,178 @@
+#include <array>
+#include <chrono>
+#include <csignal>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "Server.h"
+#include "ServerSocket.h"
+
+// sci-server [--fuel <n>] [--time-ms <n>] [--memory <bytes>] [--kill-ms <n>] <socket> <script>...
+//
+// Compiles every script once and runs it up to its first request() call, then forks a
+// worker per connection on the Unix socket <socket>. The workers share the compiled
+// scripts and their warm state copy-on-write with the server. Each line a client sends,
+// `<script> [<int argument>]` with the script named by its file name without extension,
+// is answered by one line: `OK <value>`, or LIMIT, OUT_OF_MEMORY, ERR, UNKNOWN_SCRIPT,
+// BAD_REQUEST. A worker that crashes, or spends more than --kill-ms on one request, is
+// answered for by the server with CRASHED or KILLED and the connection is closed. A
+// --kill-ms of 0 lets requests run as long as the Limits allow.
+namespace {
+// Ends the worker with SIGALRM once `after` has passed, a zero `after` disarms the timer
+auto arm_kill_timer(std::chrono::milliseconds const after) -> void
+{
+  auto const seconds = std::chrono::duration_cast<std::chrono::seconds>(after);
+  auto const micros = std::chrono::duration_cast<std::chrono::microseconds>(after - seconds);
+  itimerval timer{};
+  timer.it_value.tv_sec = seconds.count();
+  timer.it_value.tv_usec = micros.count();
+  ::setitimer(ITIMER_REAL, &timer, nullptr);
+}
+
+// Worker: answers the requests of one connection until the client closes it. Every
+// request gets `kill_after` of its own, the time the client takes between requests
+// does not count.
+[[noreturn]] auto serve_connection(int const fd,
+  std::unordered_map<std::string, sci::server::WarmScript> const& scripts,
+  std::chrono::milliseconds const kill_after) -> void
+{
+  auto context = std::make_unique<sci::server::Interpreter::Context>();
+  std::string pending;
+  std::array<char, 4096> buffer{};
+  while (true) {
+    auto const received = ::read(fd, buffer.data(), buffer.size());
+    if (received <= 0) {
+      std::_Exit(EXIT_SUCCESS);
+    }
+    pending.append(buffer.data(), static_cast<std::size_t>(received));
+    for (auto newline = pending.find('\n'); newline != std::string::npos; newline = pending.find('\n')) {
+      std::string const line{ pending.substr(0, newline) };
+      pending.erase(0, newline + 1);
+      std::string reply{ "BAD_REQUEST\n" };
+      if (auto const request = sci::server::parse_request(line)) {
+        auto const script = scripts.find(std::string{ request->script });
+        if (script == scripts.end()) {
+          reply = "UNKNOWN_SCRIPT\n";
+        } else {
+          arm_kill_timer(kill_after);
+          reply = sci::server::format_reply(script->second.serve(request->argument, *context));
+          arm_kill_timer(std::chrono::milliseconds{ 0 });
+        }
+      }
+      if (!sci::server::write_all(fd, reply)) {
+        std::_Exit(EXIT_SUCCESS);
+      }
+    }
+  }
+}
+
+}// namespace
+
+auto main(int argc, char const** argv) -> int
+{
+  sci::Limits limits;
+  std::chrono::milliseconds kill_after{ 10'000 };
+  std::vector<std::string_view> args(argv + 1, argv + argc);
+  auto const kill_option = [&kill_after](std::string_view const name, unsigned long long const value) {
+    if (name != "--kill-ms") {
+      return false;
+    }
+    kill_after = std::chrono::milliseconds{ value };
+    return true;
+  };
+  std::size_t const arg{ sci::server::parse_limit_options(args, limits, kill_option) };
+  if (args.size() < arg + 2) {
+    std::cerr << "usage: sci-server [--fuel <n>] [--time-ms <n>] [--memory <bytes>] [--kill-ms <n>] <socket> <script>...\n";
+    return 2;
+  }
+
+  std::unordered_map<std::string, sci::server::WarmScript> scripts;
+  for (std::size_t i{ arg + 1 }; i < args.size(); ++i) {
+    std::string const path{ args[i] };
+    std::ifstream input{ path };
+    if (!input) {
+      std::cerr << "sci-server: could not open " << path << '\n';
+      return 1;
+    }
+    std::string const text{ std::istreambuf_iterator<char>{ input }, std::istreambuf_iterator<char>{} };
+    auto const slash = path.find_last_of("/\\");
+    auto name = path.substr(slash == std::string::npos ? 0 : slash + 1);
+    name = name.substr(0, name.find('.'));
+    auto const [script, added] = scripts.try_emplace(name, name, text, sci::server::Interpreter{ limits });
+    if (!added || !script->second.compiled()) {
+      std::cerr << "sci-server: " << path << (added ? " does not compile\n" : " has the name of another script\n");
+      return 1;
+    }
+    std::cerr << "sci-server: " << name << (script->second.warm() ? " warm\n" : " cold\n");
+  }
+
+  std::string const socket_path{ args[arg] };
+  int const listener{ sci::server::listen_unix("sci-server", socket_path) };
+  if (listener < 0) {
+    return 1;
+  }
+  sci::server::handle_stop_signals();
+
+  std::unordered_map<pid_t, int> workers;// pid, connection
+  while (sci::server::stopping == 0) {
+    pollfd ready{ listener, POLLIN, 0 };
+    if (::poll(&ready, 1, 20) > 0 && (ready.revents & POLLIN) != 0) {
+      int const fd{ ::accept(listener, nullptr, nullptr) };
+      if (fd >= 0) {
+        pid_t const pid{ ::fork() };
+        if (pid == 0) {
+          // the other workers' connections must see EOF when their worker ends
+          ::close(listener);
+          for (auto const& [other, connection] : workers) {
+            ::close(connection);
+          }
+          serve_connection(fd, scripts, kill_after);
+        }
+        if (pid < 0) {
+          sci::server::write_all(fd, "ERR\n");
+          ::close(fd);
+        } else {
+          // kept open to answer for a worker that dies
+          workers.emplace(pid, fd);
+        }
+      }
+    }
+
+    int status{ 0 };
+    for (pid_t pid{ ::waitpid(-1, &status, WNOHANG) }; pid > 0; pid = ::waitpid(-1, &status, WNOHANG)) {
+      auto const worker = workers.find(pid);
+      if (worker == workers.end()) {
+        continue;
+      }
+      // the worker's kill timer ran out during a request
+      if (WIFSIGNALED(status) && WTERMSIG(status) == SIGALRM) {
+        sci::server::write_all(worker->second, "KILLED\n");
+      } else if (!WIFEXITED(status) || WEXITSTATUS(status) != EXIT_SUCCESS) {
+        sci::server::write_all(worker->second, "CRASHED\n");
+      }
+      ::close(worker->second);
+      workers.erase(worker);
+    }
+  }
+
+  for (auto const& [pid, fd] : workers) {
+    ::kill(pid, SIGKILL);
+    ::close(fd);
+  }
+  ::close(listener);
+  ::unlink(socket_path.c_str());
+  return 0;
+}
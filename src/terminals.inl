@@ -11,8 +11,12 @@ EQUAL,
 EXCLAMATION,
 ID,
 KWCONST,
+KWELSE,
+KWFOR,
+KWIF,
 KWRET,
 KWTYPE,
+KWWHILE,
 LEFT,
 LITERAL,
 MINUS,
@@ -0,0 +1,42 @@
+#include <catch2/catch.hpp>
+
+#include <fstream>
+#include <iterator>
+#include <string>
+
+#include "../src/Interpreter.h"
+#include "../src/Parser.h"
+#include "../src/SourceCode.h"
+#include "../src/Tokenizer.h"
+
+#include "sci_script_aot_calls.h"
+#include "sci_script_aot_loops.h"
+
+namespace {
+auto interpret(char const* path) -> int
+{
+  std::ifstream input{ path };
+  std::string const text{ std::istreambuf_iterator<char>{ input }, std::istreambuf_iterator<char>{} };
+  REQUIRE(!text.empty());
+
+  sci::SourceCode const src{ text };
+  sci::Tokenizer<400> const tok{ src };
+  auto const tokens = tok.tokenize();
+  sci::Parser<400, 100> const par{ tokens };
+  auto const exe = par.parse();
+  REQUIRE(exe.info.r == sci::Result::OK);
+  return sci::Interpreter<10, 64, 10>{}.interpret(exe);
+}
+}// namespace
+
+TEST_CASE("AOT translated script matches the interpreter", "[aot]")
+{
+  REQUIRE(sci_script_aot_calls() == 42);
+  REQUIRE(sci_script_aot_calls() == interpret(SCI_SCRIPTS_DIR "/aot_calls.c"));
+}
+
+TEST_CASE("AOT translated loops, locals and arrays match the interpreter", "[aot]")
+{
+  REQUIRE(sci_script_aot_loops() == 244);
+  REQUIRE(sci_script_aot_loops() == interpret(SCI_SCRIPTS_DIR "/aot_loops.c"));
+}
@@ -1,9 +1,14 @@
 #include <catch2/catch.hpp>
 
+#include "../src/Compile.h"
 #include "../src/Parser.h"
 #include "../src/SourceCode.h"
 #include "../src/Tokenizer.h"
 #include "../src/Interpreter.h"
+#include "../src/Native.h"
+#include "../src/OpcodeStats.h"
+#include "../src/Optimizer.h"
+#include "../src/StackBounds.h"
 
 TEST_CASE("Empty source code - constexpr", "[tokenizer]")
 {
@@ -60,7 +65,7 @@ TEST_CASE("Basic source code - constexpr", "[interpreter]")
 
   constexpr sci::Parser<100, 100> par{ tokens };
   constexpr auto exe = par.parse();
-  constexpr sci::Interpreter<10, 3, 10> interpreter;
+  constexpr sci::Interpreter<10, 64, 10> interpreter;
   constexpr auto result = interpreter.interpret(exe);
 
   // TOKEN_CHECK
@@ -100,10 +105,10 @@ int main() {
 
   constexpr auto tokens = tok.tokenize();
 
-//  constexpr sci::Parser<40, 50> par{ tokens };
-//  constexpr auto exe = par.parse();
-//  constexpr sci::Interpreter<10, 3, 10> interpreter;
-//  constexpr auto result = interpreter.interpret(exe);
+  constexpr sci::Parser<40, 50> par{ tokens };
+  constexpr auto exe = par.parse();
+  constexpr sci::Interpreter<10, 64, 10> interpreter;
+  constexpr auto result = interpreter.interpret(exe);
 
   // TOKEN CHECK
   STATIC_REQUIRE(tokens[0].type == sci::Token::Type::KWTYPE);
@@ -128,14 +133,14 @@ int main() {
   STATIC_REQUIRE(tokens[11].type == sci::Token::Type::END_OF_SOURCECODE);
 
   // PROGRAM CHECK
-//  STATIC_REQUIRE(exe.functions[0].instructions[0].type == sci::Instruction::Type::VAL);
-//  STATIC_REQUIRE(exe.functions[0].instructions[1].type == sci::Instruction::Type::VAL);
-//  STATIC_REQUIRE(exe.functions[0].instructions[2].type == sci::Instruction::Type::ADD);
-//  STATIC_REQUIRE(exe.functions[0].instructions[3].type == sci::Instruction::Type::RET);
-//  STATIC_REQUIRE(exe.functions[0].instructions[4].type == sci::Instruction::Type::NONE);
+  STATIC_REQUIRE(exe.functions[0].instructions[0].type == sci::Instruction::Type::VAL);
+  STATIC_REQUIRE(exe.functions[0].instructions[1].type == sci::Instruction::Type::VAL);
+  STATIC_REQUIRE(exe.functions[0].instructions[2].type == sci::Instruction::Type::ADD);
+  STATIC_REQUIRE(exe.functions[0].instructions[3].type == sci::Instruction::Type::RET);
+  STATIC_REQUIRE(exe.functions[0].instructions[4].type == sci::Instruction::Type::NONE);
 
-//  // INTERPRETER CHECK
-//  STATIC_REQUIRE(result == 30);
+  // INTERPRETER CHECK
+  STATIC_REQUIRE(result == 30);
 }
 
 TEST_CASE("Basic function call - constexpr", "[interpreter]")
@@ -156,7 +161,7 @@ int main() {
 
   constexpr sci::Parser<40, 50> par{ tokens };
   constexpr auto exe = par.parse();
-  constexpr sci::Interpreter<10, 3, 10> interpreter;
+  constexpr sci::Interpreter<10, 64, 10> interpreter;
   constexpr auto result = interpreter.interpret(exe);
 
   // TOKEN_CHECK
@@ -203,7 +208,620 @@ int main() {
   STATIC_REQUIRE(result == 10);
 }
 
+constexpr auto collect_opcode_stats(sci::CompiledProgram const& exe)
+{
+  sci::OpcodeStats stats;
+  sci::Interpreter<10, 64, 10>{}.interpret(exe, stats);
+  return stats;
+}
+
+TEST_CASE("Opcode statistics - constexpr", "[interpreter]")
+{
+  constexpr sci::SourceCode src{ R"(
+int g() {
+   return 3;
+}
+
+int f() {
+   return g();
+}
+
+int main() {
+   return f();
+}
+)"
+  };
+  constexpr sci::Tokenizer<40> tok{ src };
+
+  constexpr auto tokens = tok.tokenize();
+
+  constexpr sci::Parser<40, 50> par{ tokens };
+  constexpr auto exe = par.parse();
+  constexpr auto stats = collect_opcode_stats(exe);
+
+  STATIC_REQUIRE(stats.executed() == 6);
+  STATIC_REQUIRE(stats.count(sci::Instruction::Type::CALL) == 2);
+  STATIC_REQUIRE(stats.count(sci::Instruction::Type::VAL) == 1);
+  STATIC_REQUIRE(stats.count(sci::Instruction::Type::RET) == 3);
+  STATIC_REQUIRE(stats.count(sci::Instruction::Type::CALL, sci::Instruction::Type::CALL) == 1);
+  STATIC_REQUIRE(stats.count(sci::Instruction::Type::RET, sci::Instruction::Type::RET) == 2);
+  STATIC_REQUIRE(stats.max_func_depth() == 3);
+  STATIC_REQUIRE(stats.max_comp_depth() == 1);
+}
+
+TEST_CASE("Loops and fused branches - constexpr", "[interpreter]")
+{
+  constexpr sci::SourceCode src{ R"(
+int main() {
+   int s = 0;
+   for (int i = 0; i < 10; i++) {
+      s += i;
+   }
+   return s;
+}
+)"
+  };
+  constexpr sci::Tokenizer<60> tok{ src };
+
+  constexpr auto tokens = tok.tokenize();
+
+  constexpr sci::Parser<60, 50> par{ tokens };
+  constexpr auto exe = par.parse();
+  constexpr auto optimized = sci::optimize(exe);
+  constexpr sci::Interpreter<10, 64, 10> interpreter;
+
+  // PROGRAM_CHECK: i < 10 JZ at the top, the inverted condition at the bottom
+  STATIC_REQUIRE(exe.functions[0].instructions[6].type == sci::Instruction::Type::LT);
+  STATIC_REQUIRE(exe.functions[0].instructions[7].type == sci::Instruction::Type::JZ);
+  STATIC_REQUIRE(exe.functions[0].instructions[18].type == sci::Instruction::Type::LT);
+  STATIC_REQUIRE(exe.functions[0].instructions[19].type == sci::Instruction::Type::JNZ);
+  STATIC_REQUIRE(exe.functions[0].instructions[19].par.i == -12);
+
+  STATIC_REQUIRE(optimized.functions[0].instructions[6].type == sci::Instruction::Type::JGE);
+  STATIC_REQUIRE(optimized.functions[0].instructions[17].type == sci::Instruction::Type::JLT);
+  STATIC_REQUIRE(optimized.functions[0].instructions[17].par.i == -11);
+  STATIC_REQUIRE(optimized.functions[0].instructions[21].type == sci::Instruction::Type::NONE);
+
+  STATIC_REQUIRE(interpreter.interpret(exe) == 45);
+  STATIC_REQUIRE(interpreter.interpret(optimized) == 45);
+}
+
+TEST_CASE("Conditionals and while - constexpr", "[interpreter]")
+{
+  constexpr sci::SourceCode src{ R"(
+int collatz() {
+   int n = 27;
+   int steps = 0;
+   while (n != 1) {
+      if (n % 2 == 0) n = n / 2;
+      else n = 3 * n + 1;
+      steps++;
+   }
+   return steps;
+}
+
+int main() {
+   if (collatz() > 100) { return -(1 + 2) * 4; }
+   return 0;
+}
+)"
+  };
+  constexpr sci::Tokenizer<100> tok{ src };
+
+  constexpr auto tokens = tok.tokenize();
+
+  constexpr sci::Parser<100, 50> par{ tokens };
+  constexpr auto exe = par.parse();
+  constexpr sci::Interpreter<10, 64, 10> interpreter;
+
+  STATIC_REQUIRE(interpreter.interpret(exe) == -12);
+  STATIC_REQUIRE(interpreter.interpret(sci::optimize(exe)) == -12);
+}
+
+TEST_CASE("Stack overflow is an error - constexpr", "[interpreter]")
+{
+  constexpr sci::SourceCode src{ R"(
+int f() {
+   return 1+2;
+}
+
+int main() {
+   return 1+f();
+}
+)"
+  };
+  constexpr sci::Tokenizer<40> tok{ src };
+
+  constexpr auto tokens = tok.tokenize();
+
+  constexpr sci::Parser<40, 50> par{ tokens };
+  constexpr auto exe = par.parse();
+  constexpr auto bounds = sci::stack_bounds(exe);
+
+  STATIC_REQUIRE(bounds.r == sci::Result::OK);
+  STATIC_REQUIRE(bounds.func_stack == 2);
+  STATIC_REQUIRE(bounds.comp_stack == 3);
+  STATIC_REQUIRE(bounds.max_depth[1] == 2);
+  STATIC_REQUIRE(bounds.net[1] == 1);
+
+  // f needs the third slot
+  constexpr auto overflow = sci::Interpreter<10, 64, 2>{}.execute(exe);
+  STATIC_REQUIRE(overflow.r == sci::Result::ERR);
+  STATIC_REQUIRE(overflow.func_index == 1);
+  constexpr auto too_deep = sci::Interpreter<1, 64, 10>{}.execute(exe);
+  STATIC_REQUIRE(too_deep.r == sci::Result::ERR);
+  STATIC_REQUIRE(too_deep.func_index == 0);
+
+  constexpr auto result = sci::Interpreter<bounds.func_stack, bounds.memory, bounds.comp_stack, sci::StackChecks::UNCHECKED>{}.execute(exe);
+  STATIC_REQUIRE(result.r == sci::Result::OK);
+  STATIC_REQUIRE(std::get<int>(result.value.val) == 4);
+}
+
+TEST_CASE("Sizes computed from the script - constexpr", "[compile]")
+{
+  using Script = sci::Compiled<R"(
+int g() {
+   return 3;
+}
+
+int f() {
+   return 1+g();
+}
+
+int main() {
+   int s = 0;
+   for (int i = 0; i < 3; i++) s += f();
+   return s;
+}
+)">;
+
+  STATIC_REQUIRE(Script::num_of_tokens == 59);
+  STATIC_REQUIRE(Script::program.info.tokens == 59);
+  STATIC_REQUIRE(Script::parser_stack_size == Script::program.info.parser_stack);
+  STATIC_REQUIRE(Script::func_stack_size == 3);
+  STATIC_REQUIRE(Script::comp_stack_size == 3);
+  STATIC_REQUIRE(Script::program.functions[1].max_comp_depth == 1);
+  STATIC_REQUIRE(Script::program.functions[2].max_comp_depth == 2);
+  STATIC_REQUIRE(Script::program.functions[3].max_comp_depth == -1);
+  STATIC_REQUIRE(Script::run() == 12);
+
+  // the measured parser stack is enough, one less overflows
+  constexpr sci::Parser<Script::num_of_tokens, Script::parser_stack_size> exact{ Script::tokens };
+  STATIC_REQUIRE(exact.parse().info.r == sci::Result::OK);
+  constexpr sci::Parser<Script::num_of_tokens, Script::parser_stack_size - 1> smaller{ Script::tokens };
+  STATIC_REQUIRE(smaller.parse().info.r == sci::Result::ERR);
+}
+
+TEST_CASE("String literals are interned - constexpr", "[parser]")
+{
+  constexpr std::string_view text{ R"(
+void a() {
+   auto s = "hello";
+}
+
+void b() {
+   auto s = "tab\tand\"quote\"";
+}
+
+void c() {
+   auto s = "hello";
+}
+
+void main() {
+   auto s = "tab\tand\"quote\"";
+}
+)" };
+  constexpr sci::SourceCode src{ text };
+  constexpr sci::Tokenizer<60> tok{ src };
+
+  constexpr auto tokens = tok.tokenize();
+
+  constexpr sci::Parser<60, 50> par{ tokens };
+  constexpr auto exe = par.parse();
+
+  // TOKEN_CHECK: the token keeps the raw text
+  STATIC_REQUIRE(tokens[8].type == sci::Token::Type::LITERAL);
+  constexpr auto lit = std::get<sci::Literal>(tokens[8].val);
+  STATIC_REQUIRE(lit.type == sci::Literal::Type::STRING_);
+  STATIC_REQUIRE(std::get<std::string_view>(lit.val) == "hello");
+
+  // PROGRAM_CHECK
+  STATIC_REQUIRE(exe.strings.size() == 2);
+  STATIC_REQUIRE(exe.strings.get(0) == "hello");
+  STATIC_REQUIRE(exe.strings.get(0).data() == std::get<std::string_view>(lit.val).data());
+  STATIC_REQUIRE(exe.strings.get(1) == "tab\tand\"quote\"");
+  STATIC_REQUIRE(exe.functions[1].instructions[0].par.i == 0);
+  STATIC_REQUIRE(exe.functions[2].instructions[0].par.i == 1);
+  STATIC_REQUIRE(exe.functions[3].instructions[0].par.i == 0);
+  STATIC_REQUIRE(exe.functions[0].instructions[0].par.i == 1);
+
+  constexpr sci::SourceCode unclosed{ "int main() { return \"abc; }" };
+  constexpr auto unclosed_tokens = sci::Tokenizer<20>{ unclosed }.tokenize();
+  STATIC_REQUIRE(unclosed_tokens[6].type == sci::Token::Type::ERROR);
+}
+
 TEST_CASE("Parsing empty tokens - constexpr", "[parser]")
 {
 
 }
+
+TEST_CASE("Double literals - constexpr", "[tokenizer]")
+{
+  constexpr sci::SourceCode src{ "0.1 1e23 2.2250738585072014e-308 12.5E-1 7 3." };
+  constexpr sci::Tokenizer<10> tok{ src };
+
+  constexpr auto tokens = tok.tokenize();
+  STATIC_REQUIRE(std::get<sci::Literal>(tokens[0].val).type == sci::Literal::Type::DOUBLE_);
+  STATIC_REQUIRE(std::get<double>(std::get<sci::Literal>(tokens[0].val).val) == 0.1);
+  // outside of the fast path, exact
+  STATIC_REQUIRE(std::get<double>(std::get<sci::Literal>(tokens[1].val).val) == 1e23);
+  STATIC_REQUIRE(std::get<double>(std::get<sci::Literal>(tokens[2].val).val) == 2.2250738585072014e-308);
+  STATIC_REQUIRE(std::get<double>(std::get<sci::Literal>(tokens[3].val).val) == 1.25);
+  STATIC_REQUIRE(std::get<sci::Literal>(tokens[4].val).type == sci::Literal::Type::INT_);
+  STATIC_REQUIRE(std::get<double>(std::get<sci::Literal>(tokens[5].val).val) == 3.0);
+
+  STATIC_REQUIRE(sci::parse_double("4.9e-324") == 4.9e-324);
+  STATIC_REQUIRE(sci::parse_double("1.7976931348623157e308") == 1.7976931348623157e308);
+  STATIC_REQUIRE(sci::parse_double("9007199254740993") == 9007199254740992.0);
+}
+
+TEST_CASE("Double and char arithmetic - constexpr", "[interpreter]")
+{
+  constexpr sci::SourceCode src{ R"(
+double main() {
+   double x = 1.5;
+   int n = 3;
+   x = x * n + 0.25;
+   char c = 'a';
+   c += 1;
+   if (x > 4.5) x = x - c / 2;
+   return x;
+}
+)" };
+  constexpr sci::Tokenizer<60> tok{ src };
+
+  constexpr auto tokens = tok.tokenize();
+
+  constexpr sci::Parser<60, 50> par{ tokens };
+  constexpr auto exe = par.parse();
+
+  // PROGRAM_CHECK: the int operand is converted, the operation is typed
+  STATIC_REQUIRE(exe.functions[0].return_type == sci::Literal::Type::DOUBLE_);
+  STATIC_REQUIRE(exe.functions[0].instructions[4].type == sci::Instruction::Type::LOAD);
+  STATIC_REQUIRE(exe.functions[0].instructions[5].type == sci::Instruction::Type::LOAD);
+  STATIC_REQUIRE(exe.functions[0].instructions[6].type == sci::Instruction::Type::I2D);
+  STATIC_REQUIRE(exe.functions[0].instructions[7].type == sci::Instruction::Type::DMUL);
+  STATIC_REQUIRE(exe.functions[0].instructions[8].type == sci::Instruction::Type::VAL);
+  STATIC_REQUIRE(exe.functions[0].instructions[9].type == sci::Instruction::Type::DADD);
+
+  // INTERPRETER_CHECK: 1.5 * 3 + 0.25 - 'b' / 2
+  constexpr auto result = sci::Interpreter<10, 64, 10>{}.execute(exe);
+  STATIC_REQUIRE(result.value.type == sci::Literal::Type::DOUBLE_);
+  STATIC_REQUIRE(std::get<double>(result.value.val) == -44.25);
+  STATIC_REQUIRE(sci::Interpreter<10, 64, 10>{}.interpret(exe) == -44);
+
+  using Narrowing = sci::Compiled<R"(
+char main() {
+   int i = 353;
+   double d = 7.9;
+   int half = d / 2;
+   return i + half - 3;
+}
+)">;
+  constexpr auto narrowed = Narrowing::Interpreter{}.execute(Narrowing::program);
+  STATIC_REQUIRE(narrowed.value.type == sci::Literal::Type::CHAR_);
+  STATIC_REQUIRE(std::get<char>(narrowed.value.val) == 'a');
+
+  using DivisionByZero = sci::Compiled<R"(
+int main() {
+   double inf = 1 / 0.0;
+   return inf > 1e308;
+}
+)">;
+  STATIC_REQUIRE(DivisionByZero::run() == 1);
+
+  // no implicit conversion between strings and numbers, no % for doubles
+  constexpr sci::SourceCode mod_src{ "int main() { double d = 1.0; return d % 2; }" };
+  constexpr auto mod_tokens = sci::Tokenizer<30>{ mod_src }.tokenize();
+  STATIC_REQUIRE(sci::Parser<30, 50>{ mod_tokens }.parse().info.r == sci::Result::ERR);
+  constexpr sci::SourceCode str_src{ "int main() { int i = \"text\"; return i; }" };
+  constexpr auto str_tokens = sci::Tokenizer<30>{ str_src }.tokenize();
+  STATIC_REQUIRE(sci::Parser<30, 50>{ str_tokens }.parse().info.r == sci::Result::ERR);
+}
+
+TEST_CASE("Arrays and pointers - constexpr", "[interpreter]")
+{
+  using Script = sci::Compiled<R"(
+int bump() {
+   int x = 7;
+   int* q = &x;
+   *q += 3;
+   return x;
+}
+int main() {
+   int a[5];
+   for (int i = 0; i < 5; i++) a[i] = i * i;
+   int* p = a;
+   int s = 0;
+   while (p < a + 5) {
+      s += *p;
+      p++;
+   }
+   a[1] += bump();
+   return s + a[1];
+}
+)">;
+
+  // PROGRAM_CHECK: a[i] = i * i stores through the element address
+  constexpr auto const& ins = Script::program.functions[0].instructions;
+  STATIC_REQUIRE(ins[6].type == sci::Instruction::Type::ADDR);
+  STATIC_REQUIRE(ins[6].par.i == 0);
+  STATIC_REQUIRE(ins[7].type == sci::Instruction::Type::LOAD);
+  STATIC_REQUIRE(ins[7].par.i == 5);
+  STATIC_REQUIRE(ins[8].type == sci::Instruction::Type::ADD);
+  STATIC_REQUIRE(ins[12].type == sci::Instruction::Type::STORE_IND);
+  // a[1] += ... keeps the element address for the store
+  STATIC_REQUIRE(ins[49].type == sci::Instruction::Type::DUP);
+  STATIC_REQUIRE(ins[50].type == sci::Instruction::Type::LOAD_IND);
+  STATIC_REQUIRE(Script::program.functions[0].frame_size == 8);
+  STATIC_REQUIRE(Script::memory_size == 10);
+
+  // INTERPRETER_CHECK: 0 + 1 + 4 + 9 + 16, a[1] = 1 + 7 + 3
+  STATIC_REQUIRE(Script::run() == 41);
+  STATIC_REQUIRE(sci::Interpreter<10, 64, 10>{}.interpret(Script::program) == 41);
+  STATIC_REQUIRE(sci::Interpreter<10, 9, 10>{}.execute(Script::program).r == sci::Result::ERR);
+
+  // accesses outside of the live frames
+  constexpr sci::SourceCode src{ "int main() { int a[2]; int x = 1; return a[x + 2]; }" };
+  constexpr auto tokens = sci::Tokenizer<40>{ src }.tokenize();
+  constexpr auto exe = sci::Parser<40, 50>{ tokens }.parse();
+  STATIC_REQUIRE(exe.info.r == sci::Result::OK);
+  constexpr auto result = sci::Interpreter<10, 64, 10>{}.execute(exe);
+  STATIC_REQUIRE(result.r == sci::Result::ERR);
+  STATIC_REQUIRE(result.func_index == 0);
+
+  // no implicit conversions between ints and pointers or between pointer types
+  constexpr sci::SourceCode int_src{ "int main() { int* p = 5; return 0; }" };
+  constexpr auto int_tokens = sci::Tokenizer<40>{ int_src }.tokenize();
+  STATIC_REQUIRE(sci::Parser<40, 50>{ int_tokens }.parse().info.r == sci::Result::ERR);
+  constexpr sci::SourceCode ptr_src{ "int main() { double d[2]; int* p = d; return 0; }" };
+  constexpr auto ptr_tokens = sci::Tokenizer<40>{ ptr_src }.tokenize();
+  STATIC_REQUIRE(sci::Parser<40, 50>{ ptr_tokens }.parse().info.r == sci::Result::ERR);
+}
+
+namespace {
+constexpr auto clamp_to(int const value, int const high) -> int
+{
+  return value > high ? high : value;
+}
+
+constexpr auto half(double const value) noexcept -> double
+{
+  return value / 2;
+}
+
+constexpr std::array natives{ sci::native<clamp_to>("clamp_to"), sci::native<half>("half") };
+}// namespace
+
+TEST_CASE("Host functions - constexpr", "[native]")
+{
+  STATIC_REQUIRE(natives[0].arity == 2);
+  STATIC_REQUIRE(natives[0].params[1] == sci::Literal::Type::INT_);
+  STATIC_REQUIRE(natives[1].return_type == sci::Literal::Type::DOUBLE_);
+
+  using Script = sci::Compiled<R"(
+int main() {
+   int a = clamp_to(40, 30);
+   return a + half(5) + clamp_to(half(7), 2 + 1);
+}
+)", natives>;
+
+  // PROGRAM_CHECK: the arguments are pushed in order, the int converted for half
+  constexpr auto const& ins = Script::program.functions[0].instructions;
+  STATIC_REQUIRE(ins[0].type == sci::Instruction::Type::VAL);
+  STATIC_REQUIRE(ins[1].type == sci::Instruction::Type::VAL);
+  STATIC_REQUIRE(ins[2].type == sci::Instruction::Type::CALL_NATIVE);
+  STATIC_REQUIRE(ins[2].par.i == 0);
+  STATIC_REQUIRE(ins[6].type == sci::Instruction::Type::I2D);
+  STATIC_REQUIRE(ins[7].type == sci::Instruction::Type::CALL_NATIVE);
+  STATIC_REQUIRE(ins[7].par.i == 1);
+  STATIC_REQUIRE(Script::program.natives[2].call == nullptr);
+  STATIC_REQUIRE(Script::comp_stack_size == 4);
+
+  // INTERPRETER_CHECK: 30 + 2.5 + min(3, 3)
+  STATIC_REQUIRE(Script::run() == 35);
+  STATIC_REQUIRE(sci::Interpreter<10, 64, 3>{}.execute(Script::program).r == sci::Result::ERR);
+
+  // arguments have to match the signature
+  constexpr sci::SourceCode arity_src{ "int main() { return clamp_to(1); }" };
+  constexpr auto arity_tokens = sci::Tokenizer<30>{ arity_src }.tokenize();
+  STATIC_REQUIRE(sci::Parser<30, 50>{ arity_tokens, natives }.parse().info.r == sci::Result::ERR);
+  constexpr sci::SourceCode type_src{ "int main() { return half(\"1\"); }" };
+  constexpr auto type_tokens = sci::Tokenizer<30>{ type_src }.tokenize();
+  STATIC_REQUIRE(sci::Parser<30, 50>{ type_tokens, natives }.parse().info.r == sci::Result::ERR);
+  constexpr sci::SourceCode unknown_src{ "int main() { return half(1); }" };
+  constexpr auto unknown_tokens = sci::Tokenizer<30>{ unknown_src }.tokenize();
+  STATIC_REQUIRE(sci::Parser<30, 50>{ unknown_tokens }.parse().info.r == sci::Result::ERR);
+}
+
+TEST_CASE("Builtin kernels - constexpr", "[kernels]")
+{
+  using Script = sci::Compiled<R"(
+int main() {
+   int a[6];
+   double d[5];
+   __memset(a, 2, 6);
+   __memset(d, 1.5, 5);
+   a[0] = 7;
+   __memcpy(a + 3, a, 3);
+   return __sum(a, 6) + __dot(a, a + 1, 2) + __sum(d, 5);
+}
+)">;
+  constexpr auto const& ins = Script::program.functions[0].instructions;
+  STATIC_REQUIRE(ins[3].type == sci::Instruction::Type::FILL);
+  STATIC_REQUIRE(ins[7].type == sci::Instruction::Type::FILL);
+
+  // INTERPRETER_CHECK: a is 7 2 2 7 2 2, 22 + 14 + 4 + 7.5
+  STATIC_REQUIRE(Script::run() == 47);
+
+  // a source below an overlapping destination repeats like the loop would
+  using Overlap = sci::Compiled<R"(
+int main() {
+   int a[5];
+   a[0] = 3;
+   a[1] = 4;
+   __memcpy(a + 2, a, 3);
+   return a[4] * 10 + __sum(a, 0);
+}
+)">;
+  STATIC_REQUIRE(Overlap::run() == 30);
+
+  constexpr sci::SourceCode bounds_src{ "int main() { int a[2]; return __sum(a, 3); }" };
+  constexpr auto bounds_tokens = sci::Tokenizer<30>{ bounds_src }.tokenize();
+  constexpr auto bounds_exe = sci::Parser<30, 50>{ bounds_tokens }.parse();
+  STATIC_REQUIRE(bounds_exe.info.r == sci::Result::OK);
+  STATIC_REQUIRE(sci::Interpreter<10, 64, 10>{}.execute(bounds_exe).r == sci::Result::ERR);
+
+  // pointers of one type and an integral count
+  constexpr sci::SourceCode count_src{ "int main() { int a[2]; return __sum(a, 1.0); }" };
+  constexpr auto count_tokens = sci::Tokenizer<30>{ count_src }.tokenize();
+  STATIC_REQUIRE(sci::Parser<30, 50>{ count_tokens }.parse().info.r == sci::Result::ERR);
+  constexpr sci::SourceCode mixed_src{ "int main() { int a[2]; double d[2]; __memcpy(a, d, 2); return 0; }" };
+  constexpr auto mixed_tokens = sci::Tokenizer<40>{ mixed_src }.tokenize();
+  STATIC_REQUIRE(sci::Parser<40, 50>{ mixed_tokens }.parse().info.r == sci::Result::ERR);
+}
+
+TEST_CASE("Counted loops become kernels - constexpr", "[optimizer]")
+{
+  using Script = sci::Compiled<R"(
+int main() {
+   int a[8];
+   int n = 8;
+   for (int i = 0; i < n; i++) a[i] = i;
+   int s = 0;
+   int i = 2;
+   while (i < n) {
+      s += a[i] * a[i];
+      i++;
+   }
+   return s;
+}
+)">;
+  constexpr auto optimized = sci::optimize(Script::program);
+  constexpr auto const& ins = optimized.functions[0].instructions;
+  // the fill loop stores i, not a constant, and stays
+  STATIC_REQUIRE(std::none_of(ins.begin(), ins.end(), [](auto const& i) { return i.type == sci::Instruction::Type::FILL; }));
+  STATIC_REQUIRE(std::count_if(ins.begin(), ins.end(), [](auto const& i) { return i.type == sci::Instruction::Type::DOT; }) == 1);
+  STATIC_REQUIRE(std::count_if(ins.begin(), ins.end(), [](auto const& i) { return i.type == sci::Instruction::Type::JLT; }) == 1);
+
+  // INTERPRETER_CHECK: 4 + 9 + ... + 49
+  STATIC_REQUIRE(Script::run() == 139);
+  STATIC_REQUIRE(Script::Interpreter{}.interpret(optimized) == 139);
+  STATIC_REQUIRE(optimized.info.comp_stack <= Script::comp_stack_size);
+}
+
+TEST_CASE("Resuming in slices - constexpr", "[interpreter]")
+{
+  using Script = sci::Compiled<R"(
+int main() {
+   int s = 0;
+   for (int i = 0; i < 10; i++) s += i;
+   return s;
+}
+)">;
+  // runs with slices of `slice` instructions, returns the result and the number of resumes
+  constexpr auto in_slices = [](std::uint64_t const slice) {
+    Script::Interpreter const interpreter;
+    Script::Interpreter::Context context;
+    interpreter.start(Script::program, context);
+    sci::ExecResult result;
+    int resumes{ 0 };
+    do {
+      sci::InstructionBudget budget{ slice };
+      result = interpreter.resume(context, budget);
+      ++resumes;
+    } while (result.r == sci::Result::SUSPENDED);
+    return std::pair{ result, resumes };
+  };
+
+  constexpr auto whole = in_slices(1000);
+  STATIC_REQUIRE(whole.first.r == sci::Result::OK);
+  STATIC_REQUIRE(std::get<int>(whole.first.value.val) == 45);
+  STATIC_REQUIRE(whole.second == 1);
+
+  constexpr auto sliced = in_slices(7);
+  STATIC_REQUIRE(sliced.first.r == sci::Result::OK);
+  STATIC_REQUIRE(std::get<int>(sliced.first.value.val) == 45);
+  STATIC_REQUIRE(sliced.second > 5);
+
+  constexpr auto stopped = [] {
+    Script::Interpreter const interpreter;
+    Script::Interpreter::Context context;
+    interpreter.start(Script::program, context);
+    sci::InstructionBudget budget{ 3 };
+    auto const result = interpreter.resume(context, budget);
+    return std::pair{ result.r, context.func_stack.top_unchecked().next_ins_ptr - &Script::program.functions[0].instructions[0] };
+  }();
+  STATIC_REQUIRE(stopped.first == sci::Result::SUSPENDED);
+  STATIC_REQUIRE(stopped.second == 3);
+}
+
+TEST_CASE("Fuel limits - constexpr", "[interpreter]")
+{
+  using Script = sci::Compiled<R"(
+int f() {
+   int s = 0;
+   for (int i = 0; i < 4; i++) s += i;
+   return s;
+}
+
+int main() {
+   int s = f();
+   for (int i = 0; i < 6; i++) s += i;
+   return s;
+}
+)">;
+  // INTERPRETER_CHECK: fuel is taken by the call and the 3 + 5 loop back edges
+  STATIC_REQUIRE(Script::run() == 21);
+  constexpr auto enough = Script::Interpreter{ sci::Limits{ .fuel = 9 } }.execute(Script::program);
+  STATIC_REQUIRE(enough.r == sci::Result::OK);
+  STATIC_REQUIRE(std::get<int>(enough.value.val) == 21);
+  constexpr auto short_of_one = Script::Interpreter{ sci::Limits{ .fuel = 8 } }.execute(Script::program);
+  STATIC_REQUIRE(short_of_one.r == sci::Result::LIMIT);
+  STATIC_REQUIRE(short_of_one.func_index == 0);
+  constexpr auto in_f = Script::Interpreter{ sci::Limits{ .fuel = 3 } }.execute(Script::program);
+  STATIC_REQUIRE(in_f.r == sci::Result::LIMIT);
+  STATIC_REQUIRE(in_f.func_index == 1);
+}
+
+TEST_CASE("Memory quota and statistics - constexpr", "[interpreter]")
+{
+  using Script = sci::Compiled<R"(
+int f() {
+   int a[6];
+   a[5] = 3;
+   return a[5];
+}
+
+int main() {
+   int x = f();
+   return x + f();
+}
+)">;
+  constexpr auto value_size = sizeof(sci::Value);
+  // main takes 1 Value, each call of f 6 more behind it
+  constexpr auto result = Script::Interpreter{}.execute(Script::program);
+  STATIC_REQUIRE(std::get<int>(result.value.val) == 6);
+  STATIC_REQUIRE(result.memory.peak_bytes == 7 * value_size);
+  STATIC_REQUIRE(result.memory.total_bytes == 13 * value_size);
+  STATIC_REQUIRE(result.memory.reserved_bytes == sizeof(Script::Interpreter::Context));
+
+  constexpr auto fits = Script::Interpreter{ sci::Limits{ .memory = 7 * value_size } }.execute(Script::program);
+  STATIC_REQUIRE(fits.r == sci::Result::OK);
+  constexpr auto over = Script::Interpreter{ sci::Limits{ .memory = 7 * value_size - 1 } }.execute(Script::program);
+  STATIC_REQUIRE(over.r == sci::Result::OUT_OF_MEMORY);
+  STATIC_REQUIRE(over.func_index == 0);
+  STATIC_REQUIRE(over.memory.peak_bytes == value_size);
+  constexpr auto no_main = Script::Interpreter{ sci::Limits{ .memory = 0 } }.execute(Script::program);
+  STATIC_REQUIRE(no_main.r == sci::Result::OUT_OF_MEMORY);
+}
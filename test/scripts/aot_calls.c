@@ -0,0 +1,11 @@
+int leaf() {
+   return 20;
+}
+
+int twice() {
+   return leaf()+leaf();
+}
+
+int main() {
+   return twice()+2;
+}
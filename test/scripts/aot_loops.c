@@ -0,0 +1,32 @@
+int squares() {
+   int a[10];
+   for (int i = 0; i < 10; i++) {
+      if (i % 3 == 0)
+         a[i] = i * i;
+      else
+         a[i] = -i;
+   }
+   int* p = a;
+   int total = 0;
+   while (p < a + 10) {
+      total += *p;
+      p++;
+   }
+   return total;
+}
+
+double scale() {
+   double h = 10.0;
+   int n = 0;
+   while (n < 3) {
+      h = h / 2;
+      n++;
+   }
+   return h;
+}
+
+int main() {
+   int s = squares() + squares();
+   double d = scale() * s;
+   return d - 7 / 2;
+}
@@ -0,0 +1,7 @@
+int main()
+{
+  int s = request();
+  while (s >= 0)
+    s = s * 1;
+  return s;
+}
@@ -0,0 +1,125 @@
+#include <catch2/catch.hpp>
+
+#include <array>
+#include <chrono>
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace {
+// sci-server on a socket of its own, stopped when it goes out of scope
+class Server
+{
+public:
+  explicit Server(std::string socket_path) : socket_path_{ std::move(socket_path) }
+  {
+    pid_ = ::fork();
+    if (pid_ == 0) {
+      ::execl(SCI_SERVER,
+        SCI_SERVER,
+        "--kill-ms",
+        "200",
+        socket_path_.c_str(),
+        SCI_SCRIPTS_DIR "/spin.c",
+        static_cast<char*>(nullptr));
+      std::_Exit(127);
+    }
+  }
+  Server(Server const&) = delete;
+  Server(Server&&) = delete;
+  auto operator=(Server const&) -> Server& = delete;
+  auto operator=(Server&&) -> Server& = delete;
+  ~Server()
+  {
+    if (pid_ > 0) {
+      ::kill(pid_, SIGTERM);
+      ::waitpid(pid_, nullptr, 0);
+    }
+  }
+
+  // A connected client socket, -1 when the server does not come up
+  [[nodiscard]] auto connect() const -> int
+  {
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    std::memcpy(address.sun_path, socket_path_.c_str(), socket_path_.size() + 1);
+    for (int attempt{ 0 }; attempt < 200; ++attempt) {
+      int const fd{ ::socket(AF_UNIX, SOCK_STREAM, 0) };
+      if (::connect(fd, reinterpret_cast<sockaddr const*>(&address), sizeof(address)) == 0) {
+        return fd;
+      }
+      ::close(fd);
+      std::this_thread::sleep_for(std::chrono::milliseconds{ 20 });
+    }
+    return -1;
+  }
+
+private:
+  std::string socket_path_;
+  pid_t pid_{ -1 };
+};
+
+auto send(int const fd, std::string_view const text) -> bool
+{
+  return ::write(fd, text.data(), text.size()) == static_cast<ssize_t>(text.size());
+}
+
+// What the server sends until it closes the connection, or "TIMEOUT" if it does not
+auto receive_until_eof(int const fd) -> std::string
+{
+  std::string received;
+  std::array<char, 256> buffer{};
+  while (true) {
+    pollfd ready{ fd, POLLIN, 0 };
+    if (::poll(&ready, 1, 5000) <= 0) {
+      return received + "TIMEOUT";
+    }
+    auto const n = ::read(fd, buffer.data(), buffer.size());
+    if (n <= 0) {
+      return received;
+    }
+    received.append(buffer.data(), static_cast<std::size_t>(n));
+  }
+}
+
+auto receive_line(int const fd) -> std::string
+{
+  std::string received;
+  char c{ 0 };
+  while (::read(fd, &c, 1) == 1 && c != '\n') {
+    received += c;
+  }
+  return received;
+}
+}// namespace
+
+TEST_CASE("A killed worker's client sees EOF while other workers run", "[server]")
+{
+  Server const server{ "/tmp/sci_server_tests." + std::to_string(::getpid()) + ".sock" };
+  int const a{ server.connect() };
+  REQUIRE(a >= 0);
+  int const b{ server.connect() };
+  REQUIRE(b >= 0);
+
+  // b's worker is forked after a's connection was accepted
+  REQUIRE(send(b, "spin -1\n"));
+  REQUIRE(receive_line(b) == "OK -1");
+
+  REQUIRE(send(a, "spin 1\n"));
+  REQUIRE(receive_until_eof(a) == "KILLED\n");
+
+  REQUIRE(send(b, "spin -2\n"));
+  REQUIRE(receive_line(b) == "OK -2");
+  ::close(a);
+  ::close(b);
+}
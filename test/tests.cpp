@@ -1,7 +1,37 @@
 #include <catch2/catch.hpp>
 
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <limits>
+#include <random>
+#include <span>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../src/Disassembler.h"
+#include "../src/FloatParsing.h"
+#include "../src/Interpreter.h"
+#include "../src/Jit.h"
+#include "../src/Kernels.h"
+#include "../src/Native.h"
+#include "../src/Optimizer.h"
+#include "../src/Parser.h"
+#include "../src/Profiler.h"
+#include "../src/Scheduler.h"
+#include "../src/Server.h"
+#include "../src/Snapshot.h"
 #include "../src/SourceCode.h"
+#include "../src/StackBounds.h"
+#include "../src/Tiered.h"
 #include "../src/Tokenizer.h"
+#include "../src/Trace.h"
+#include "../src/Transpiler.h"
 
 TEST_CASE("Empty source code", "[tokenizer]")
 {
@@ -33,3 +63,665 @@ TEST_CASE("Basic source code", "[interpreter]")
 //  REQUIRE(tokens[7].type == sci::Token::Type::SEMICOLON);
 //  REQUIRE(tokens[8].type == sci::Token::Type::CLOSE_CURLY);
 }
+
+TEST_CASE("Sampling profiler counts every instruction", "[profiler]")
+{
+  sci::SourceCode const src{ R"(
+int f() {
+   return 10;
+}
+
+int main() {
+   return f();
+}
+)" };
+  sci::Tokenizer<40> const tok{ src };
+  auto const tokens = tok.tokenize();
+  sci::Parser<40, 50> const par{ tokens };
+  auto const exe = par.parse();
+
+  sci::Interpreter<10, 64, 10> const interpreter;
+  sci::SamplingProfiler profiler{ exe };
+  REQUIRE(interpreter.interpret(exe, profiler) == 10);
+
+  // main: CALL, RET; f: VAL, RET
+  REQUIRE(profiler.samples() == 4);
+  REQUIRE(profiler.function_samples()[0] == 2);
+  REQUIRE(profiler.function_samples()[1] == 2);
+  REQUIRE(profiler.instruction_samples()[1][0] == 1);
+  REQUIRE(profiler.instruction_samples()[1][1] == 1);
+
+  std::ostringstream collapsed;
+  profiler.write_collapsed(collapsed);
+  REQUIRE(collapsed.str() == "main 2\nmain;f 2\n");
+}
+
+TEST_CASE("Tracer records phases and interpreter high-water marks", "[trace]")
+{
+  sci::SourceCode const src{ "int f() { return 1; } int main() { return f(); }" };
+  sci::Tokenizer<40> const tok{ src };
+  auto const tokens = tok.tokenize();
+  sci::Parser<40, 50> const par{ tokens };
+  auto const exe = par.parse();
+
+  sci::Tracer<4> tracer;
+  {
+    auto const phase = tracer.phase("interpret");
+    REQUIRE(sci::Interpreter<10, 64, 10>{}.interpret(exe, tracer) == 1);
+  }
+  tracer.counter("executed", tracer.instructions());
+
+  REQUIRE(tracer.instructions() == 4);
+  REQUIRE(tracer.max_func_depth() == 2);
+  REQUIRE(tracer.max_comp_depth() == 1);
+
+  int phases{ 0 };
+  tracer.for_each_phase([&phases](auto const& p) {
+    REQUIRE(p.name == "interpret");
+    ++phases;
+  });
+  REQUIRE(phases == 1);
+
+  std::ostringstream trace;
+  tracer.write_chrome_trace(trace);
+  REQUIRE(trace.str().find(R"("name":"interpret","ph":"B")") != std::string::npos);
+  REQUIRE(trace.str().find(R"("args":{"executed":4})") != std::string::npos);
+
+  // ring buffer keeps the newest events
+  tracer.counter("a", 1);
+  tracer.counter("b", 2);
+  REQUIRE(tracer.dropped() == 1);
+}
+
+namespace {
+template<std::size_t MaxTokens = 100>
+auto compile(std::string_view const text, std::span<sci::NativeFunction const> const natives = {}) -> sci::CompiledProgram
+{
+  sci::SourceCode const src{ text };
+  sci::Tokenizer<MaxTokens> const tok{ src };
+  auto const tokens = tok.tokenize();
+  sci::Parser<MaxTokens, 100> const par{ tokens, natives };
+  return par.parse();
+}
+}// namespace
+
+TEST_CASE("JIT matches the interpreter", "[jit]")
+{
+  auto const source = GENERATE(
+    "int main() { return 88; }",
+    "int main() { return 17+13; }",
+    "int main() { return 1+2+3+4+5+6+7+8+9+10; }",
+    "int f() { return 10; } int main() { return f(); }",
+    "int g() { return 5; } int f() { return g()+g()+1; } int main() { return f()+f(); }",
+    "int f() { return 2147483647; } int main() { return f()+1; }",
+    "int f() { int a[10]; return 1; } int main() { return f(); }");
+  CAPTURE(source);
+  auto const exe = compile(source);
+
+  sci::JitInterpreter<10, 64, 10> const jit{ exe };
+#if SCI_JIT_AVAILABLE
+  REQUIRE(jit.compiled());
+#endif
+  REQUIRE(jit.interpret() == sci::Interpreter<10, 64, 10>{}.interpret(exe));
+}
+
+TEST_CASE("JIT falls back to the interpreter", "[jit]")
+{
+  // char literal, too deep for the func_stack, too deep for the comp_stack, frames too large for the memory
+  auto const source = GENERATE(
+    "int main() { return 'a'; }",
+    "int c() { return 1; } int b() { return c(); } int a() { return b(); } int main() { return a(); }",
+    "int f() { return 1+2; } int main() { return 1+f(); }",
+    "int f() { int a[100]; return 1; } int main() { return f(); }",
+    "int g() { int a[40]; return 1; } int f() { int b[40]; return g(); } int main() { return f(); }");
+  CAPTURE(source);
+  auto const exe = compile(source);
+
+  sci::JitInterpreter<3, 64, 2> const jit{ exe };
+  REQUIRE_FALSE(jit.compiled());
+  REQUIRE(jit.interpret() == sci::Interpreter<3, 64, 2>{}.interpret(exe));
+}
+
+TEST_CASE("Hot functions are promoted to native code", "[tiered]")
+{
+  auto const exe = compile("int g() { return 'g'; } int f() { return 40+2; } int main() { return f()+g(); }");
+  sci::Interpreter<10, 64, 10> const interpreter;
+  auto const expected = interpreter.interpret(exe);
+
+  sci::TieredExecution<10, 10> tiers{ exe, 3 };
+  for (int run{ 0 }; run < 5; ++run) {
+    REQUIRE(interpreter.interpret(exe, tiers) == expected);
+    // f (index 2) is promoted on its third call, g (index 1) holds a char literal the JIT does not take
+    REQUIRE(tiers.promoted(2) == (run >= 2));
+    REQUIRE_FALSE(tiers.promoted(1));
+  }
+  REQUIRE(tiers.calls(2) == 3);
+  REQUIRE(tiers.calls(1) == 3);
+}
+
+TEST_CASE("Promoted functions keep the memory limits", "[tiered]")
+{
+  // f's own frame is too large, f is frameless but its callee g is not
+  auto const direct = compile("int f() { int a[100]; return 1; } int main() { return f(); }");
+  auto const nested = compile("int g() { int a[4]; return 1; } int f() { return g(); } int main() { return f(); }");
+
+  sci::TieredExecution<10, 10> direct_tiers{ direct, 1 };
+  REQUIRE(sci::Interpreter<10, 64, 10>{}.execute(direct, direct_tiers).r == sci::Result::ERR);
+  REQUIRE(sci::Interpreter<10, 1024, 10>{ sci::Limits{ .memory = 16 } }.execute(direct, direct_tiers).r == sci::Result::OUT_OF_MEMORY);
+
+  sci::TieredExecution<10, 10> nested_tiers{ nested, 1 };
+  REQUIRE(sci::Interpreter<10, 2, 10>{}.execute(nested, nested_tiers).r == sci::Result::ERR);
+  REQUIRE(sci::Interpreter<10, 1024, 10>{ sci::Limits{ .memory = 16 } }.execute(nested, nested_tiers).r == sci::Result::OUT_OF_MEMORY);
+  REQUIRE(sci::Interpreter<10, 64, 10>{}.interpret(nested, nested_tiers) == 1);
+  REQUIRE_FALSE(nested_tiers.promoted(2));
+}
+
+TEST_CASE("Promoted functions take fuel for their calls", "[tiered]")
+{
+  // 10 calls of f with two calls of g each and 9 loop back edges take 39 fuel
+  auto const exe = compile(
+    "int g() { return 1; } int f() { return g()+g(); } int main() { int s = 0; for (int i = 0; i < 10; i++) s += f(); return s; }");
+  auto const fuel = GENERATE(std::uint64_t{ 38 }, std::uint64_t{ 39 });
+  CAPTURE(fuel);
+  sci::Interpreter<10, 64, 10> const interpreter{ sci::Limits{ .fuel = fuel } };
+  auto const expected = interpreter.execute(exe);
+
+  sci::TieredExecution<10, 10> tiers{ exe, 1 };
+  auto const result = interpreter.execute(exe, tiers);
+  REQUIRE(result.r == expected.r);
+  REQUIRE(result.value.val == expected.value.val);
+#if SCI_JIT_AVAILABLE
+  REQUIRE(tiers.promoted(2));
+#endif
+}
+
+TEST_CASE("Recursion has no stack bound", "[interpreter]")
+{
+  auto const exe = compile("int main() { int n = 1; return main() + n; }");
+  REQUIRE(sci::stack_bounds(exe).r == sci::Result::ERR);
+
+  auto const result = sci::Interpreter<10, 64, 10>{}.execute(exe);
+  REQUIRE(result.r == sci::Result::ERR);
+  REQUIRE(result.func_index == 0);
+}
+
+TEST_CASE("Stack bounds hold across loops", "[interpreter]")
+{
+  auto const exe = sci::optimize(compile("int f() { return 2; } int main() { int s = 0; while (s < 10) s = s + f(); return s; }"));
+  auto const bounds = sci::stack_bounds(exe);
+  REQUIRE(bounds.r == sci::Result::OK);
+  REQUIRE(bounds.comp_stack == 2);
+  REQUIRE(bounds.func_stack == 2);
+  REQUIRE(bounds.memory == 1);
+  REQUIRE(sci::Interpreter<2, 1, 2, sci::StackChecks::UNCHECKED>{}.interpret(exe) == 10);
+}
+
+TEST_CASE("Transpiler emits a C++ function per script function", "[aot]")
+{
+  auto const exe = compile("int f() { return 'a'+1; } int main() { return f(); }");
+  sci::Transpiler transpiler{ exe };
+  auto const output = transpiler.transpile("run_script");
+
+  REQUIRE(output.r == sci::Result::OK);
+  REQUIRE(output.text.find("inline auto sci_f1(sci::Value* sp,") != std::string::npos);
+  REQUIRE(output.text.find("*sp++ = sci::Value{ 97 };") != std::string::npos);
+  REQUIRE(output.text.find("auto run_script() -> int") != std::string::npos);
+  REQUIRE(output.text.find("return stack[sp - stack - 1].i;") != std::string::npos);
+}
+
+TEST_CASE("Transpiler turns jumps into gotos and locals into frame memory", "[aot]")
+{
+  auto const exe = compile("int main() { int s = 0; while (s < 10) s = s + 3; return s; }");
+  sci::Transpiler transpiler{ exe };
+  auto const output = transpiler.transpile("run_script");
+
+  REQUIRE(output.r == sci::Result::OK);
+  REQUIRE(output.text.find("goto l") != std::string::npos);
+  REQUIRE(output.text.find("memory[base + 0] = *--sp;") != std::string::npos);
+  REQUIRE(output.text.find("sci::Value memory[1]{};") != std::string::npos);
+}
+
+TEST_CASE("Transpiler rejects recursion", "[aot]")
+{
+  auto const exe = compile("int main() { return main(); }");
+  sci::Transpiler transpiler{ exe };
+  auto const output = transpiler.transpile("run_script");
+
+  REQUIRE(output.r == sci::Result::ERR);
+  REQUIRE(output.text == "recursive call of main is not supported");
+}
+
+TEST_CASE("Double literals round like strtod", "[tokenizer]")
+{
+  std::mt19937_64 rng{ 38 };
+  std::uniform_int_distribution<int> exponent{ -330, 310 };
+  std::uniform_int_distribution<int> digits{ 1, 25 };
+  for (int i{ 0 }; i < 20000; ++i) {
+    std::string text;
+    int const n{ digits(rng) };
+    for (int d{ 0 }; d < n; ++d) {
+      text += static_cast<char>('0' + rng() % 10);
+      if (d == 0 && n > 1) {
+        text += '.';
+      }
+    }
+    text += 'e' + std::to_string(exponent(rng));
+    INFO(text);
+    REQUIRE(sci::parse_double(text) == std::strtod(text.c_str(), nullptr));
+  }
+
+  // a tie in the first 100 digits that a later digit breaks
+  std::string const long_tie{ "9007199254740993." + std::string(100, '0') + "1" };
+  REQUIRE(sci::parse_double(long_tie) == std::strtod(long_tie.c_str(), nullptr));
+  REQUIRE(sci::parse_double(long_tie) == 9007199254740994.0);
+}
+
+TEST_CASE("Frames share one memory segment", "[interpreter]")
+{
+  auto const exe = compile(R"(
+int fill() {
+   double d[4];
+   for (int i = 0; i < 4; i++) d[i] = i * 0.5;
+   return d[3] * 2;
+}
+int main() {
+   int a = fill();
+   return a + fill();
+}
+)");
+  auto const bounds = sci::stack_bounds(exe);
+  REQUIRE(bounds.r == sci::Result::OK);
+  REQUIRE(bounds.memory == 6);
+  REQUIRE(bounds.comp_stack == 4);
+  REQUIRE(sci::Interpreter<2, 6, 4, sci::StackChecks::UNCHECKED>{}.interpret(exe) == 6);
+
+  auto const result = sci::Interpreter<2, 5, 4>{}.execute(exe);
+  REQUIRE(result.r == sci::Result::ERR);
+  REQUIRE(result.func_index == 0);
+}
+
+namespace {
+std::string host_output;
+
+auto put(char const c) -> void
+{
+  host_output += c;
+}
+
+auto root(double const x) -> double
+{
+  return std::sqrt(x);
+}
+}// namespace
+
+TEST_CASE("Scripts call host functions", "[native]")
+{
+  host_output.clear();
+  std::array const natives{
+    sci::native<put>("put"),
+    sci::native<root>("sqrt"),
+  };
+  auto const exe = compile(R"(
+int main() {
+   for (int i = 0; i < 3; i++) put('a' + i);
+   put('!');
+   return sqrt(2.0) * 1000;
+}
+)", natives);
+  REQUIRE(exe.info.r == sci::Result::OK);
+  REQUIRE(sci::Interpreter<10, 64, 10>{}.interpret(exe) == 1414);
+  REQUIRE(host_output == "abc!");
+
+  // the void call leaves nothing to return
+  REQUIRE(compile("int main() { return put('x'); }", natives).info.r == sci::Result::ERR);
+}
+
+TEST_CASE("Vector kernels match element by element loops", "[kernels]")
+{
+  std::mt19937 rng{ 41 };
+  std::uniform_int_distribution<int> ints{ std::numeric_limits<int>::min(), std::numeric_limits<int>::max() };
+  std::uniform_real_distribution<double> doubles{ -1e6, 1e6 };
+  for (int count{ 0 }; count < 40; ++count) {
+    CAPTURE(count);
+    std::vector<sci::Value> a(static_cast<std::size_t>(count) + 1);
+    std::vector<sci::Value> b(a.size());
+    std::vector<sci::Value> x(a.size());
+    std::vector<sci::Value> y(a.size());
+    unsigned sum{ 0 };
+    unsigned dot{ 0 };
+    for (std::size_t i{ 0 }; i < a.size(); ++i) {
+      // the high halves of int Values hold whatever was stored before
+      x[i].d = doubles(rng);
+      y[i].d = doubles(rng);
+      a[i].d = x[i].d;
+      b[i].d = y[i].d;
+      a[i].i = ints(rng);
+      b[i].i = ints(rng);
+      if (i < static_cast<std::size_t>(count)) {
+        sum += static_cast<unsigned>(a[i].i);
+        dot += static_cast<unsigned>(a[i].i) * static_cast<unsigned>(b[i].i);
+      }
+    }
+    REQUIRE(sci::kernels::sum(a.data(), count) == static_cast<int>(sum));
+    REQUIRE(sci::kernels::dot(a.data(), b.data(), count) == static_cast<int>(dot));
+
+    std::array<double, 4> lanes{};
+    int i{ 0 };
+    for (; i + 4 <= count; i += 4) {
+      for (int lane{ 0 }; lane < 4; ++lane) {
+        lanes[static_cast<std::size_t>(lane)] += x[static_cast<std::size_t>(i + lane)].d * y[static_cast<std::size_t>(i + lane)].d;
+      }
+    }
+    double expected{ (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]) };
+    for (; i < count; ++i) {
+      expected += x[static_cast<std::size_t>(i)].d * y[static_cast<std::size_t>(i)].d;
+    }
+    REQUIRE(sci::kernels::dot_double(x.data(), y.data(), count) == expected);
+
+    sci::kernels::fill(b.data(), { 5 }, count);
+    REQUIRE(std::all_of(b.begin(), b.begin() + count, [](auto const& v) { return v.i == 5; }));
+    sci::kernels::copy(a.data() + 1, a.data(), count);
+    REQUIRE(std::all_of(a.begin(), a.end(), [&a](auto const& v) { return v.i == a[0].i; }));
+  }
+}
+
+TEST_CASE("Optimized array loops keep their results", "[optimizer]")
+{
+  auto const source = GENERATE(
+    "int main() { int a[9]; int n = 9; for (int i = 0; i < n; i++) a[i] = i * 7 - 20; int s = 3; for (int i = 0; i < n; i++) s += a[i]; return s; }",
+    "int main() { int a[9]; for (int i = 0; i < 9; i++) a[i] = 2147483647 - i; int s = 0; for (int i = 1; i < 9; i++) s += a[i] * a[i]; return s; }",
+    "int main() { int a[9]; int b[9]; for (int i = 0; i < 9; i++) a[i] = 4; for (int i = 3; i < 9; i++) b[i] = a[i]; return b[8] + b[0] + a[0]; }",
+    "int main() { char c[9]; int n = 0; for (int i = 0; i < n; i++) c[i] = 'x'; for (int i = 0; i < 9; i++) c[i] = 'y'; return c[8] + n; }");
+  CAPTURE(source);
+  auto const exe = compile(source);
+  auto const optimized = sci::optimize(exe);
+  REQUIRE(exe.info.r == sci::Result::OK);
+  auto const plain = sci::Interpreter<10, 64, 10>{}.execute(exe);
+  auto const fast = sci::Interpreter<10, 64, 10>{}.execute(optimized);
+  REQUIRE(fast.r == sci::Result::OK);
+  REQUIRE(std::get<int>(fast.value.val) == std::get<int>(plain.value.val));
+}
+
+TEST_CASE("Disassembly shows depths, operands and optimizer passes", "[optimizer]")
+{
+  auto const exe = compile("int g() { return 3; } int main() { int a[4]; int s = 0; for (int i = 0; i < 4; i++) s += a[i]; return s + g(); }");
+  auto const depths = sci::stack_depths(exe, 0);
+  REQUIRE(depths[0] == 0);
+  REQUIRE(depths[1] == 1);
+  REQUIRE(depths[static_cast<std::size_t>(sci::instruction_count(exe.functions[0]))] == -1);
+
+  std::ostringstream parsed;
+  sci::disassemble(exe, parsed);
+  REQUIRE(parsed.str().starts_with("main: returns int, frame 6, max depth 3"));
+  REQUIRE(parsed.str().find("CALL         1 g\n") != std::string::npos);
+  REQUIRE(parsed.str().find("LOAD_IND\n") != std::string::npos);
+  REQUIRE(parsed.str().find(" -> ") != std::string::npos);
+
+  // the loop becomes a SUM in the first pass, its condition a JGE in the second
+  std::ostringstream loops;
+  sci::disassemble(sci::optimize(exe, sci::OptimizerPass::LOOPS), loops);
+  REQUIRE(loops.str().find("SUM\n") != std::string::npos);
+  REQUIRE(loops.str().find("JGE") == std::string::npos);
+  std::ostringstream branches;
+  sci::disassemble(sci::optimize(exe), branches);
+  REQUIRE(branches.str().find("JGE") != std::string::npos);
+  REQUIRE(sci::instruction_count(sci::optimize(exe).functions[0]) < sci::instruction_count(exe.functions[0]));
+}
+
+TEST_CASE("Scheduler interleaves scripts", "[scheduler]")
+{
+  auto const long_loop = compile("int main() { int s = 0; for (int i = 0; i < 200; i++) s += i; return s; }");
+  auto const short_loop = compile("int main() { int s = 0; for (int i = 0; i < 5; i++) s += 2; return s; }");
+  auto const error = compile("int main() { int n = 1; return main() + n; }");
+  using Interp = sci::Interpreter<10, 64, 10>;
+
+  sci::Scheduler scheduler;
+  auto const first = scheduler.spawn(sci::run_in_slices(Interp{}, long_loop, 16));
+  auto const second = scheduler.spawn(sci::run_in_slices(Interp{}, short_loop, 16));
+  auto const third = scheduler.spawn(sci::run_in_slices(Interp{}, error, 16));
+  REQUIRE(scheduler.pending() == 3);
+
+  // the short script finishes while the long one is still running
+  while (!scheduler.result(second)) {
+    REQUIRE(scheduler.run_once());
+  }
+  REQUIRE_FALSE(scheduler.result(first));
+  REQUIRE(std::get<int>(scheduler.result(second)->value.val) == 10);
+
+  scheduler.run();
+  REQUIRE(scheduler.pending() == 0);
+  REQUIRE_FALSE(scheduler.run_once());
+  REQUIRE(scheduler.result(first)->r == sci::Result::OK);
+  REQUIRE(std::get<int>(scheduler.result(first)->value.val) == Interp{}.interpret(long_loop));
+  REQUIRE(scheduler.result(third)->r == sci::Result::ERR);
+  REQUIRE_FALSE(scheduler.result(3));
+}
+
+TEST_CASE("Deadlines suspend endless scripts", "[scheduler]")
+{
+  auto const exe = compile("int main() { int s = 0; while (s >= 0) s = s * 1; return s; }");
+  sci::Interpreter<10, 64, 10> const interpreter;
+  decltype(interpreter)::Context context;
+  REQUIRE(interpreter.start(exe, context) == sci::Result::OK);
+
+  sci::DeadlineBudget passed{ std::chrono::steady_clock::now() };
+  REQUIRE(interpreter.resume(context, passed).r == sci::Result::SUSPENDED);
+
+  for (int slice{ 0 }; slice < 3; ++slice) {
+    sci::DeadlineBudget budget{ std::chrono::steady_clock::now() + std::chrono::milliseconds{ 2 } };
+    auto const result = interpreter.resume(context, budget);
+    REQUIRE(result.r == sci::Result::SUSPENDED);
+    REQUIRE(result.func_index == 0);
+  }
+}
+
+namespace {
+std::vector<std::pair<sci::Completion<int>, int>> lookups;
+int notified{ 0 };
+
+auto lookup(sci::Completion<int> const done, int const key) -> void
+{
+  lookups.emplace_back(done, key);
+}
+
+auto notify(sci::Completion<void> const done) -> void
+{
+  ++notified;
+  done.resolve();
+}
+}// namespace
+
+TEST_CASE("Async host calls park the script", "[scheduler]")
+{
+  lookups.clear();
+  notified = 0;
+  std::array const natives{
+    sci::async_native<lookup>("lookup"),
+    sci::async_native<notify>("notify"),
+  };
+  REQUIRE(natives[0].call == nullptr);
+  REQUIRE(natives[0].return_type == sci::Literal::Type::INT_);
+
+  // by hand: the run stops at the call with its arguments and continues with the result
+  auto const exe = compile("int main() { int a = 2; notify(); return lookup(a * 3) + a; }", natives);
+  sci::Interpreter<10, 64, 10> const interpreter;
+  decltype(interpreter)::Context context;
+  REQUIRE(interpreter.start(exe, context) == sci::Result::OK);
+  sci::Unlimited budget;
+  REQUIRE(interpreter.resume(context, budget).r == sci::Result::WAITING);
+  interpreter.complete(context, {});
+  REQUIRE(interpreter.resume(context, budget).r == sci::Result::WAITING);
+  REQUIRE(context.native_args[0].i == 6);
+  REQUIRE(interpreter.resume(context, budget).r == sci::Result::WAITING);
+  interpreter.complete(context, { 40 });
+  auto const result = interpreter.resume(context, budget);
+  REQUIRE(result.r == sci::Result::OK);
+  REQUIRE(std::get<int>(result.value.val) == 42);
+  // starting the host function is up to whoever drives the run
+  REQUIRE(notified == 0);
+
+  // scheduled: every script waits at once, another thread answers
+  constexpr int scripts{ 20 };
+  std::vector<sci::CompiledProgram> programs;
+  for (int i{ 0 }; i < scripts; ++i) {
+    programs.push_back(compile("int main() { notify(); return lookup(" + std::to_string(i) + ") + 1; }", natives));
+  }
+  sci::Scheduler scheduler;
+  std::vector<std::size_t> ids;
+  for (auto const& program : programs) {
+    ids.push_back(scheduler.spawn(sci::run_in_slices(sci::Interpreter<10, 64, 10>{}, program, 64)));
+  }
+  while (scheduler.run_once()) {}
+  REQUIRE(notified == scripts);
+  REQUIRE(scheduler.waiting() == scripts);
+  REQUIRE(lookups.size() == scripts);
+
+  std::thread io{ [] {
+    for (auto const& [done, key] : lookups) {
+      done.resolve(key * 10);
+    }
+  } };
+  scheduler.run();
+  io.join();
+  REQUIRE(scheduler.pending() == 0);
+  for (int i{ 0 }; i < scripts; ++i) {
+    REQUIRE(scheduler.result(ids[static_cast<std::size_t>(i)])->r == sci::Result::OK);
+    REQUIRE(std::get<int>(scheduler.result(ids[static_cast<std::size_t>(i)])->value.val) == i * 10 + 1);
+  }
+}
+
+TEST_CASE("Limits stop endless scripts", "[interpreter]")
+{
+  using namespace std::chrono_literals;
+  auto const loop = compile("int main() { int s = 0; while (s >= 0) s = s * 1; return s; }");
+  auto const started = std::chrono::steady_clock::now();
+  REQUIRE(sci::Interpreter<10, 64, 10>{ sci::Limits{ .time = 5ms } }.execute(loop).r == sci::Result::LIMIT);
+  REQUIRE(std::chrono::steady_clock::now() - started < 1s);
+  REQUIRE(sci::Interpreter<10, 64, 10>{ sci::Limits{ .fuel = 1000 } }.execute(loop).r == sci::Result::LIMIT);
+
+  // calls take fuel before the func_stack overflows
+  auto const recursion = compile("int main() { return main(); }");
+  REQUIRE(sci::Interpreter<10, 64, 10>{}.execute(recursion).r == sci::Result::ERR);
+  REQUIRE(sci::Interpreter<10, 64, 10>{ sci::Limits{ .fuel = 5 } }.execute(recursion).r == sci::Result::LIMIT);
+
+  REQUIRE(sci::Interpreter<10, 64, 10>{ sci::Limits{ .fuel = 1000, .time = 1s } }.interpret(compile("int main() { return 7; }")) == 7);
+}
+
+namespace {
+auto next_request(sci::Completion<int> const /*done*/) -> void
+{}
+}// namespace
+
+TEST_CASE("Runs fork from a snapshot", "[snapshot]")
+{
+  std::array const natives{ sci::async_native<next_request>("next") };
+  auto const exe = compile<150>(R"(
+int main() {
+   int t[8];
+   for (int i = 0; i < 8; i++) t[i] = i * i;
+   int request = next();
+   return t[request] + request;
+}
+)", natives);
+  using Interp = sci::Interpreter<10, 64, 10>;
+  Interp const interpreter;
+  Interp::Context warm;
+  REQUIRE(interpreter.start(exe, warm) == sci::Result::OK);
+  sci::Unlimited budget;
+  REQUIRE(interpreter.resume(warm, budget).r == sci::Result::WAITING);
+
+  auto const blob = sci::snapshot(warm);
+  REQUIRE(blob.size() == sci::snapshot_size(warm));
+  REQUIRE(blob.size() < sizeof(Interp::Context));
+
+  sci::Snapshot const image{ exe, blob };
+  REQUIRE(image.valid());
+  for (int request{ 0 }; request < 8; ++request) {
+    Interp::Context fork;
+    REQUIRE(image.fork(interpreter, fork) == sci::Result::OK);
+    interpreter.complete(fork, { request });
+    auto const result = interpreter.resume(fork, budget);
+    REQUIRE(result.r == sci::Result::OK);
+    REQUIRE(std::get<int>(result.value.val) == request * request + request);
+  }
+
+  // a blob fits only its program, intact and within the quota
+  auto const other = compile("int main() { return next(); }", natives);
+  REQUIRE_FALSE(sci::Snapshot{ other, blob }.valid());
+  auto damaged = blob;
+  damaged.pop_back();
+  REQUIRE_FALSE(sci::Snapshot{ exe, damaged }.valid());
+  Interp::Context fork;
+  REQUIRE(sci::Snapshot{ exe, damaged }.fork(interpreter, fork) == sci::Result::ERR);
+  Interp const small{ sci::Limits{ .memory = 8 * sizeof(sci::Value) } };
+  REQUIRE(image.fork(small, fork) == sci::Result::OUT_OF_MEMORY);
+}
+
+TEST_CASE("Server requests start from warm scripts", "[server]")
+{
+  REQUIRE(sci::server::parse_request("table 12")->script == "table");
+  REQUIRE(sci::server::parse_request(" table\t-3\r")->argument == -3);
+  REQUIRE(sci::server::parse_request("plain")->argument == 0);
+  REQUIRE_FALSE(sci::server::parse_request(""));
+  REQUIRE_FALSE(sci::server::parse_request("table 1x"));
+  REQUIRE_FALSE(sci::server::parse_request("table 1 2"));
+
+  sci::server::WarmScript const table{ "table", R"(
+int main() {
+   int t[16];
+   for (int i = 0; i < 16; i++) t[i] = i * i;
+   int r = request();
+   return t[r] + request();
+}
+)", sci::server::Interpreter{} };
+  REQUIRE(table.compiled());
+  REQUIRE(table.warm());
+  auto context = std::make_unique<sci::server::Interpreter::Context>();
+  REQUIRE(sci::server::format_reply(table.serve(3, *context)) == "OK 12\n");
+  // index past the frames
+  REQUIRE(sci::server::format_reply(table.serve(99, *context)) == "ERR\n");
+
+  sci::server::WarmScript const spin{ "spin", "int main() { int s = 0; while (s >= 0) s = s * 1; return s; }",
+    sci::server::Interpreter{ sci::Limits{ .fuel = 1000 } } };
+  REQUIRE_FALSE(spin.warm());
+  REQUIRE(sci::server::format_reply(spin.serve(0, *context)) == "LIMIT\n");
+  REQUIRE(sci::server::format_reply(sci::server::WarmScript{ "half", "double main() { return 2.5; }", {} }.serve(0, *context)) == "OK 2.5\n");
+  REQUIRE_FALSE(sci::server::WarmScript{ "broken", "int main() { return }", {} }.compiled());
+}
+
+TEST_CASE("Daemon keeps scripts cached until they change", "[server]")
+{
+  auto const request = sci::server::encode_request("/scripts/table.c", -7);
+  REQUIRE(request.size() == sci::server::REQUEST_HEADER_SIZE + 16);
+  std::array<char, sci::server::REQUEST_HEADER_SIZE> header{};
+  std::copy_n(request.begin(), header.size(), header.begin());
+  REQUIRE(sci::server::decode_request_header(header).path_size == 16);
+  REQUIRE(sci::server::decode_request_header(header).argument == -7);
+  auto const reply = sci::server::decode_reply(sci::server::encode_reply({ sci::server::Status::OK, { sci::Literal::Type::DOUBLE_, 2.5 }, 12 }));
+  REQUIRE(reply.status == sci::server::Status::OK);
+  REQUIRE(std::get<double>(reply.value.val) == 2.5);
+  REQUIRE(reply.micros == 12);
+  REQUIRE(std::get<int>(sci::server::decode_reply(sci::server::encode_reply({ sci::server::Status::OK, { sci::Literal::Type::INT_, -3 } })).value.val) == -3);
+
+  auto const path = (std::filesystem::temp_directory_path() / "sci-daemon-test.c").string();
+  std::ofstream{ path } << "int main() { int k = request(); return k * 2; }";
+  sci::server::ScriptCache cache{ sci::server::Interpreter{} };
+  auto context = std::make_unique<sci::server::Interpreter::Context>();
+  auto const first = cache.get(path);
+  REQUIRE(first->warm());
+  REQUIRE(cache.get(path) == first);
+  REQUIRE(std::get<int>(sci::server::handle(cache, path, 21, *context).value.val) == 42);
+
+  std::ofstream{ path } << "int main() { int k = request(); return k + 1; }";
+  std::filesystem::last_write_time(path, std::filesystem::last_write_time(path) + std::chrono::seconds{ 1 });
+  REQUIRE(std::get<int>(sci::server::handle(cache, path, 21, *context).value.val) == 22);
+  REQUIRE(cache.size() == 1);
+  // the old script stays usable by whoever still holds it
+  REQUIRE(std::get<int>(first->serve(5, *context).value.val) == 10);
+
+  std::ofstream{ path } << "int main() { return }";
+  std::filesystem::last_write_time(path, std::filesystem::last_write_time(path) + std::chrono::seconds{ 2 });
+  REQUIRE(sci::server::handle(cache, path, 0, *context).status == sci::server::Status::COMPILE_ERROR);
+  std::filesystem::remove(path);
+  REQUIRE(sci::server::handle(cache, path, 0, *context).status == sci::server::Status::NO_SCRIPT);
+}